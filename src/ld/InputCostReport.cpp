@@ -0,0 +1,240 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-*
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <mach/mach_time.h>
+
+#include <string>
+#include <algorithm>
+#include <unordered_set>
+
+#include "InputCostReport.h"
+
+namespace ld {
+namespace tool {
+
+
+InputCostReport::InputCostReport(const Options& opts)
+	: _options(opts)
+{
+	pthread_mutex_init(&_lock, NULL);
+}
+
+
+// caller must hold _lock, or be the only thread left
+InputCostReport::FileCosts& InputCostReport::costs(const ld::File* file)
+{
+	// atoms arrive grouped by file, so usually the same file as last time
+	if ( (file == _lastFile) && (file != nullptr) )
+		return _files[_lastIndex];
+	auto pos = _fileIndex.find(file);
+	if ( pos == _fileIndex.end() ) {
+		pos = _fileIndex.insert({ file, _files.size() }).first;
+		_files.emplace_back();
+		_files.back().file = file;
+	}
+	_lastFile  = file;
+	_lastIndex = pos->second;
+	return _files[pos->second];
+}
+
+
+void InputCostReport::noteParsed(const ld::File* file, uint64_t mappedBytes, uint64_t parseTime)
+{
+	if ( file == nullptr )
+		return;
+	pthread_mutex_lock(&_lock);
+	FileCosts& fileCosts = costs(file);
+	fileCosts.mappedBytes = mappedBytes;
+	fileCosts.parseTime   = parseTime;
+	pthread_mutex_unlock(&_lock);
+}
+
+
+void InputCostReport::noteAtom(const ld::Atom& atom)
+{
+	pthread_mutex_lock(&_lock);
+	FileCosts& fileCosts = costs(atom.file());
+	fileCosts.atoms  += 1;
+	fileCosts.fixups += (atom.fixupsEnd() - atom.fixupsBegin());
+	pthread_mutex_unlock(&_lock);
+}
+
+
+const char* InputCostReport::kindName(const ld::File* file, bool archiveMember,
+									 const std::unordered_set<const ld::File*>& bitcodeFiles)
+{
+	if ( file == nullptr )
+		return "linker synthesized";
+	if ( dynamic_cast<const ld::archive::File*>(file) != nullptr )
+		return "archive";
+	if ( dynamic_cast<const ld::dylib::File*>(file) != nullptr ) {
+		size_t len = strlen(file->path());
+		if ( (len > 4) && (strcmp(&file->path()[len-4], ".tbd") == 0) )
+			return "tbd";
+		return "dylib";
+	}
+	if ( const ld::relocatable::File* objFile = dynamic_cast<const ld::relocatable::File*>(file) ) {
+		if ( bitcodeFiles.count(objFile) != 0 )
+			return archiveMember ? "archive member bitcode" : "bitcode";
+		if ( objFile->sourceKind() == ld::relocatable::File::kSourceLTO )
+			return "lto output";
+		return archiveMember ? "archive member" : "object";
+	}
+	return "linker synthesized";
+}
+
+
+bool InputCostReport::takesNoFileSpace(const ld::Section& sect)
+{
+	switch ( sect.type() ) {
+		case ld::Section::typeZeroFill:
+		case ld::Section::typeTLVZeroFill:
+		case ld::Section::typePageZero:
+		case ld::Section::typeStack:
+		case ld::Section::typeAbsoluteSymbols:
+		case ld::Section::typeTentativeDefs:
+			return true;
+		default:
+			break;
+	}
+	return false;
+}
+
+
+static void writeJSONString(FILE* out, const char* str)
+{
+	fputc('"', out);
+	for (const char* s=str; *s != '\0'; ++s) {
+		unsigned char c = *s;
+		if ( (c == '"') || (c == '\\') )
+			fprintf(out, "\\%c", c);
+		else if ( c < 0x20 )
+			fprintf(out, "\\u%04X", c);
+		else
+			fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+
+void InputCostReport::write(const ld::Internal& state)
+{
+	__block std::unordered_set<const ld::File*> bitcodeFiles(state.filesForLTO.begin(), state.filesForLTO.end());
+
+	// archive members are parsed inside their archive, ask each archive about the members it loaded
+	const size_t inputCount = _files.size();
+	for (size_t i=0; i < inputCount; ++i) {
+		const ld::archive::File* archive = dynamic_cast<const ld::archive::File*>(_files[i].file);
+		if ( archive == nullptr )
+			continue;
+		archive->forEachLoadedMember(^(const ld::File& member, uint64_t size, uint64_t parseTime) {
+			FileCosts& fileCosts = costs(&member);
+			fileCosts.kind        = kindName(&member, true, bitcodeFiles);
+			fileCosts.mappedBytes = size;
+			fileCosts.parseTime   = parseTime;
+		});
+	}
+
+	// the atoms LTO produced belong to its output object, give each back to the bitcode file
+	// that defined a symbol of that name, when only one did
+	__block std::unordered_map<std::string, const ld::File*> ltoSymbolsMap;
+	for (const ld::relocatable::File* ltoFile : state.filesForLTO) {
+		ltoFile->forEachLtoSymbol(^(const char* symName) {
+			auto pos = ltoSymbolsMap.find(symName);
+			if ( pos == ltoSymbolsMap.end() )
+				ltoSymbolsMap[symName] = ltoFile;
+			else
+				pos->second = nullptr;
+		});
+	}
+
+	// attribute the atoms that made it into the output
+	for (const ld::Internal::FinalSection* sect : state.sections) {
+		const bool noFileSpace = takesNoFileSpace(*sect);
+		for (const ld::Atom* atom : sect->atoms) {
+			const ld::File* file = atom->file();
+			const ld::relocatable::File* objFile = dynamic_cast<const ld::relocatable::File*>(file);
+			if ( (objFile != nullptr) && (objFile->sourceKind() == ld::relocatable::File::kSourceLTO) ) {
+				const auto& pos = ltoSymbolsMap.find(atom->name());
+				if ( (pos != ltoSymbolsMap.end()) && (pos->second != nullptr) )
+					file = pos->second;
+			}
+			FileCosts& fileCosts = costs(file);
+			fileCosts.liveAtoms += 1;
+			if ( !noFileSpace )
+				fileCosts.outputBytes += atom->size();
+		}
+	}
+
+	for (FileCosts& fileCosts : _files) {
+		if ( fileCosts.kind == nullptr )
+			fileCosts.kind = kindName(fileCosts.file, false, bitcodeFiles);
+	}
+
+	// most expensive to parse first, ties in path order so the report is stable
+	std::vector<const FileCosts*> sorted;
+	sorted.reserve(_files.size());
+	for (const FileCosts& fileCosts : _files)
+		sorted.push_back(&fileCosts);
+	std::sort(sorted.begin(), sorted.end(), [](const FileCosts* left, const FileCosts* right) {
+		if ( left->parseTime != right->parseTime )
+			return (left->parseTime > right->parseTime);
+		if ( left->outputBytes != right->outputBytes )
+			return (left->outputBytes > right->outputBytes);
+		const char* leftPath  = (left->file != nullptr)  ? left->file->path()  : "";
+		const char* rightPath = (right->file != nullptr) ? right->file->path() : "";
+		return (strcmp(leftPath, rightPath) < 0);
+	});
+
+	std::string reportPath = std::string(_options.outputFilePath()) + ".input_costs.json";
+	FILE* out = fopen(reportPath.c_str(), "w");
+	if ( out == NULL ) {
+		warning("could not write input cost report: %s", reportPath.c_str());
+		return;
+	}
+	mach_timebase_info_data_t timebase;
+	mach_timebase_info(&timebase);
+	fprintf(out, "{\n  \"output\": ");
+	writeJSONString(out, _options.outputFilePath());
+	fprintf(out, ",\n  \"inputs\": [");
+	bool first = true;
+	for (const FileCosts* fileCosts : sorted) {
+		fprintf(out, "%s\n    { \"path\": ", first ? "" : ",");
+		first = false;
+		writeJSONString(out, (fileCosts->file != nullptr) ? fileCosts->file->path() : "");
+		fprintf(out, ", \"kind\": \"%s\", \"mappedBytes\": %llu, \"parseNanoseconds\": %llu, \"atoms\": %llu, \"fixups\": %llu, "
+					 "\"liveAtoms\": %llu, \"outputBytes\": %llu }",
+				fileCosts->kind, fileCosts->mappedBytes, (fileCosts->parseTime * timebase.numer) / timebase.denom, fileCosts->atoms,
+				fileCosts->fixups, fileCosts->liveAtoms, fileCosts->outputBytes);
+	}
+	fprintf(out, "\n  ]\n}\n");
+	fclose(out);
+}
+
+} // namespace tool
+} // namespace ld
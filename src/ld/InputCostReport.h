@@ -0,0 +1,89 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-*
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifndef __INPUT_COST_REPORT_H__
+#define __INPUT_COST_REPORT_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Options.h"
+#include "ld.hpp"
+
+namespace ld {
+namespace tool {
+
+//
+// For -input_cost_report, attributes costs to each input file: the bytes mapped and time
+// spent parsing it, the atoms and fixups it produced, how many of those atoms survived
+// dead stripping, and how many bytes they take in the output.  Written as JSON next to
+// the output file, most expensive inputs first.  Code generated by LTO is matched back to
+// bitcode files by symbol name; what cannot be matched stays with the LTO output object.
+//
+class InputCostReport
+{
+public:
+								InputCostReport(const Options& opts);
+
+	// called as each input is parsed, possibly on several threads
+	void						noteParsed(const ld::File* file, uint64_t mappedBytes, uint64_t parseTime);
+	// called by the resolver for each atom it is given
+	void						noteAtom(const ld::Atom& atom);
+	// adds the archive members loaded from the inputs, then attributes the final atoms and writes the report
+	void						write(const ld::Internal& state);
+
+private:
+	struct FileCosts {
+		const ld::File*		file			= nullptr;
+		const char*			kind			= nullptr;
+		uint64_t			mappedBytes		= 0;
+		uint64_t			parseTime		= 0;		// mach_absolute_time() units
+		uint64_t			atoms			= 0;
+		uint64_t			fixups			= 0;
+		uint64_t			liveAtoms		= 0;
+		uint64_t			outputBytes		= 0;
+	};
+
+	FileCosts&					costs(const ld::File* file);
+	static const char*			kindName(const ld::File* file, bool archiveMember,
+														 const std::unordered_set<const ld::File*>& bitcodeFiles);
+	static bool					takesNoFileSpace(const ld::Section& sect);
+
+	const Options&								_options;
+	pthread_mutex_t								_lock;
+	std::unordered_map<const ld::File*, size_t>	_fileIndex;
+	std::vector<FileCosts>						_files;
+	const ld::File*								_lastFile		= nullptr;
+	size_t										_lastIndex		= 0;
+};
+
+} // namespace tool
+} // namespace ld
+
+#endif // __INPUT_COST_REPORT_H__
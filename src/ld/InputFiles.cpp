@@ -231,6 +231,21 @@ const char* InputFiles::extractFileInfo(const uint8_t* p, unsigned len, const ch
 
 ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib)
 {
+	if ( !_options.inputCostReport() ) {
+		uint64_t mappedLength;
+		return this->parseFile(info, indirectDylib, mappedLength);
+	}
+	uint64_t startTime = mach_absolute_time();
+	uint64_t mappedLength = 0;
+	ld::File* file = this->parseFile(info, indirectDylib, mappedLength);
+	_costReport.noteParsed(file, mappedLength, mach_absolute_time() - startTime);
+	return file;
+}
+
+
+ld::File* InputFiles::parseFile(const Options::FileInfo& info, bool indirectDylib, uint64_t& mappedLength)
+{
+	mappedLength = 0;
 	bool fromSDK = _options.fromSDK(info.path);
 	// handle inlined framework first.
 	if (info.isInlined) {
@@ -252,18 +267,9 @@ ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib
 	if ( stat_buf.st_size < 20 )
 		throwf("file too small (length=%llu)", stat_buf.st_size);
 	int64_t len = stat_buf.st_size;
-	// <rdar://problem/69569058>
-	// On macOS 10.15 MAP_RESILIENT_CODESIGN doesn't work, so we need to first try
-	// with the flag and then without it.
-	int flags = MAP_FILE | MAP_PRIVATE | MAP_RESILIENT_CODESIGN;
-	uint8_t* p = (uint8_t*)::mmap(NULL, stat_buf.st_size, PROT_READ, flags, fd, 0);
-	if ( p == MAP_FAILED ) {
-		flags &= ~MAP_RESILIENT_CODESIGN;
-		p = (uint8_t*)::mmap(NULL, stat_buf.st_size, PROT_READ, flags, fd, 0);
-		if ( p == MAP_FAILED ) {
-			throwf("can't map file, errno=%d", errno);
-		}
-	}
+	uint8_t* p = _mappings.map(fd, 0, stat_buf.st_size);
+	if ( p == MAP_FAILED )
+		throwf("can't map file, errno=%d", errno);
 
 	// if fat file, skip to architecture we want
 	if ( const FatFile* fatFile = FatFile::isFatFile(p) ) {
@@ -334,20 +340,11 @@ ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib
 			static const int page_mask = ::getpagesize() - 1;
 			if ( (sliceOffset & page_mask) == 0 ) {
 				// unmap whole file
-				munmap((caddr_t)p, stat_buf.st_size);
+				_mappings.unmap(p, stat_buf.st_size);
 				// re-map just part we need
-				// <rdar://problem/69569058>
-				// On macOS 10.15 MAP_RESILIENT_CODESIGN doesn't work, so we need to first try
-				// with the flag and then without it.
-				int flags = MAP_FILE | MAP_PRIVATE | MAP_RESILIENT_CODESIGN;
-				p = (uint8_t*)::mmap(NULL, sliceLength, PROT_READ, flags, fd, sliceOffset);
-				if ( p == MAP_FAILED ) {
-					flags &= ~MAP_RESILIENT_CODESIGN;
-					p = (uint8_t*)::mmap(NULL, sliceLength, PROT_READ, flags, fd, sliceOffset);
-					if ( p == MAP_FAILED ) {
-						throwf("can't re-map file, errno=%d", errno);
-					}
-				}
+				p = _mappings.map(fd, sliceOffset, sliceLength);
+				if ( p == MAP_FAILED )
+					throwf("can't re-map file, errno=%d", errno);
 			}
 			else {
 				p = &p[sliceOffset];
@@ -359,6 +356,8 @@ ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib
 		}
 	}
 	::close(fd);
+	_mappings.noteMapped(info.path, p, len);
+	mappedLength = len;
 
 	// see if it is an object file
 	mach_o::relocatable::ParserOptions objOpts;
@@ -387,6 +386,8 @@ ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib
 
 	ld::relocatable::File* objResult = mach_o::relocatable::parse(p, len, info.path, info.modTime, info.ordinal, objOpts);
 	if ( objResult != NULL ) {
+		_mappings.releaseParsedOnlyPages(p, len);
+		_mappings.noteRetained(p, len);
 		OSAtomicAdd64(len, &_totalObjectSize);
 		OSAtomicIncrement32(&_totalObjectLoaded);
 		return objResult;
@@ -433,6 +434,7 @@ ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib
 	archOpts.objcABI2				= _options.objCABIVersion2POverride();
 	archOpts.verboseLoad			= _options.whyLoad();
 	archOpts.logAllFiles			= _options.logAllFiles();
+	archOpts.timeMembers			= _options.inputCostReport();
 	// Set ObjSource Kind, libclang_rt is compiler static library
 	if ( isCompilerSupportLib(info.path) )
 		archOpts.objOpts.srcKind = ld::relocatable::File::kSourceCompilerArchive;
@@ -443,7 +445,7 @@ ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib
 
 	ld::archive::File* archiveResult = ::archive::parse(p, len, info.path, info.modTime, info.ordinal, archOpts);
 	if ( archiveResult != NULL ) {
-	
+		_mappings.noteRetained(p, len);
 		OSAtomicAdd64(len, &_totalArchiveSize);
 		OSAtomicIncrement32(&_totalArchivesLoaded);
 		return archiveResult;
@@ -953,7 +955,7 @@ void InputFiles::checkDylibClientRestrictions(ld::dylib::File* dylib)
 InputFiles::InputFiles(Options& opts) 
  : _totalObjectSize(0), _totalArchiveSize(0), 
    _totalObjectLoaded(0), _totalArchivesLoaded(0), _totalDylibsLoaded(0),
-	_options(opts), _bundleLoader(NULL), 
+	_options(opts), _mappings(opts), _costReport(opts), _bundleLoader(NULL), 
 	_exception(NULL), 
 	_indirectDylibOrdinal(ld::File::Ordinal::indirectDylibBase()),
 	_linkerOptionOrdinal(ld::File::Ordinal::linkerOptionBase())
@@ -969,13 +971,22 @@ InputFiles::InputFiles(Options& opts)
 	if ( files.size() == 0 )
 		throw "no object files specified";
 
+	if ( _options.memoryUsage().budget() != 0 )
+		_options.memoryUsage().setReleaseInputPagesHandler(^{ _mappings.releaseAllPages(); });
+
 	_inputFiles.reserve(files.size());
 #if HAVE_LIBDISPATCH
 	_inputFiles.resize(files.size(), nullptr);
 	__block const char* firstError = nullptr;
+	_mappings.startPrefetching(files);
+	const bool recordFileTimes = _options.snapshot().recordingTimings();
 	dispatch_apply(files.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
 		try {
+			uint64_t startTime = recordFileTimes ? mach_absolute_time() : 0;
 			_inputFiles[index] = makeFile(files[index], false);
+			if ( recordFileTimes )
+				_options.snapshot().recordFileTime((unsigned)index, files[index].path, mach_absolute_time() - startTime);
+			_mappings.noteParsed(index);
 		}
 		catch (const char *msg) {
 			if ( ((strstr(msg, "architecture") != NULL)  || (strstr(msg, "attempting to link") != NULL)) && !_options.errorOnOtherArchFiles() ) {
@@ -994,8 +1005,10 @@ InputFiles::InputFiles(Options& opts)
 					asprintf((char**)&firstError, "%s file '%s'", msg, files[index].path);
 			}
 			_inputFiles[index] = new IgnoredFile(files[index].path, files[index].modTime, files[index].ordinal, ld::File::Other);
+			_mappings.noteParsed(index);
 		}
 	});
+	_mappings.stopPrefetching();
 	if ( firstError != nullptr )
 		throw firstError;
 
@@ -1044,6 +1057,7 @@ InputFiles::InputFiles(Options& opts)
 	}
 
 	// Start up one parser thread. More start on demand as parsed input files get consumed.
+	_mappings.startPrefetching(files);
 	startThread(InputFiles::parseWorkerThread);
 	_availableWorkers--;
 #else
@@ -1071,6 +1085,7 @@ void InputFiles::startThread(void (*threadFunc)(InputFiles *)) const {
 void InputFiles::parseWorkerThread() {
 	ld::File *file;
 	const char *exception = NULL;
+	bool parsedLastFile = false;
 	pthread_mutex_lock(&_parseLock);
 	const std::vector<Options::FileInfo>& files = _options.getInputFiles();
 	if (_s_logPThreads) printf("worker starting\n");
@@ -1091,7 +1106,10 @@ void InputFiles::parseWorkerThread() {
 			pthread_mutex_unlock(&_parseLock);
 			if (_s_logPThreads) printf("parsing index %u\n", slot);
 			try {
+				uint64_t startTime = mach_absolute_time();
 				file = makeFile(entry, false);
+				if ( _options.snapshot().recordingTimings() )
+					_options.snapshot().recordFileTime(slot, entry.path, mach_absolute_time() - startTime);
 			}
 			catch (const char *msg) {
 				if ( ((strstr(msg, "architecture") != NULL)  || (strstr(msg, "attempting to link") != NULL)) && !_options.errorOnOtherArchFiles() ) {
@@ -1110,7 +1128,9 @@ void InputFiles::parseWorkerThread() {
 				}
 				file = new IgnoredFile(entry.path, entry.modTime, entry.ordinal, ld::File::Other);
 			}
+			_mappings.noteParsed(slot);
 			pthread_mutex_lock(&_parseLock);
+			bool wasRemaining = (_remainingInputFiles > 0);
 			if (_remainingInputFiles > 0)
 				_remainingInputFiles--;
 			if (_s_logPThreads) printf("done with index %u, %d remaining\n", slot, _remainingInputFiles);
@@ -1124,12 +1144,18 @@ void InputFiles::parseWorkerThread() {
 				if (_neededFileSlot == slot)
 					pthread_cond_signal(&_newFileAvailable);
 			}
+			// only the worker that brings the count to zero sees this
+			if (wasRemaining && (_remainingInputFiles == 0))
+				parsedLastFile = true;
 		}
 	} while (_remainingInputFiles);
 	if (_s_logPThreads) printf("worker exiting\n");
 	pthread_cond_broadcast(&_parseWorkReady);
 	pthread_cond_signal(&_newFileAvailable);
 	pthread_mutex_unlock(&_parseLock);
+	// nothing is left to parse, so stop the prefetcher that startPrefetching() started
+	if ( parsedLastFile )
+		_mappings.stopPrefetching();
 }
 
 
@@ -1414,11 +1440,102 @@ void InputFiles::forEachInitialAtom(ld::File::AtomHandler& handler, ld::Internal
 }
 
 
+void InputFiles::addProviders(const ld::File* file, uint32_t position, ProviderMap& providers, std::vector<uint32_t>& unlisted)
+{
+	ProviderMap* providerMap = &providers;
+	bool listed = file->forEachSymbolName(^(const char* name) {
+		auto pos = providerMap->find(name);
+		if ( pos == providerMap->end() ) {
+			// library owned names are not always stable (dylibs cache re-exported lookups by caller's name)
+			pos = providerMap->insert({ std::string_view(strdup(name)), std::vector<uint32_t>() }).first;
+		}
+		std::vector<uint32_t>& positions = pos->second;
+		if ( positions.empty() || (positions.back() < position) ) {
+			positions.push_back(position);
+		}
+		else {
+			auto it = std::lower_bound(positions.begin(), positions.end(), position);
+			if ( *it != position )
+				positions.insert(it, position);
+		}
+	});
+	if ( !listed )
+		unlisted.push_back(position);
+}
+
+void InputFiles::updateProviderIndex() const
+{
+	bool librariesAdded = (_indexedLibraryCount != _searchLibraries.size());
+	bool indirectDylibsAdded = (_indexedInstallPathCount != _installPathToDylibs.size());
+	if ( !librariesAdded && !indirectDylibsAdded )
+		return;
+
+	// dylibs that could not list their names may be able to now that more dylibs are loaded
+	std::vector<uint32_t> unlisted;
+	unlisted.swap(_unlistedLibraries);
+	for (uint32_t position : unlisted)
+		addProviders(_searchLibraries[position].file(), position, _libraryProviders, _unlistedLibraries);
+	// libraries are only ever appended
+	for (size_t i=_indexedLibraryCount; i < _searchLibraries.size(); ++i)
+		addProviders(_searchLibraries[i].file(), (uint32_t)i, _libraryProviders, _unlistedLibraries);
+	_indexedLibraryCount = _searchLibraries.size();
+
+	// indirect dylibs are searched in install path order, so new ones can land anywhere
+	if ( indirectDylibsAdded || !_unlistedIndirectDylibs.empty() ) {
+		_indirectDylibProviders.clear();
+		_unlistedIndirectDylibs.clear();
+		_indirectDylibOrder.clear();
+		for (const auto& entry : _installPathToDylibs) {
+			// explicitly linked dylibs are never searched as indirect dylibs
+			if ( entry.second->explicitlyLinked() )
+				continue;
+			uint32_t position = (uint32_t)_indirectDylibOrder.size();
+			_indirectDylibOrder.push_back(entry.second);
+			addProviders(entry.second, position, _indirectDylibProviders, _unlistedIndirectDylibs);
+		}
+		_indexedInstallPathCount = _installPathToDylibs.size();
+	}
+}
+
+// merges the sorted positions of libraries listing a name with those that could not list names
+bool InputFiles::nextProvider(const std::vector<uint32_t>* listed, size_t& listedIndex,
+							  const std::vector<uint32_t>& unlisted, size_t& unlistedIndex, uint32_t& position)
+{
+	bool haveListed   = (listed != nullptr) && (listedIndex < listed->size());
+	bool haveUnlisted = (unlistedIndex < unlisted.size());
+	if ( haveListed && haveUnlisted ) {
+		uint32_t l = (*listed)[listedIndex];
+		uint32_t u = unlisted[unlistedIndex];
+		position = std::min(l, u);
+		if ( l == position )
+			++listedIndex;
+		if ( u == position )
+			++unlistedIndex;
+		return true;
+	}
+	if ( haveListed ) {
+		position = (*listed)[listedIndex++];
+		return true;
+	}
+	if ( haveUnlisted ) {
+		position = unlisted[unlistedIndex++];
+		return true;
+	}
+	return false;
+}
+
 bool InputFiles::searchLibraries(const char* name, bool searchDylibs, bool searchArchives, bool dataSymbolOnly, ld::File::AtomHandler& handler) const
 {
-	// Check each input library.
-    for (std::vector<LibraryInfo>::const_iterator it=_searchLibraries.begin(); it != _searchLibraries.end(); ++it) {
-        LibraryInfo lib = *it;
+	updateProviderIndex();
+
+	// Check each input library that may define name, in command line order.
+	auto providers = _libraryProviders.find(name);
+	const std::vector<uint32_t>* listed = (providers != _libraryProviders.end()) ? &providers->second : nullptr;
+	size_t listedIndex = 0;
+	size_t unlistedIndex = 0;
+	uint32_t position;
+	while ( nextProvider(listed, listedIndex, _unlistedLibraries, unlistedIndex, position) ) {
+        const LibraryInfo& lib = _searchLibraries[position];
         if (lib.isDylib()) {
             if (searchDylibs) {
                 ld::dylib::File *dylibFile = lib.dylib();
@@ -1461,8 +1578,12 @@ bool InputFiles::searchLibraries(const char* name, bool searchDylibs, bool searc
 
 	// search indirect dylibs
 	if ( searchDylibs ) {
-		for (InstallNameToDylib::const_iterator it=_installPathToDylibs.begin(); it != _installPathToDylibs.end(); ++it) {
-			ld::dylib::File* dylibFile = it->second;
+		providers = _indirectDylibProviders.find(name);
+		listed = (providers != _indirectDylibProviders.end()) ? &providers->second : nullptr;
+		listedIndex = 0;
+		unlistedIndex = 0;
+		while ( nextProvider(listed, listedIndex, _unlistedIndirectDylibs, unlistedIndex, position) ) {
+			ld::dylib::File* dylibFile = _indirectDylibOrder[position];
 			bool searchThisDylib = false;
 			if ( _options.nameSpace() == Options::kTwoLevelNameSpace ) {
 				// for two level namesapce, just check all implicitly linked dylibs
@@ -1490,6 +1611,37 @@ bool InputFiles::searchLibraries(const char* name, bool searchDylibs, bool searc
 	return false;
 }
 
+void InputFiles::parseArchiveMembersAhead(const std::vector<std::string_view>& names) const
+{
+	// members parsed ahead stay in memory until loaded or dropped
+	if ( _options.memoryUsage().overBudget("archive parse ahead") )
+		return;
+
+	updateProviderIndex();
+
+	// Guess which archive searchLibraries() will load each name from: the first archive listing it,
+	// unless a dylib listing it comes first.  A wrong guess only costs a wasted parse.
+	std::map<uint32_t, std::vector<const char*>> namesByArchive;
+	for (const std::string_view& name : names) {
+		auto providers = _libraryProviders.find(name);
+		if ( (providers == _libraryProviders.end()) || providers->second.empty() )
+			continue;
+		uint32_t position = providers->second.front();
+		if ( !_searchLibraries[position].isDylib() )
+			namesByArchive[position].push_back(name.data());
+	}
+	for (const auto& entry : namesByArchive)
+		_searchLibraries[entry.first].archive()->parseMembersAhead(entry.second);
+}
+
+void InputFiles::dropArchiveMembersParsedAhead() const
+{
+	for (const LibraryInfo& lib : _searchLibraries) {
+		if ( !lib.isDylib() )
+			lib.archive()->dropMembersParsedAhead();
+	}
+}
+
 
 static bool vectorContains(const std::vector<ld::dylib::File*>& vec, ld::dylib::File* key)
 {
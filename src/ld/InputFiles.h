@@ -50,6 +50,8 @@
 
 #include "Options.h"
 #include "ld.hpp"
+#include "InputMappings.h"
+#include "InputCostReport.h"
 
 namespace ld {
 namespace tool {
@@ -67,6 +69,10 @@ public:
 	// searches libraries for name
 	bool						searchLibraries(const char* name, bool searchDylibs, bool searchArchives,  
 																  bool dataSymbolOnly, ld::File::AtomHandler&) const;
+	// parses ahead the archive members that searching for these names will probably load
+	void						parseArchiveMembersAhead(const std::vector<std::string_view>& names) const;
+	// frees archive members parsed ahead but never loaded
+	void						dropArchiveMembersParsedAhead() const;
 	// copy dylibs to link with in command line order
 	void						dylibs(ld::Internal& state);
 	const std::set<ld::dylib::File*>&		getAllDylibs() const { return _allDylibs; }
@@ -76,6 +82,8 @@ public:
 	void						addLinkerOptionLibraries(ld::Internal& state, ld::File::AtomHandler& handler);
 	void						createIndirectDylibs();
 	size_t						count() const { return _inputFiles.size(); }
+	const InputMappings&		mappings() const { return _mappings; }
+	InputCostReport&			costReport() { return _costReport; }
 
 	// for -print_statistics
 	volatile int64_t			_totalObjectSize;
@@ -89,6 +97,7 @@ private:
 	void						inferArchitecture(Options& opts, const char** archName);
 	const char* 				extractFileInfo(const uint8_t* p, unsigned len, const char* path, ld::Platform& platform);
 	ld::File*					makeFile(const Options::FileInfo& info, bool indirectDylib);
+	ld::File*					parseFile(const Options::FileInfo& info, bool indirectDylib, uint64_t& mappedLength);
 	ld::File*					addDylib(ld::dylib::File* f,        const Options::FileInfo& info);
 	void						logTraceInfo (const char* format, ...) const;
 	void						logDylib(ld::File*, bool indirect, bool speculative);
@@ -112,6 +121,8 @@ private:
 	typedef std::map<std::string, ld::dylib::File*>	InstallNameToDylib;
 
 	const Options&				_options;
+	InputMappings				_mappings;
+	InputCostReport				_costReport;
 	std::vector<ld::File*>		_inputFiles;
 	mutable std::set<class ld::File*>	_archiveFilesLogged;
 	mutable std::vector<std::string>	_archiveFilePaths;
@@ -150,8 +161,27 @@ private:
         bool isDylib() const { return _isDylib; }
         ld::dylib::File *dylib() const { return (ld::dylib::File*)_lib; }
         ld::archive::File *archive() const { return (ld::archive::File*)_lib; }
+        ld::File *file() const { return _lib; }
     };
     std::vector<LibraryInfo>  _searchLibraries;
+
+	// For searchLibraries(), the libraries that may define each name, so only those are searched.
+	// Positions index _searchLibraries, or _indirectDylibOrder for indirect dylibs, and are kept
+	// sorted so libraries are still searched in the same order.  Libraries that cannot list their
+	// names yet are searched for every name.
+	typedef ld::StringViewMap<std::vector<uint32_t>>	ProviderMap;
+	void						updateProviderIndex() const;
+	static void					addProviders(const ld::File* file, uint32_t position, ProviderMap& providers, std::vector<uint32_t>& unlisted);
+	static bool					nextProvider(const std::vector<uint32_t>* listed, size_t& listedIndex,
+											 const std::vector<uint32_t>& unlisted, size_t& unlistedIndex, uint32_t& position);
+
+	mutable ProviderMap						_libraryProviders;
+	mutable std::vector<uint32_t>			_unlistedLibraries;
+	mutable size_t							_indexedLibraryCount = 0;
+	mutable ProviderMap						_indirectDylibProviders;
+	mutable std::vector<uint32_t>			_unlistedIndirectDylibs;
+	mutable std::vector<ld::dylib::File*>	_indirectDylibOrder;
+	mutable size_t							_indexedInstallPathCount = 0;
 };
 
 } // namespace tool 
@@ -0,0 +1,306 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-*
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <mach-o/loader.h>
+#include <mach-o/nlist.h>
+#include <mach-o/reloc.h>
+
+#include <algorithm>
+
+#include "InputMappings.h"
+
+namespace ld {
+namespace tool {
+
+// how far the prefetcher may run ahead of the parsers
+static const uint64_t kPrefetchWindow		= 64*1024*1024;
+// large inputs (mostly archives and dylibs) are only read lazily, so just prime their start
+static const uint64_t kMaxPrefetchPerFile	= 8*1024*1024;
+
+
+InputMappings::InputMappings(const Options& opts)
+	: _options(opts)
+{
+	pthread_mutex_init(&_lock, NULL);
+	pthread_cond_init(&_parsedCond, NULL);
+	struct rusage usage;
+	if ( ::getrusage(RUSAGE_SELF, &usage) == 0 )
+		_startPageIns = usage.ru_majflt;
+}
+
+
+void InputMappings::startPrefetching(const std::vector<Options::FileInfo>& files)
+{
+	_prefetchedBytes.resize(files.size(), 0);
+	_parsed.resize(files.size(), false);
+	_prefetchGroup = dispatch_group_create();
+	dispatch_group_async(_prefetchGroup, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+		prefetchAll(&files);
+	});
+}
+
+
+void InputMappings::prefetchAll(const std::vector<Options::FileInfo>* files)
+{
+	for (size_t i=0; i < files->size(); ++i) {
+		const Options::FileInfo& info = (*files)[i];
+		pthread_mutex_lock(&_lock);
+		while ( !_stopPrefetch && (_bytesAhead > kPrefetchWindow) )
+			pthread_cond_wait(&_parsedCond, &_lock);
+		bool stop = _stopPrefetch;
+		bool skip = _parsed[i];
+		pthread_mutex_unlock(&_lock);
+		if ( stop )
+			break;
+		// inlined dylibs have no file, pipelined inputs may not be written yet
+		if ( skip || info.isInlined || info.fromFileList )
+			continue;
+		int fd = ::open(info.path, O_RDONLY, 0);
+		if ( fd == -1 )
+			continue;
+		uint64_t count = 0;
+		struct stat stat_buf;
+		if ( ::fstat(fd, &stat_buf) == 0 ) {
+			count = std::min((uint64_t)stat_buf.st_size, kMaxPrefetchPerFile);
+			struct radvisory advice;
+			advice.ra_offset = 0;
+			advice.ra_count  = (int)count;
+			if ( ::fcntl(fd, F_RDADVISE, &advice) == -1 )
+				count = 0;
+		}
+		::close(fd);
+		pthread_mutex_lock(&_lock);
+		if ( !_parsed[i] ) {
+			_prefetchedBytes[i] = count;
+			_bytesAhead += count;
+		}
+		pthread_mutex_unlock(&_lock);
+	}
+}
+
+
+void InputMappings::noteParsed(size_t index)
+{
+	pthread_mutex_lock(&_lock);
+	if ( index < _parsed.size() ) {
+		_parsed[index] = true;
+		_bytesAhead -= _prefetchedBytes[index];
+		_prefetchedBytes[index] = 0;
+		pthread_cond_signal(&_parsedCond);
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+
+void InputMappings::stopPrefetching()
+{
+	if ( _prefetchGroup == nullptr )
+		return;
+	pthread_mutex_lock(&_lock);
+	_stopPrefetch = true;
+	pthread_cond_broadcast(&_parsedCond);
+	pthread_mutex_unlock(&_lock);
+	dispatch_group_wait(_prefetchGroup, DISPATCH_TIME_FOREVER);
+	dispatch_release(_prefetchGroup);
+	_prefetchGroup = nullptr;
+}
+
+
+uint8_t* InputMappings::map(int fd, uint64_t offset, uint64_t length)
+{
+	// <rdar://problem/69569058>
+	// On macOS 10.15 MAP_RESILIENT_CODESIGN doesn't work, so we need to first try
+	// with the flag and then without it.
+	int flags = MAP_FILE | MAP_PRIVATE | MAP_RESILIENT_CODESIGN;
+	uint8_t* p = (uint8_t*)::mmap(NULL, length, PROT_READ, flags, fd, offset);
+	if ( p == MAP_FAILED ) {
+		flags &= ~MAP_RESILIENT_CODESIGN;
+		p = (uint8_t*)::mmap(NULL, length, PROT_READ, flags, fd, offset);
+		if ( p == MAP_FAILED )
+			return p;
+	}
+	pthread_mutex_lock(&_lock);
+	_mappedBytes += length;
+	pthread_mutex_unlock(&_lock);
+	return p;
+}
+
+
+void InputMappings::unmap(uint8_t* p, uint64_t length)
+{
+	::munmap((caddr_t)p, length);
+	pthread_mutex_lock(&_lock);
+	_mappedBytes -= length;
+	pthread_mutex_unlock(&_lock);
+}
+
+
+void InputMappings::noteMapped(const char* path, const uint8_t* p, uint64_t length)
+{
+	if ( !_options.traceInputPaging() )
+		return;
+	const uint64_t pageSize = ::getpagesize();
+	uintptr_t start = (uintptr_t)p & ~(pageSize-1);
+	uintptr_t end   = ((uintptr_t)p + length + pageSize - 1) & ~(pageSize-1);
+	std::vector<char> residency((end - start)/pageSize);
+	uint64_t nonResident = 0;
+	if ( ::mincore((caddr_t)start, end - start, residency.data()) == 0 ) {
+		for (char r : residency) {
+			if ( (r & MINCORE_INCORE) == 0 )
+				++nonResident;
+		}
+	}
+	pthread_mutex_lock(&_lock);
+	_fileStats.push_back({ path, length, nonResident });
+	pthread_mutex_unlock(&_lock);
+}
+
+
+void InputMappings::releaseParsedOnlyPages(const uint8_t* p, uint64_t length)
+{
+	if ( length < sizeof(mach_header_64) )
+		return;
+	const mach_header* mh = (const mach_header*)p;
+	bool is64;
+	if ( mh->magic == MH_MAGIC_64 )
+		is64 = true;
+	else if ( mh->magic == MH_MAGIC )
+		is64 = false;
+	else
+		return;
+	if ( mh->filetype != MH_OBJECT )
+		return;
+
+	// the nlist array and the relocations are only read while building atoms and fixups,
+	// the string pool and section content are still referenced by the parsed file
+	const uint8_t* cmds    = p + (is64 ? sizeof(mach_header_64) : sizeof(mach_header));
+	const uint8_t* cmdsEnd = cmds + mh->sizeofcmds;
+	if ( cmdsEnd > p + length )
+		return;
+	uint64_t released = 0;
+	for (const uint8_t* c = cmds; c + sizeof(load_command) <= cmdsEnd; ) {
+		const load_command* cmd = (const load_command*)c;
+		if ( (cmd->cmdsize < sizeof(load_command)) || (c + cmd->cmdsize > cmdsEnd) )
+			return;
+		switch ( cmd->cmd ) {
+			case LC_SYMTAB: {
+				const symtab_command* symtab = (const symtab_command*)cmd;
+				released += release(symtab->symoff, (uint64_t)symtab->nsyms * (is64 ? sizeof(struct nlist_64) : sizeof(struct nlist)), p, length);
+				break;
+			}
+			case LC_SEGMENT_64: {
+				const segment_command_64* seg = (const segment_command_64*)cmd;
+				const section_64* sects = (const section_64*)(seg+1);
+				if ( (const uint8_t*)&sects[seg->nsects] > c + cmd->cmdsize )
+					return;
+				for (uint32_t i=0; i < seg->nsects; ++i)
+					released += release(sects[i].reloff, (uint64_t)sects[i].nreloc * sizeof(relocation_info), p, length);
+				break;
+			}
+			case LC_SEGMENT: {
+				const segment_command* seg = (const segment_command*)cmd;
+				const section* sects = (const section*)(seg+1);
+				if ( (const uint8_t*)&sects[seg->nsects] > c + cmd->cmdsize )
+					return;
+				for (uint32_t i=0; i < seg->nsects; ++i)
+					released += release(sects[i].reloff, (uint64_t)sects[i].nreloc * sizeof(relocation_info), p, length);
+				break;
+			}
+		}
+		c += cmd->cmdsize;
+	}
+	pthread_mutex_lock(&_lock);
+	_releasedBytes += released;
+	pthread_mutex_unlock(&_lock);
+}
+
+
+uint64_t InputMappings::release(uint64_t offset, uint64_t size, const uint8_t* p, uint64_t length)
+{
+	if ( (size == 0) || (offset > length) || (size > length - offset) )
+		return 0;
+	// only whole pages inside the range, neighboring data may still be in use.
+	// The mapping is private and read-only, so a later touch just reads the file again.
+	const uint64_t pageSize = ::getpagesize();
+	uintptr_t start = ((uintptr_t)p + offset + pageSize - 1) & ~(pageSize-1);
+	uintptr_t end   = ((uintptr_t)p + offset + size) & ~(pageSize-1);
+	if ( (end <= start) || (::madvise((caddr_t)start, end - start, MADV_DONTNEED) != 0) )
+		return 0;
+	return end - start;
+}
+
+
+void InputMappings::noteRetained(const uint8_t* p, uint64_t length)
+{
+	if ( _options.memoryUsage().budget() == 0 )
+		return;
+	pthread_mutex_lock(&_lock);
+	_retained.push_back({ p, length });
+	pthread_mutex_unlock(&_lock);
+}
+
+
+void InputMappings::releaseAllPages()
+{
+	pthread_mutex_lock(&_lock);
+	for (const Region& region : _retained)
+		_releasedBytes += release(0, region.length, region.start, region.length);
+	pthread_mutex_unlock(&_lock);
+}
+
+
+void InputMappings::printStatistics() const
+{
+	const uint64_t pageSize = ::getpagesize();
+	uint64_t totalPages = 0;
+	uint64_t totalNonResident = 0;
+	fprintf(stderr, "input file residency when mapped:\n");
+	for (const FileStats& stats : _fileStats) {
+		uint64_t pages = (stats.length + pageSize - 1)/pageSize;
+		totalPages += pages;
+		totalNonResident += stats.nonResidentPages;
+		fprintf(stderr, "  %8llu of %8llu pages not resident: %s\n", stats.nonResidentPages, pages, stats.path);
+	}
+	fprintf(stderr, "  %8llu of %8llu pages not resident in total\n", totalNonResident, totalPages);
+	fprintf(stderr, "input bytes mapped at the end of the link: %llu\n", _mappedBytes);
+	fprintf(stderr, "input bytes given back with madvise(): %llu\n", _releasedBytes);
+	// page-ins are only counted for the whole process, the linker's own pages included
+	struct rusage usage;
+	if ( ::getrusage(RUSAGE_SELF, &usage) == 0 )
+		fprintf(stderr, "page faults read from disk during the link: %ld\n", usage.ru_majflt - _startPageIns);
+}
+
+} // namespace tool
+} // namespace ld
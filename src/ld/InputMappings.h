@@ -0,0 +1,110 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-*
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef __INPUT_MAPPINGS_H__
+#define __INPUT_MAPPINGS_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <dispatch/dispatch.h>
+
+#include <vector>
+
+#include "Options.h"
+
+namespace ld {
+namespace tool {
+
+//
+// Owns the read-only mappings of input files.
+//
+// While parser threads work through the command line inputs, a background task asks the
+// kernel to start reading the files just ahead of them, staying at most a fixed number
+// of bytes ahead so that prefetched pages are not evicted before they are parsed.
+// Once an object file is parsed, the pages holding its symbol table and relocations are
+// given back, since they are only read during parsing.  With -trace_input_paging,
+// records how many pages of each input were not resident when it was mapped, which is
+// how many the parser will fault in from disk unless the prefetcher gets to them first.
+//
+class InputMappings
+{
+public:
+								InputMappings(const Options& opts);
+
+	// starts prefetching the command line inputs in order, in the background
+	void						startPrefetching(const std::vector<Options::FileInfo>& files);
+	// called when the input at index is parsed, lets the prefetcher move further ahead
+	void						noteParsed(size_t index);
+	// stops the prefetcher and waits for it
+	void						stopPrefetching();
+
+	// maps length bytes of fd starting at offset, returns MAP_FAILED and sets errno on failure
+	uint8_t*					map(int fd, uint64_t offset, uint64_t length);
+	void						unmap(uint8_t* p, uint64_t length);
+	// called with the final bytes of an input before parsing, for -trace_input_paging
+	void						noteMapped(const char* path, const uint8_t* p, uint64_t length);
+	// drops pages of a parsed mach-o object file that the linker does not read again
+	void						releaseParsedOnlyPages(const uint8_t* p, uint64_t length);
+	// called with the content of an input whose parsed file keeps it mapped until the end of the link
+	void						noteRetained(const uint8_t* p, uint64_t length);
+	// drops the resident pages of every retained input, for -memory_budget
+	void						releaseAllPages();
+
+	uint64_t					mappedBytes() const			{ return _mappedBytes; }
+	uint64_t					releasedBytes() const		{ return _releasedBytes; }
+	void						printStatistics() const;
+
+private:
+	struct FileStats {
+		const char*			path;
+		uint64_t			length;
+		uint64_t			nonResidentPages;
+	};
+	struct Region {
+		const uint8_t*		start;
+		uint64_t			length;
+	};
+
+	void						prefetchAll(const std::vector<Options::FileInfo>* files);
+	uint64_t					release(uint64_t offset, uint64_t size, const uint8_t* p, uint64_t length);
+
+	const Options&				_options;
+	pthread_mutex_t				_lock;
+	pthread_cond_t				_parsedCond;
+	dispatch_group_t			_prefetchGroup	= nullptr;
+	std::vector<uint64_t>		_prefetchedBytes;		// per input, zero until prefetched
+	std::vector<bool>			_parsed;
+	uint64_t					_bytesAhead		= 0;	// prefetched but not yet parsed
+	bool						_stopPrefetch	= false;
+	uint64_t					_mappedBytes	= 0;	// currently mapped
+	uint64_t					_releasedBytes	= 0;	// pages given back with madvise(), counted once per release
+	long						_startPageIns	= 0;
+	std::vector<FileStats>		_fileStats;
+	std::vector<Region>			_retained;
+};
+
+} // namespace tool
+} // namespace ld
+
+#endif // __INPUT_MAPPINGS_H__
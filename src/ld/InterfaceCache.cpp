@@ -0,0 +1,279 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-*
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <tapi/tapi.h>
+
+#include "InterfaceCache.h"
+
+extern const char ld_classicVersionString[];
+
+namespace ld {
+namespace tool {
+
+// bump when the entry layout or what is recorded changes
+static const uint32_t	kEntryVersion	= 1;
+static const char		kEntryMagic[8]	= { 'l', 'd', 'i', 'f', 'c', '\0', '\0', '\0' };
+
+//
+// Entry layout:
+//		EntryHeader
+//		key bytes
+//		payload: little endian uint32s, bytes and NUL terminated strings, see store()
+//
+struct EntryHeader {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	keySize;
+	uint64_t	payloadSize;
+};
+
+
+namespace {
+
+class Writer
+{
+public:
+	void	u8(uint8_t value)				{ _bytes.push_back(value); }
+	void	u32(uint32_t value)				{ for (int i=0; i < 4; ++i) _bytes.push_back((uint8_t)(value >> (8*i))); }
+	void	str(const char* s)				{ _bytes.insert(_bytes.end(), s, s+strlen(s)+1); }
+	void	strs(const std::vector<const char*>& list) {
+				u32((uint32_t)list.size());
+				for (const char* s : list)
+					str(s);
+			}
+	const std::vector<uint8_t>&	bytes() const	{ return _bytes; }
+private:
+	std::vector<uint8_t>	_bytes;
+};
+
+class Reader
+{
+public:
+			Reader(const uint8_t* start, const uint8_t* end) : _p(start), _end(end) { }
+	bool	ok() const						{ return _ok; }
+	uint8_t	u8() {
+				if ( _p + 1 > _end ) { _ok = false; return 0; }
+				return *_p++;
+			}
+	uint32_t u32() {
+				if ( _p + 4 > _end ) { _ok = false; return 0; }
+				uint32_t value = 0;
+				for (int i=0; i < 4; ++i)
+					value |= (uint32_t)(*_p++) << (8*i);
+				return value;
+			}
+	const char* str() {
+				const uint8_t* nul = (const uint8_t*)memchr(_p, '\0', _end - _p);
+				if ( !_ok || (nul == NULL) ) { _ok = false; return ""; }
+				const char* result = (const char*)_p;
+				_p = nul + 1;
+				return result;
+			}
+	void	strs(std::vector<const char*>& list) {
+				uint32_t count = u32();
+				// every string takes at least one byte, which bounds bogus counts
+				if ( count > (uint32_t)(_end - _p) ) { _ok = false; return; }
+				list.reserve(count);
+				for (uint32_t i=0; _ok && (i < count); ++i)
+					list.push_back(str());
+			}
+	size_t	remaining() const				{ return _end - _p; }
+private:
+	const uint8_t*	_p;
+	const uint8_t*	_end;
+	bool			_ok = true;
+};
+
+} // anonymous namespace
+
+
+std::string InterfaceCache::makeKey(const char* path, uint64_t fileLength, time_t modTime, cpu_type_t cpuType,
+									cpu_subtype_t cpuSubType, uint32_t parseFlags, uint32_t minOSVersion)
+{
+	char numbers[128];
+	snprintf(numbers, sizeof(numbers), "|%llu|%lld|%d|%d|0x%X|0x%X", (unsigned long long)fileLength, (long long)modTime,
+			 cpuType, cpuSubType, parseFlags, minOSVersion);
+	// an entry is only valid for the linker and libtapi that wrote it, since either may change
+	// what a parse of the same file produces
+	static const std::string toolVersions = std::string("|") + ld_classicVersionString + "|" + tapi::Version::getFullVersionAsString();
+	std::string key = path;
+	key += numbers;
+	key += toolVersions;
+	return key;
+}
+
+
+std::string InterfaceCache::entryPath(const char* dir, const std::string& key)
+{
+	// FNV-1a of the key names the entry, the key itself is checked when it is read
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (char c : key) {
+		hash ^= (uint8_t)c;
+		hash *= 0x100000001b3ULL;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.ifc", (unsigned long long)hash);
+	return std::string(dir) + name;
+}
+
+
+bool InterfaceCache::lookup(const char* dir, const std::string& key, Interface& result)
+{
+	std::string path = entryPath(dir, key);
+	int fd = ::open(path.c_str(), O_RDONLY, 0);
+	if ( fd == -1 )
+		return false;
+	struct stat statBuf;
+	if ( (::fstat(fd, &statBuf) != 0) || (statBuf.st_size < (off_t)sizeof(EntryHeader)) ) {
+		::close(fd);
+		return false;
+	}
+	uint64_t length = statBuf.st_size;
+	uint8_t* p = (uint8_t*)::mmap(NULL, length, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
+	::close(fd);
+	if ( p == (uint8_t*)MAP_FAILED )
+		return false;
+
+	const EntryHeader* header = (EntryHeader*)p;
+	const uint8_t* keyStart = p + sizeof(EntryHeader);
+	bool valid = (memcmp(header->magic, kEntryMagic, sizeof(kEntryMagic)) == 0)
+				&& (header->version == kEntryVersion)
+				&& (header->keySize == key.size())
+				&& (sizeof(EntryHeader) + (uint64_t)header->keySize + header->payloadSize == length)
+				&& (memcmp(keyStart, key.data(), key.size()) == 0);
+	if ( !valid ) {
+		::munmap(p, length);
+		return false;
+	}
+
+	Interface interface;
+	Reader reader(keyStart + header->keySize, p + length);
+	interface.installName = reader.str();
+	if ( reader.u8() )
+		interface.parentUmbrella = reader.str();
+	interface.currentVersion				= reader.u32();
+	interface.compatibilityVersion			= reader.u32();
+	interface.swiftVersion					= reader.u8();
+	uint8_t flags							= reader.u8();
+	interface.installNameVersionSpecific	= (flags & 1);
+	interface.applicationExtensionSafe		= (flags & 2);
+	interface.twoLevelNamespace				= (flags & 4);
+	interface.hasWeakDefinedExports			= (flags & 8);
+	reader.strs(interface.allowableClients);
+	reader.strs(interface.rpaths);
+	uint32_t platformCount = reader.u32();
+	if ( platformCount > reader.remaining() / 12 )
+		valid = false;
+	for (uint32_t i=0; valid && (i < platformCount); ++i) {
+		uint32_t platform = reader.u32();
+		uint32_t minVersion = reader.u32();
+		uint32_t sdkVersion = reader.u32();
+		interface.platforms.emplace_back((ld::Platform)platform, minVersion, sdkVersion);
+	}
+	reader.strs(interface.reexportedLibraries);
+	reader.strs(interface.ignoreExports);
+	reader.strs(interface.undefineds);
+	uint32_t exportCount = reader.u32();
+	if ( exportCount > reader.remaining() / 2 )
+		valid = false;
+	else
+		interface.exports.reserve(exportCount);
+	for (uint32_t i=0; valid && reader.ok() && (i < exportCount); ++i) {
+		uint8_t exportFlags = reader.u8();
+		interface.exports.push_back({ reader.str(), (exportFlags & 1) != 0, (exportFlags & 2) != 0 });
+	}
+	if ( !valid || !reader.ok() || (reader.remaining() != 0) ) {
+		::munmap(p, length);
+		return false;
+	}
+	// the mapping is never unmapped, interface points into it
+	result = std::move(interface);
+	return true;
+}
+
+
+void InterfaceCache::store(const char* dir, const std::string& key, const Interface& interface)
+{
+	Writer writer;
+	writer.str(interface.installName);
+	writer.u8(interface.parentUmbrella != nullptr);
+	if ( interface.parentUmbrella != nullptr )
+		writer.str(interface.parentUmbrella);
+	writer.u32(interface.currentVersion);
+	writer.u32(interface.compatibilityVersion);
+	writer.u8(interface.swiftVersion);
+	writer.u8((interface.installNameVersionSpecific ? 1 : 0) | (interface.applicationExtensionSafe ? 2 : 0)
+			  | (interface.twoLevelNamespace ? 4 : 0) | (interface.hasWeakDefinedExports ? 8 : 0));
+	writer.strs(interface.allowableClients);
+	writer.strs(interface.rpaths);
+	writer.u32((uint32_t)interface.platforms.size());
+	for (const ld::PlatformVersion& platform : interface.platforms) {
+		writer.u32((uint32_t)platform.platform);
+		writer.u32(platform.minVersion);
+		writer.u32(platform.sdkVersion);
+	}
+	writer.strs(interface.reexportedLibraries);
+	writer.strs(interface.ignoreExports);
+	writer.strs(interface.undefineds);
+	writer.u32((uint32_t)interface.exports.size());
+	for (const Export& exp : interface.exports) {
+		writer.u8((exp.weakDef ? 1 : 0) | (exp.tlv ? 2 : 0));
+		writer.str(exp.name);
+	}
+
+	EntryHeader header;
+	memcpy(header.magic, kEntryMagic, sizeof(kEntryMagic));
+	header.version		= kEntryVersion;
+	header.keySize		= (uint32_t)key.size();
+	header.payloadSize	= writer.bytes().size();
+
+	// write to a temporary file and rename it into place, so a concurrent reader sees the whole entry or none
+	::mkdir(dir, 0777);
+	std::string path = entryPath(dir, key);
+	std::string tempPath = path + ".XXXXXX";
+	int fd = ::mkstemp(&tempPath[0]);
+	if ( fd == -1 )
+		return;
+	::fchmod(fd, 0644);
+	bool written = (::write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header))
+				&& (::write(fd, key.data(), key.size()) == (ssize_t)key.size())
+				&& (::write(fd, writer.bytes().data(), writer.bytes().size()) == (ssize_t)writer.bytes().size());
+	::close(fd);
+	if ( !written || (::rename(tempPath.c_str(), path.c_str()) != 0) )
+		::unlink(tempPath.c_str());
+}
+
+} // namespace tool
+} // namespace ld
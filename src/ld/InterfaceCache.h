@@ -0,0 +1,96 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-*
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifndef __INTERFACE_CACHE_H__
+#define __INTERFACE_CACHE_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <mach/machine.h>
+
+#include <string>
+#include <vector>
+
+#include "ld.hpp"
+
+namespace ld {
+namespace tool {
+
+//
+// A cache of parsed text-based dylib stubs (.tbd files) shared by all linker processes
+// pointed at the same directory with -interface_cache_dir.
+//
+// Each entry is one file holding everything the linker takes from a parsed .tbd for one
+// target (install name, versions, platforms, re-exports, exports, ...).  Entries are
+// written to a temporary file and renamed into place, so readers never see a partial
+// entry.  Readers map entries read-only and keep them mapped, so the strings in an
+// Interface read from the cache live in pages shared with every other linker process.
+//
+class InterfaceCache
+{
+public:
+	struct Export {
+		const char*		name;
+		bool			weakDef;
+		bool			tlv;
+	};
+
+	struct Interface {
+		const char*						installName					= nullptr;
+		const char*						parentUmbrella				= nullptr;
+		uint32_t						currentVersion				= 0;
+		uint32_t						compatibilityVersion		= 0;
+		uint8_t							swiftVersion				= 0;
+		bool							installNameVersionSpecific	= false;
+		bool							applicationExtensionSafe	= false;
+		bool							twoLevelNamespace			= true;
+		bool							hasWeakDefinedExports		= false;
+		std::vector<const char*>		allowableClients;
+		std::vector<const char*>		rpaths;
+		std::vector<ld::PlatformVersion> platforms;
+		std::vector<const char*>		reexportedLibraries;
+		std::vector<const char*>		ignoreExports;
+		std::vector<const char*>		undefineds;				// only for flat namespace dylibs
+		std::vector<Export>				exports;
+	};
+
+	// identifies one parse of a .tbd file: the file itself, every option the parse depends on,
+	// and the versions of the linker and libtapi doing the parse
+	static std::string		makeKey(const char* path, uint64_t fileLength, time_t modTime, cpu_type_t cpuType,
+									cpu_subtype_t cpuSubType, uint32_t parseFlags, uint32_t minOSVersion);
+
+	// fills in result and returns true if dir holds an entry for key
+	static bool				lookup(const char* dir, const std::string& key, Interface& result);
+	// adds an entry for key to dir, failures are ignored because the cache is only an optimization
+	static void				store(const char* dir, const std::string& key, const Interface& interface);
+
+private:
+	static std::string		entryPath(const char* dir, const std::string& key);
+};
+
+} // namespace tool
+} // namespace ld
+
+#endif // __INTERFACE_CACHE_H__
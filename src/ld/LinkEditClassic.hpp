@@ -30,11 +30,13 @@
 #include <errno.h>
 #include <limits.h>
 #include <unistd.h>
+#include <dispatch/dispatch.h>
 
 #include "Options.h"
 #include "ld.hpp"
 #include "Architectures.hpp"
 #include "MachOFileAbstraction.hpp"
+#include "SuffixStringTable.h"
 #include "Containers.h"
 
 namespace ld {
@@ -70,6 +72,62 @@ protected:
 
 
 
+//
+// Strings for one slice of the symbol table, built on its own thread and then appended
+// to the StringPoolAtom in a fixed order.  Offsets are relative to the start of the slice
+// until the slice is appended, then finalOffset() maps them to string pool offsets.
+//
+class StringSubPool
+{
+public:
+												StringSubPool(bool unique, bool tailMerge) : _unique(unique), _tailMerge(tailMerge) { }
+
+	int32_t										add(const char* name);
+	int32_t										addUnique(const char* name);
+	uint32_t									finalOffset(int32_t offset) const;
+
+private:
+	friend class StringPoolAtom;
+
+	std::vector<char>						_buffer;
+	CStringMap<int32_t>						_uniqueStrings;
+	std::vector<int32_t>					_starts;		// only recorded for tail merging
+	std::vector<uint32_t>					_mergedOffsets;
+	uint32_t								_base = 0;
+	bool									_unique;
+	bool									_tailMerge;
+};
+
+int32_t StringSubPool::add(const char* str)
+{
+	int32_t offset = _buffer.size();
+	_buffer.insert(_buffer.end(), str, str + strlen(str) + 1);
+	if ( _tailMerge )
+		_starts.push_back(offset);
+	return offset;
+}
+
+uint32_t StringSubPool::finalOffset(int32_t offset) const
+{
+	if ( !_tailMerge )
+		return _base + offset;
+	size_t index = std::lower_bound(_starts.begin(), _starts.end(), offset) - _starts.begin();
+	return _mergedOffsets[index];
+}
+
+int32_t StringSubPool::addUnique(const char* str)
+{
+	if ( !_unique )
+		return this->add(str);
+	auto pos = _uniqueStrings.find(str);
+	if ( pos != _uniqueStrings.end() )
+		return pos->second;
+	int32_t offset = this->add(str);
+	_uniqueStrings[str] = offset;
+	return offset;
+}
+
+
 class StringPoolAtom : public ClassicLinkEditAtom
 {
 public:
@@ -88,17 +146,25 @@ public:
 	int32_t										emptyString()			{ return 1; }
 	const char*									stringForIndex(int32_t) const;
 	uint32_t									currentOffset();
+	void										append(StringSubPool& subPool);
+	void										appendTailMerged(const std::vector<StringSubPool*>& subPools);
+	uint64_t									tailMergedBytes() const	{ return _tailMergedBytes; }
+	bool										uniquing() const		{ return !_skipUniquing; }
 
 private:
 	enum { kBufferSize = 0x01000000 };
 	using StringToOffset = CStringMap<int32_t>;
 
+	void									appendBytes(const char* bytes, size_t size);
+	void									addUniqueStrings(const StringSubPool& subPool);
+
 	const uint32_t							_pointerSize;
 	std::vector<char*>						_fullBuffers;
 	char*									_currentBuffer;
 	uint32_t								_currentBufferUsed;
 	StringToOffset							_uniqueStrings;
 	bool									_skipUniquing;
+	uint64_t								_tailMergedBytes = 0;
 
 	static ld::Section			_s_section;
 };
@@ -169,6 +235,63 @@ uint32_t StringPoolAtom::currentOffset()
 	return kBufferSize * _fullBuffers.size() + _currentBufferUsed;
 }
 
+void StringPoolAtom::appendBytes(const char* src, size_t remaining)
+{
+	while ( remaining != 0 ) {
+		if ( _currentBufferUsed == kBufferSize ) {
+			// alloc next buffer
+			_fullBuffers.push_back(_currentBuffer);
+			_currentBuffer = new char[kBufferSize];
+			_currentBufferUsed = 0;
+		}
+		size_t amount = std::min(remaining, (size_t)(kBufferSize - _currentBufferUsed));
+		memcpy(&_currentBuffer[_currentBufferUsed], src, amount);
+		_currentBufferUsed += amount;
+		src                += amount;
+		remaining          -= amount;
+	}
+}
+
+void StringPoolAtom::addUniqueStrings(const StringSubPool& subPool)
+{
+	// later addUnique() calls (stabs) can share strings from the slice
+	if ( !_skipUniquing ) {
+		for (const auto& entry : subPool._uniqueStrings)
+			_uniqueStrings.insert(std::make_pair(entry.first, (int32_t)subPool.finalOffset(entry.second)));
+	}
+}
+
+void StringPoolAtom::append(StringSubPool& subPool)
+{
+	subPool._base = this->currentOffset();
+	this->appendBytes(subPool._buffer.data(), subPool._buffer.size());
+	this->addUniqueStrings(subPool);
+}
+
+void StringPoolAtom::appendTailMerged(const std::vector<StringSubPool*>& subPools)
+{
+	ld::SuffixStringTable table;
+	for (const StringSubPool* subPool : subPools) {
+		for (int32_t start : subPool->_starts) {
+			const char* str = &subPool->_buffer[start];
+			table.add(str, strlen(str));
+		}
+	}
+	table.finalize();
+	std::vector<char> merged(table.size());
+	table.copyTo(merged.data());
+	uint32_t base = this->currentOffset();
+	this->appendBytes(merged.data(), merged.size());
+	size_t index = 0;
+	for (StringSubPool* subPool : subPools) {
+		subPool->_mergedOffsets.resize(subPool->_starts.size());
+		for (uint32_t& offset : subPool->_mergedOffsets)
+			offset = base + (uint32_t)table.offset(index++);
+		this->addUniqueStrings(*subPool);
+	}
+	_tailMergedBytes += table.unmergedSize() - table.size();
+}
+
 
 int32_t StringPoolAtom::addUnique(const char* str)
 {
@@ -229,9 +352,10 @@ private:
 	typedef typename A::P::E					E;
 	typedef typename A::P::uint_t				pint_t;
 
-	bool							addLocal(const ld::Atom* atom, StringPoolAtom* pool);
-	void							addGlobal(const ld::Atom* atom, StringPoolAtom* pool);
-	void							addImport(const ld::Atom* atom, StringPoolAtom* pool);
+	bool							addLocal(const ld::Atom* atom, StringSubPool& pool, int& anonNameIndex);
+	void							addGlobal(const ld::Atom* atom, StringSubPool& pool, int& anonNameIndex);
+	void							addImport(const ld::Atom* atom, StringSubPool& pool);
+	void							rebaseStringOffsets(std::vector<macho_nlist<P> >& entries, const StringSubPool& strings);
 	uint8_t							classicOrdinalForProxy(const ld::Atom* atom);
 	uint32_t						stringOffsetForStab(const ld::relocatable::File::Stab& stab, StringPoolAtom* pool);
 	uint64_t						valueForStab(const ld::relocatable::File::Stab& stab);
@@ -290,7 +414,7 @@ bool SymbolTableAtom<A>::isAltEntry(const ld::Atom* atom)
 }
 
 template <typename A>
-bool SymbolTableAtom<A>::addLocal(const ld::Atom* atom, StringPoolAtom* pool) 
+bool SymbolTableAtom<A>::addLocal(const ld::Atom* atom, StringSubPool& pool, int& anonNameIndex) 
 {
 	macho_nlist<P> entry;
 	assert(atom->symbolTableInclusion() != ld::Atom::symbolTableNotIn);
@@ -310,7 +434,7 @@ bool SymbolTableAtom<A>::addLocal(const ld::Atom* atom, StringPoolAtom* pool)
 				// don't use 'l' labels for x86_64 strings
 				// <rdar://problem/6605499> x86_64 obj-c runtime confused when static lib is stripped
 				char* anonName;
-				asprintf(&anonName, "LC%u", _s_anonNameIndex++);
+				asprintf(&anonName, "LC%u", anonNameIndex++);
 				symbolName = anonName;
 			}
 		}
@@ -326,14 +450,14 @@ bool SymbolTableAtom<A>::addLocal(const ld::Atom* atom, StringPoolAtom* pool)
 		else if ( atom->symbolTableInclusion() == ld::Atom::symbolTableInWithRandomAutoStripLabel ) {
 			// make auto-strip anonymous name for symbol
 			char* anonName;
-			asprintf(&anonName, "l%03u", _s_anonNameIndex++);
+			asprintf(&anonName, "l%03u", anonNameIndex++);
 			//fprintf(stderr, "rename %s to %s\n", symbolName, anonName);
 			symbolName = anonName;
 		}
 	}
 
 	// <rdar://problem/43388350> ER: Coalesce the string pools for the symbol table when linking objects together
-	entry.set_n_strx(pool->addUnique(symbolName));
+	entry.set_n_strx(pool.addUnique(symbolName));
 
 	// set n_type
 	uint8_t type = N_SECT;
@@ -382,7 +506,7 @@ bool SymbolTableAtom<A>::addLocal(const ld::Atom* atom, StringPoolAtom* pool)
 
 
 template <typename A>
-void SymbolTableAtom<A>::addGlobal(const ld::Atom* atom, StringPoolAtom* pool) 
+void SymbolTableAtom<A>::addGlobal(const ld::Atom* atom, StringSubPool& pool, int& anonNameIndex) 
 {
 	macho_nlist<P> entry;
 
@@ -392,11 +516,11 @@ void SymbolTableAtom<A>::addGlobal(const ld::Atom* atom, StringPoolAtom* pool)
 	if ( this->_options.outputKind() == Options::kObjectFile ) {
 		if ( atom->symbolTableInclusion() == ld::Atom::symbolTableInWithRandomAutoStripLabel ) {
 			// make auto-strip anonymous name for symbol 
-			sprintf(anonName, "l%03u", _s_anonNameIndex++);
+			sprintf(anonName, "l%03u", anonNameIndex++);
 			symbolName = anonName;
 		}
 	}
-	entry.set_n_strx(pool->add(symbolName));
+	entry.set_n_strx(pool.add(symbolName));
 
 	// set n_type
 	if ( atom->definition() == ld::Atom::definitionAbsolute ) {
@@ -463,7 +587,7 @@ void SymbolTableAtom<A>::addGlobal(const ld::Atom* atom, StringPoolAtom* pool)
 			for (ld::Fixup::iterator fit = atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit) {
 				if ( fit->kind == ld::Fixup::kindNoneFollowOn ) {
 					assert(fit->binding == ld::Fixup::bindingDirectlyBound);
-					entry.set_n_value(pool->add(fit->u.target->name()));
+					entry.set_n_value(pool.add(fit->u.target->name()));
 				}
 			}
 		}
@@ -501,12 +625,12 @@ uint8_t	SymbolTableAtom<A>::classicOrdinalForProxy(const ld::Atom* atom)
 
 
 template <typename A>
-void SymbolTableAtom<A>::addImport(const ld::Atom* atom, StringPoolAtom* pool) 
+void SymbolTableAtom<A>::addImport(const ld::Atom* atom, StringSubPool& pool) 
 {
 	macho_nlist<P> entry;
 
 	// set n_strx
-	entry.set_n_strx(pool->add(atom->name()));
+	entry.set_n_strx(pool.add(atom->name()));
 
 	// set n_type
 	if ( this->_options.outputKind() == Options::kObjectFile ) {
@@ -570,10 +694,10 @@ void SymbolTableAtom<A>::addImport(const ld::Atom* atom, StringPoolAtom* pool)
 			assert(fit->kind == ld::Fixup::kindNoneFollowOn);
 			switch ( fit->binding ) {
 				case ld::Fixup::bindingByNameUnbound:
-					entry.set_n_value(pool->add(fit->u.name));
+					entry.set_n_value(pool.add(fit->u.name));
 					break;
 				case ld::Fixup::bindingsIndirectlyBound:
-					entry.set_n_value(pool->add((_state.indirectBindingTable[fit->u.bindingIndex])->name()));
+					entry.set_n_value(pool.add((_state.indirectBindingTable[fit->u.bindingIndex])->name()));
 					break;
 				default:
 					assert(0 && "internal error: unexpected alias binding");
@@ -585,6 +709,17 @@ void SymbolTableAtom<A>::addImport(const ld::Atom* atom, StringPoolAtom* pool)
 	_imports.push_back(entry);
 }
 
+template <typename A>
+void SymbolTableAtom<A>::rebaseStringOffsets(std::vector<macho_nlist<P> >& entries, const StringSubPool& strings)
+{
+	for (macho_nlist<P>& entry : entries) {
+		entry.set_n_strx(strings.finalOffset(entry.n_strx()));
+		// re-exports and aliases hold the string offset of the target name in n_value
+		if ( (entry.n_type() & N_TYPE) == N_INDR )
+			entry.set_n_value(strings.finalOffset((int32_t)entry.n_value()));
+	}
+}
+
 template <typename A>
 uint8_t SymbolTableAtom<A>::sectionIndexForStab(const ld::relocatable::File::Stab& stab)
 {
@@ -664,11 +799,13 @@ uint32_t SymbolTableAtom<A>::stringOffsetForStab(const ld::relocatable::File::St
 {
 	switch (stab.type) {
 		case N_SO:
+		case N_OSO:
+		case N_AST:
 			if ( (stab.string == NULL) || stab.string[0] == '\0' ) {
 				return pool->emptyString();
 				break;
 			}
-			// fall into uniquing case
+			// fall into uniquing case, object and AST paths repeat across translation units
 			[[clang::fallthrough]];
 		case N_SOL:
 		case N_BINCL:
@@ -709,26 +846,70 @@ void SymbolTableAtom<A>::encode()
 	// reserve space for local symbols
 	uint32_t localsCount = _state.stabs.size() + this->_writer._localAtoms.size();
 
-	// make nlist entries for all global symbols
+	// anonymous labels in -r output are numbered as if globals were encoded before locals
 	std::vector<const ld::Atom*>& globalAtoms = this->_writer._exportedAtoms;
-	_globals.reserve(globalAtoms.size());
-	for (const ld::Atom* atom : globalAtoms) {
-		this->addGlobal(atom, this->_writer._stringPoolAtom);
-	}
-
-	// make nlist entries for all undefined (imported) symbols
 	std::vector<const ld::Atom*>& importAtoms = this->_writer._importedAtoms;
-	_imports.reserve(importAtoms.size());
-	for (const ld::Atom* atom : importAtoms) {
-		this->addImport(atom, this->_writer._stringPoolAtom);
+	std::vector<const ld::Atom*>& localAtoms  = this->_writer._localAtoms;
+	__block int globalAnonNameIndex = _s_anonNameIndex;
+	__block int localAnonNameIndex  = _s_anonNameIndex;
+	if ( this->_options.outputKind() == Options::kObjectFile ) {
+		for (const ld::Atom* atom : globalAtoms) {
+			if ( atom->symbolTableInclusion() == ld::Atom::symbolTableInWithRandomAutoStripLabel )
+				++localAnonNameIndex;
+		}
 	}
 
-	// go back to start and make nlist entries for all local symbols
-	std::vector<const ld::Atom*>& localAtoms = this->_writer._localAtoms;
-	_locals.reserve(localsCount);
-	for (const ld::Atom* atom : localAtoms) {
-		this->addLocal(atom, this->_writer._stringPoolAtom);
+	// make nlist entries for global, undefined (imported) and local symbols in parallel,
+	// each slice with its own strings which are then appended to the string pool in that order
+	StringPoolAtom* pool = this->_writer._stringPoolAtom;
+	const bool tailMerge = this->_options.tailMergeStrings();
+	__block StringSubPool globalStrings(false, tailMerge);
+	__block StringSubPool importStrings(false, tailMerge);
+	__block StringSubPool localStrings(pool->uniquing(), tailMerge);
+	// each slice records its own error, the first slice's error is thrown so the message does not depend on timing
+	__block std::vector<const char*> exceptionMsgs(3, nullptr);
+	dispatch_apply(3, DISPATCH_APPLY_AUTO, ^(size_t slice) {
+		try {
+			switch ( slice ) {
+				case 0:
+					_globals.reserve(globalAtoms.size());
+					for (const ld::Atom* atom : globalAtoms)
+						this->addGlobal(atom, globalStrings, globalAnonNameIndex);
+					break;
+				case 1:
+					_imports.reserve(importAtoms.size());
+					for (const ld::Atom* atom : importAtoms)
+						this->addImport(atom, importStrings);
+					break;
+				case 2:
+					_locals.reserve(localsCount);
+					for (const ld::Atom* atom : localAtoms)
+						this->addLocal(atom, localStrings, localAnonNameIndex);
+					break;
+			}
+		}
+		catch (const char* msg) {
+			exceptionMsgs[slice] = msg;
+		}
+	});
+	for (const char* msg : exceptionMsgs) {
+		if ( msg != nullptr )
+			throw msg;
+	}
+	_s_anonNameIndex = localAnonNameIndex;
+	if ( tailMerge ) {
+		// also share the tails of symbol names, mangled names often end the same way
+		pool->appendTailMerged({ &globalStrings, &importStrings, &localStrings });
 	}
+	else {
+		pool->append(globalStrings);
+		pool->append(importStrings);
+		pool->append(localStrings);
+	}
+	this->rebaseStringOffsets(_globals, globalStrings);
+	this->rebaseStringOffsets(_imports, importStrings);
+	this->rebaseStringOffsets(_locals,  localStrings);
+
 	_stabsStringsOffsetStart = this->_writer._stringPoolAtom->currentOffset();
 	for (const ld::relocatable::File::Stab& stab : _state.stabs) {
 		macho_nlist<P> entry;
@@ -0,0 +1,89 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-*
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef __LINK_MAP_H__
+#define __LINK_MAP_H__
+
+#include <stdint.h>
+
+//
+// Layout of the binary link map written by -binary_map.  The file is meant to be
+// mmap()ed directly by analysis tools, so every table is at a fixed offset given
+// in the header and every record has a fixed size.  All values are little endian.
+// An output with LINK_MAP_NO_SECTION or more sections gets no binary map.
+//
+//		link_map_header
+//		link_map_file[filesCount]			index 0 is "linker synthesized"
+//		link_map_section[sectionsCount]
+//		link_map_symbol[symbolsCount]		live symbols in address order, then dead stripped symbols
+//		string pool							NUL terminated strings referenced by *Strx fields
+//
+
+#define LINK_MAP_MAGIC				"ldmap\0\0\0"
+#define LINK_MAP_VERSION			1
+
+#define LINK_MAP_SYMBOL_DEAD		0x0001		// symbol was dead stripped, address is zero
+#define LINK_MAP_SYMBOL_SYNTHESIZED	0x0002		// name was made up by the linker (literal string, FDE, GOT slot)
+
+#define LINK_MAP_NO_SECTION			0xFFFF
+
+struct link_map_header {
+	char		magic[8];			// LINK_MAP_MAGIC
+	uint32_t	version;			// LINK_MAP_VERSION
+	uint32_t	headerSize;			// sizeof(link_map_header)
+	uint32_t	cputype;
+	uint32_t	cpusubtype;
+	uint32_t	outputPathStrx;
+	uint32_t	archNameStrx;
+	uint64_t	filesOffset;
+	uint64_t	filesCount;
+	uint64_t	sectionsOffset;
+	uint64_t	sectionsCount;
+	uint64_t	symbolsOffset;
+	uint64_t	symbolsCount;
+	uint64_t	stringsOffset;
+	uint64_t	stringsSize;
+};
+
+struct link_map_file {
+	uint64_t	pathStrx;
+};
+
+struct link_map_section {
+	uint64_t	address;
+	uint64_t	size;
+	uint32_t	segmentStrx;
+	uint32_t	sectionStrx;
+};
+
+struct link_map_symbol {
+	uint64_t	address;
+	uint64_t	size;
+	uint64_t	nameStrx;
+	uint32_t	fileIndex;			// index into link_map_file table
+	uint16_t	sectionIndex;		// index into link_map_section table, or LINK_MAP_NO_SECTION
+	uint16_t	flags;				// LINK_MAP_SYMBOL_*
+};
+
+#endif // __LINK_MAP_H__
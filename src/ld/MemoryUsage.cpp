@@ -0,0 +1,118 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-*
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <mach/mach.h>
+#include <malloc/malloc.h>
+#include <Block.h>
+
+#include "MemoryUsage.h"
+
+namespace ld {
+namespace tool {
+
+
+MemoryUsage::Sample MemoryUsage::current(const char* label)
+{
+	Sample result = { label, 0, 0, 0, 0 };
+	task_vm_info_data_t vmInfo;
+	mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+	if ( task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&vmInfo, &count) == KERN_SUCCESS ) {
+		result.resident		= vmInfo.resident_size;
+		result.residentPeak	= vmInfo.resident_size_peak;
+		result.footprint	= vmInfo.phys_footprint;
+	}
+	malloc_statistics_t mallocStats;
+	malloc_zone_statistics(NULL, &mallocStats);
+	result.allocated = mallocStats.size_in_use;
+	return result;
+}
+
+
+void MemoryUsage::sample(const char* label)
+{
+	_samples.push_back(current(label));
+}
+
+
+bool MemoryUsage::overBudget(const char* label)
+{
+	if ( _budget == 0 )
+		return false;
+	if ( _exceededAt != nullptr )
+		return true;
+	task_vm_info_data_t vmInfo;
+	mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+	if ( task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&vmInfo, &count) != KERN_SUCCESS )
+		return false;
+	if ( vmInfo.resident_size < _budget )
+		return false;
+	_exceededAt = label;
+	return true;
+}
+
+
+void MemoryUsage::setReleaseInputPagesHandler(void (^handler)())
+{
+	_releaseInputPages = Block_copy(handler);
+}
+
+
+void MemoryUsage::releaseInputPages()
+{
+	if ( _releaseInputPages != nullptr )
+		_releaseInputPages();
+}
+
+
+void MemoryUsage::noteStructure(const char* name, uint64_t count, uint64_t bytes)
+{
+	_structures.push_back({ name, count, bytes });
+}
+
+
+void MemoryUsage::printStatistics() const
+{
+	fprintf(stderr, "memory use (KB)              resident  peak resident      footprint  malloc in use\n");
+	for (const Sample& s : _samples) {
+		fprintf(stderr, "%24s: %14llu %14llu %14llu %14llu\n", s.label, s.resident/1024, s.residentPeak/1024,
+				s.footprint/1024, s.allocated/1024);
+	}
+	// computed from counts and sizes, not from the allocations, so only the malloc column above is measured
+	if ( !_structures.empty() )
+		fprintf(stderr, "estimated size of major structures at end of link:\n");
+	for (const Structure& s : _structures)
+		fprintf(stderr, "%24s: %14llu KB in %llu\n", s.name, s.bytes/1024, s.count);
+	if ( _budget != 0 ) {
+		if ( _exceededAt != nullptr )
+			fprintf(stderr, "memory budget of %llu KB reached at %s\n", _budget/1024, _exceededAt);
+		else
+			fprintf(stderr, "memory budget of %llu KB not reached\n", _budget/1024);
+	}
+}
+
+} // namespace tool
+} // namespace ld
@@ -0,0 +1,87 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-*
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifndef __MEMORY_USAGE_H__
+#define __MEMORY_USAGE_H__
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace ld {
+namespace tool {
+
+//
+// Samples the linker's memory use at phase and pass boundaries for -print_statistics,
+// and checks it against the -memory_budget.  Resident size comes from the task's VM
+// info, allocated bytes from the malloc zones.  Once resident size reaches the budget,
+// overBudget() stays true and the linker trades speed for memory where it can: it stops
+// parsing archive members ahead and drops the pages of input files it has read, which
+// are reread from disk if touched again.
+//
+class MemoryUsage
+{
+public:
+	void						setBudget(uint64_t bytes)	{ _budget = bytes; }
+	uint64_t					budget() const				{ return _budget; }
+
+	// records current usage under label
+	void						sample(const char* label);
+	// true once resident size has reached the budget, label names the caller for statistics
+	bool						overBudget(const char* label);
+	// set by the owner of the input file mappings, drops their resident pages
+	void						setReleaseInputPagesHandler(void (^handler)());
+	void						releaseInputPages();
+	// records an estimate of the bytes held by one of the linker's major data structures at the end of the link
+	void						noteStructure(const char* name, uint64_t count, uint64_t bytes);
+	void						printStatistics() const;
+
+private:
+	struct Sample {
+		const char*			label;
+		uint64_t			resident;
+		uint64_t			residentPeak;
+		uint64_t			footprint;
+		uint64_t			allocated;
+	};
+	struct Structure {
+		const char*			name;
+		uint64_t			count;
+		uint64_t			bytes;
+	};
+
+	static Sample				current(const char* label);
+
+	uint64_t					_budget			= 0;
+	const char*					_exceededAt		= nullptr;
+	void						(^_releaseInputPages)() = nullptr;
+	std::vector<Sample>			_samples;
+	std::vector<Structure>		_structures;
+};
+
+} // namespace tool
+} // namespace ld
+
+#endif // __MEMORY_USAGE_H__
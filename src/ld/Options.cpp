@@ -32,6 +32,8 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
+#include <ctype.h>
+#include <dirent.h>
 #include <spawn.h>
 #include <Availability.h>
 #include <tapi/tapi.h>
@@ -84,9 +86,27 @@ static bool			sFatalWarnings = false;
 static const char*	sWarningsSideFilePath = NULL;
 static FILE*		sWarningsSideFile = NULL;
 static int			sWarningsCount = 0;
+static thread_local std::vector<std::string>* sDeferredWarnings = NULL;
+
+// while set, warnings on this thread are collected instead of printed, so the caller can
+// report them later or drop them
+void deferWarnings(std::vector<std::string>* warnings)
+{
+	sDeferredWarnings = warnings;
+}
 
 void warning(const char* format, ...)
 {
+	if ( sDeferredWarnings != NULL ) {
+		va_list	list;
+		char*	p;
+		va_start(list, format);
+		vasprintf(&p, format, list);
+		va_end(list);
+		sDeferredWarnings->push_back(p);
+		free(p);
+		return;
+	}
 	++sWarningsCount;
 	if ( sEmitWarnings ) {
 		va_list	list;
@@ -131,6 +151,11 @@ bool Options::FileInfo::checkFileExists(const Options& options, const char *p)
 	struct stat statBuffer;
 	if (p == NULL) 
 	  p = path;
+	// pipelined inputs may be written after their directory was listed
+	if ( !options.pipelineEnabled() && !options.fSearchPathCache.mayExist(p, options.fTraceSearchPathCache) ) {
+		options.addDependency(Options::depNotFound, p);
+		return false;
+	}
 	if ( stat(p, &statBuffer) == 0 ) {
 		if (p != path) path = strdup(p);
 		modTime = statBuffer.st_mtime;
@@ -158,7 +183,9 @@ Options::Options(int argc, const char* argv[])
 	  fClientName(NULL),
 	  fUmbrellaName(NULL), fInitFunctionName(NULL), fDotOutputFile(NULL), fExecutablePath(NULL),
 	  fBundleLoader(NULL), fDtraceScriptName(NULL), fMapPath(NULL),
-	  fDyldInstallPath("/usr/lib/dyld"), fLtoCachePath(NULL),
+	  fBinaryMapPath(NULL), fTailMergeStrings(false), fPrintSymbolMoveHits(false), fTraceInputPaging(false), fInputCostReport(false),
+	  fTraceSearchPathCache(false),
+	  fDyldInstallPath("/usr/lib/dyld"), fLtoCachePath(NULL), fConcurrentParseLTO(false), fInterfaceCacheDir(NULL),
 	  fLTOSoftloadRuntimeSymbols(false), fLTOSoftloadRuntimeSymbolsForceOn(false), fLTOSoftloadRuntimeSymbolsForceOff(false),
 	  fTempLtoObjectPath(NULL), fOverridePathlibLTO(NULL), fLtoCpu(NULL),
 	  fToolchainPath(NULL),fOrderFilePath(NULL),
@@ -210,7 +237,7 @@ Options::Options(int argc, const char* argv[])
 	  fUseTextExecSegment(false), fBundleBitcode(false), fHideSymbols(false), fVerifyBitcode(false),
 	  fReverseMapUUIDRename(false), fDeDupe(true), fVerboseDeDupe(false), fMakeInitializersIntoOffsets(false),
 	  fUseLinkedListBinding(false),  fMakeChainedFixupsForceOn(false), fMakeChainedFixupsForceOff(false), fMakeChainedFixups(false),
-	  fMakeChainedFixupsSection(false), fMakeRebaseSection(false), fNoLazyBinding(false), fDebugVariant(false),
+	  fMakeChainedFixupsSection(false), fMakeRebaseSection(false), fVerifyFixupChains(false), fNoLazyBinding(false), fDebugVariant(false),
 	  fReverseMapPath(NULL), fLTOCodegenOnly(false),
 	  fIgnoreAutoLink(false), fAllowDeadDups(false), fAllowWeakImports(true), fInitializersTreatment(Options::kInvalid),
 	  fZeroModTimeInDebugMap(false), fBitcodeKind(kBitcodeProcess),
@@ -219,7 +246,7 @@ Options::Options(int argc, const char* argv[])
 	  fAdHocSign(false), fAdHocSignForceOn(false), fAdHocSignForceOff(false),
 	  fPlatformMismatchesAreWarning(false),
 	  fForceObjCRelativeMethodListsOn(false), fForceObjCRelativeMethodListsOff(false), fUseObjCRelativeMethodLists(false), fObjcSmallStubs(false), fRunHugePass(true), fForceLdClassic(false), fLdPrimeFallback(false), fOptLevel(OptimizationLevel::unspecified),
-	  fSaveTempFiles(false), fLinkSnapshot(this), fSnapshotRequested(false), fPipelineFifo(NULL),
+	  fSaveTempFiles(false), fLinkSnapshot(this), fSnapshotRequested(false), fPerfSnapshotBaseline(NULL), fPipelineFifo(NULL),
 	  fDependencyInfoPath(NULL), fBuildContextName(NULL), fTraceFileDescriptor(-1), fMaxDefaultCommonAlign(0),
 	  fUnalignedPointerTreatment(kUnalignedPointerIgnore), fPreferTAPIFile(false), fOSOPrefixPath(NULL)
 {
@@ -230,11 +257,15 @@ Options::Options(int argc, const char* argv[])
 	this->parsePostCommandLineEnvironmentSettings();
 	this->reconfigureDefaults();
 	this->checkIllegalOptionCombinations();
+	fSymbolsMovesDataMatcher.build(fSymbolsMovesData);
+	fSymbolsMovesCodeMatcher.build(fSymbolsMovesCode);
 
 	
 	this->addDependency(depOutputFile, fOutputFile);
 	if ( fMapPath != NULL )
 		this->addDependency(depOutputFile, fMapPath);
+	if ( fBinaryMapPath != NULL )
+		this->addDependency(depOutputFile, fBinaryMapPath);
 }
 
 Options::~Options()
@@ -823,6 +854,67 @@ static std::string addSuffix(const std::string &path, const std::string &suffix)
 	return result;
 }
 
+bool Options::SearchPathCache::mayExist(const char* path, bool trace)
+{
+	const char* lastSlash = strrchr(path, '/');
+	std::string dir = (lastSlash == NULL) ? std::string(".") : std::string(path, (lastSlash == path) ? 1 : lastSlash - path);
+	const char* leaf = (lastSlash == NULL) ? path : &lastSlash[1];
+	std::string name;
+	for (const char* s = leaf; *s != '\0'; ++s) {
+		if ( (unsigned char)*s >= 0x80 ) {
+			name.clear();
+			break;
+		}
+		name.push_back(tolower(*s));
+	}
+
+	std::lock_guard<std::mutex> guard(fLock);
+	++fLookups;
+	if ( !name.empty() ) {
+		const Listing& listing = listingFor(dir);
+		if ( listing.readable && (listing.names.count(name) == 0) ) {
+			++fAnsweredFromListing;
+			if ( trace )
+				fprintf(stderr, "[search path cache] not listed: %s\n", path);
+			return false;
+		}
+	}
+	if ( trace )
+		fprintf(stderr, "[search path cache] stat: %s\n", path);
+	return true;
+}
+
+const Options::SearchPathCache::Listing& Options::SearchPathCache::listingFor(const std::string& dir)
+{
+	auto pos = fListings.find(dir);
+	if ( pos != fListings.end() )
+		return pos->second;
+	Listing& listing = fListings[dir];
+	listing.readable = false;
+	if ( DIR* dirp = ::opendir(dir.c_str()) ) {
+		listing.readable = true;
+		while ( struct dirent* entry = ::readdir(dirp) ) {
+			std::string name = entry->d_name;
+			for (char& c : name)
+				c = tolower(c);
+			listing.names.insert(name);
+		}
+		::closedir(dirp);
+	}
+	else if ( (errno == ENOENT) || (errno == ENOTDIR) ) {
+		// nothing can exist under a missing directory
+		listing.readable = true;
+	}
+	return listing;
+}
+
+void Options::SearchPathCache::printStatistics() const
+{
+	fprintf(stderr, "search path cache: %llu lookups, %llu answered from %lu directory listings (%.1f%%), %llu passed to stat()\n",
+			fLookups, fAnsweredFromListing, fListings.size(),
+			(fLookups != 0) ? (100.0 * fAnsweredFromListing / fLookups) : 0.0, fLookups - fAnsweredFromListing);
+}
+
 bool Options::checkForFileWithSuffix(const char* possiblePath, FileInfo& result) const
 {
 	bool found = result.checkFileExists(*this, possiblePath);
@@ -1471,6 +1563,115 @@ bool Options::SetWithWildcards::wildCardMatch(const char* pattern, const char* s
 }
 
 
+void Options::SymbolMoveMatcher::build(const std::vector<SymbolsMove>& moves)
+{
+	fMoves = &moves;
+	fRules.clear();
+	fExact.clear();
+	fTrieRules.clear();
+	fTrieEdges.clear();
+	fTrieRules.emplace_back();	// root
+	for (uint32_t moveIndex=0; moveIndex < moves.size(); ++moveIndex) {
+		const SetWithWildcards& set = moves[moveIndex].symbols;
+		for (const char* name : set.fRegular) {
+			// a name in more than one list can only ever match the first one
+			if ( fExact.find(name) != fExact.end() )
+				continue;
+			fExact[name] = (uint32_t)fRules.size();
+			fRules.push_back({ name, moveIndex, false, 0 });
+		}
+		for (const char* pattern : set.fWildCard) {
+			addWildCard(pattern, (uint32_t)fRules.size());
+			fRules.push_back({ pattern, moveIndex, true, 0 });
+		}
+	}
+}
+
+void Options::SymbolMoveMatcher::addWildCard(const char* pattern, uint32_t ruleIndex)
+{
+	uint32_t node = 0;
+	for (const char* p = pattern; (*p != '\0') && (strchr("*?[", *p) == NULL); ++p) {
+		uint64_t key = ((uint64_t)node << 8) | (uint8_t)*p;
+		auto pos = fTrieEdges.find(key);
+		if ( pos == fTrieEdges.end() ) {
+			uint32_t child = (uint32_t)fTrieRules.size();
+			fTrieRules.emplace_back();
+			pos = fTrieEdges.insert(std::make_pair(key, child)).first;
+		}
+		node = pos->second;
+	}
+	// rules are added in list order, so each node's rules stay sorted by list
+	fTrieRules[node].push_back(ruleIndex);
+}
+
+void Options::SymbolMoveMatcher::matchExact(const char* candidate, uint32_t check, Match& best) const
+{
+	auto pos = fExact.find(candidate);
+	if ( pos == fExact.end() )
+		return;
+	uint32_t rank = fRules[pos->second].moveIndex*4 + check;
+	if ( rank < best.rank )
+		best = { pos->second, rank };
+}
+
+void Options::SymbolMoveMatcher::matchWildCard(const char* candidate, uint32_t check, Match& best) const
+{
+	uint32_t node = 0;
+	for (const char* p = candidate; ; ++p) {
+		for (uint32_t ruleIndex : fTrieRules[node]) {
+			const Rule& rule = fRules[ruleIndex];
+			uint32_t rank = rule.moveIndex*4 + check;
+			if ( rank >= best.rank )
+				break;
+			if ( (*fMoves)[rule.moveIndex].symbols.wildCardMatch(rule.pattern, candidate) ) {
+				best = { ruleIndex, rank };
+				break;
+			}
+		}
+		if ( *p == '\0' )
+			return;
+		auto pos = fTrieEdges.find(((uint64_t)node << 8) | (uint8_t)*p);
+		if ( pos == fTrieEdges.end() )
+			return;
+		node = pos->second;
+	}
+}
+
+// Same answer as walking the lists with SetWithWildcards::containsWithPrefix(), which checks in order:
+// exact symbol, wildcard symbol, exact "file:symbol", wildcard "file:symbol"
+bool Options::SymbolMoveMatcher::match(const char* symbol, const char* file, const char*& seg, bool& wildCardMatch) const
+{
+	wildCardMatch = false;
+	if ( fRules.empty() )
+		return false;
+	Match best = { 0, UINT32_MAX };
+	matchExact(symbol, 0, best);
+	matchWildCard(symbol, 1, best);
+	if ( (file != NULL) && (best.rank > 1) ) {
+		const char* s = strrchr(file, '/');
+		if ( s != NULL )
+			file = s+1;
+		char buff[strlen(file)+strlen(symbol)+2];
+		sprintf(buff, "%s:%s", file, symbol);
+		matchExact(buff, 2, best);
+		matchWildCard(buff, 3, best);
+	}
+	if ( best.rank == UINT32_MAX )
+		return false;
+	const Rule& rule = fRules[best.rule];
+	++rule.hits;
+	seg = (*fMoves)[rule.moveIndex].toSegment;
+	wildCardMatch = rule.wildCard;
+	return true;
+}
+
+void Options::SymbolMoveMatcher::printHits(const char* optionName) const
+{
+	for (const Rule& rule : fRules)
+		fprintf(stderr, "%s %s: %10llu %s%s\n", optionName, (*fMoves)[rule.moveIndex].toSegment, rule.hits, rule.pattern, rule.wildCard ? " (wildcard)" : "");
+}
+
+
 void Options::loadExportFile(const char* fileOfExports, const char* option, SetWithWildcards& set, SymbolMatchingMode match_mode)
 {
 	if ( fileOfExports == NULL )
@@ -2140,15 +2341,7 @@ void Options::addSymbolMove(const char* dstSegment, const char* symbolList,
 bool Options::moveRwSymbol(std::string_view symName, const char* filePath, const char*& seg, bool& wildCardMatch) const
 {
 	auto nameStr = std::string(symName);
-	auto *name = nameStr.c_str();
-	for (std::vector<SymbolsMove>::const_iterator it=fSymbolsMovesData.begin(); it != fSymbolsMovesData.end(); ++it) {
-		const SymbolsMove& info = *it;
-		if ( info.symbols.containsWithPrefix(name, filePath, wildCardMatch)) {
-			seg  = info.toSegment;
-			return true;
-		}
-	}
-	return false;
+	return fSymbolsMovesDataMatcher.match(nameStr.c_str(), filePath, seg, wildCardMatch);
 }
 
 bool Options::moveAXMethodList(const char* className) const
@@ -2164,15 +2357,13 @@ bool Options::moveAXMethodList(const char* className) const
 bool Options::moveRoSymbol(std::string_view symName, const char* filePath, const char*& seg, bool& wildCardMatch) const
 {
 	auto nameStr = std::string(symName);
-	auto *name = nameStr.c_str();
-	for (std::vector<SymbolsMove>::const_iterator it=fSymbolsMovesCode.begin(); it != fSymbolsMovesCode.end(); ++it) {
-		const SymbolsMove& info = *it;
-		if ( info.symbols.containsWithPrefix(name, filePath, wildCardMatch)) {
-			seg  = info.toSegment;
-			return true;
-		}
-	}
-	return false;
+	return fSymbolsMovesCodeMatcher.match(nameStr.c_str(), filePath, seg, wildCardMatch);
+}
+
+void Options::printSymbolMoveHitCounts() const
+{
+	fSymbolsMovesDataMatcher.printHits("-move_to_rw_segment");
+	fSymbolsMovesCodeMatcher.printHits("-move_to_ro_segment");
 }
 
 void Options::addSectionAlignment(const char* segment, const char* section, const char* alignmentStr)
@@ -2659,11 +2850,19 @@ void Options::parse(int argc, const char* argv[])
 			else if ( strcmp(arg, "-no_lto_softload_runtime_symbols") == 0 ) {
 				fLTOSoftloadRuntimeSymbolsForceOff = true;
 			}
+			else if ( strcmp(arg, "-concurrent_parse_lto") == 0 ) {
+				fConcurrentParseLTO = true;
+			}
 			else if ( strcmp(arg, "-cache_path_lto") == 0 ) {
 				fLtoCachePath = argv[++i];
 				if ( fLtoCachePath == NULL )
 					throw "missing argument to -cache_path_lto";
 			}
+			else if ( strcmp(arg, "-interface_cache_dir") == 0 ) {
+				fInterfaceCacheDir = argv[++i];
+				if ( fInterfaceCacheDir == NULL )
+					throw "missing argument to -interface_cache_dir";
+			}
 			else if ( strcmp(arg, "-prune_interval_lto") == 0 ) {
 				const char* value = argv[++i];
 				if ( value == NULL )
@@ -3652,6 +3851,34 @@ void Options::parse(int argc, const char* argv[])
 			else if ( strcmp(arg, "-map") == 0 ) {
 				fMapPath = checkForNullArgument(arg, argv[++i]);
 			}
+			else if ( strcmp(arg, "-binary_map") == 0 ) {
+				fBinaryMapPath = checkForNullArgument(arg, argv[++i]);
+			}
+			else if ( strcmp(arg, "-tail_merge_strings") == 0 ) {
+				fTailMergeStrings = true;
+			}
+			else if ( strcmp(arg, "-print_symbol_move_hits") == 0 ) {
+				fPrintSymbolMoveHits = true;
+			}
+			else if ( strcmp(arg, "-trace_input_paging") == 0 ) {
+				fTraceInputPaging = true;
+			}
+			else if ( strcmp(arg, "-input_cost_report") == 0 ) {
+				fInputCostReport = true;
+			}
+			else if ( strcmp(arg, "-memory_budget") == 0 ) {
+				const char* value = argv[++i];
+				if ( value == NULL )
+					throw "missing argument to -memory_budget";
+				char* endptr;
+				uint64_t megabytes = strtoull(value, &endptr, 10);
+				if ( (*endptr != '\0') || (megabytes == 0) )
+					throw "invalid argument for -memory_budget, expected megabytes";
+				fMemoryUsage.setBudget(megabytes*1024*1024);
+			}
+			else if ( strcmp(arg, "-trace_search_path_cache") == 0 ) {
+				fTraceSearchPathCache = true;
+			}
 			else if ( strcmp(arg, "-pie") == 0 ) {
 				fPositionIndependentExecutable = true;
 				fPIEOnCommandLine = true;
@@ -3927,6 +4154,21 @@ void Options::parse(int argc, const char* argv[])
 				fSnapshotRequested = true;
 				cannotBeUsedWithBitcode(arg);
             }
+			else if (strcmp(arg, "-perf_snapshot") == 0) {
+				// stripped out of link snapshot, so a replay does not make another snapshot
+				snapshotArgCount = 0;
+				fLinkSnapshot.setSnapshotMode(Snapshot::SNAPSHOT_DEBUG);
+				fLinkSnapshot.setRecordTimings(true);
+				fSnapshotRequested = true;
+				cannotBeUsedWithBitcode(arg);
+			}
+			else if (strcmp(arg, "-perf_snapshot_baseline") == 0) {
+				snapshotArgCount = 0;
+				fPerfSnapshotBaseline = argv[++i];
+				if ( fPerfSnapshotBaseline == NULL )
+					throw "-perf_snapshot_baseline missing path";
+				fLinkSnapshot.setRecordTimings(true);
+			}
 			else if ( strcmp(arg, "-source_version") == 0 ) {
 				 const char* vers = argv[++i];
 				 if ( vers == NULL )
@@ -4228,6 +4470,9 @@ void Options::parse(int argc, const char* argv[])
 			else if ( strcmp(arg, "-fixup_chains_steal_pointers") == 0 ) {
 				fFixupChainsStealPointers = true;
 			}
+			else if ( strcmp(arg, "-verify_fixup_chains") == 0 ) {
+				fVerifyFixupChains = true;
+			}
 			else if (strcmp(arg, "-rebase_section") == 0) {
 			    fMakeRebaseSection = true;
             }
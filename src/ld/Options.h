@@ -33,10 +33,13 @@
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
+#include <string>
+#include <mutex>
 #include <xpc/xpc.h>
 
 #include "ld.hpp"
 #include "Snapshot.h"
+#include "MemoryUsage.h"
 #include "MachOFileAbstraction.hpp"
 #include "Containers.h"
 
@@ -419,6 +422,15 @@ public:
 	bool						readOnlyx86Stubs() { return fReadOnlyx86Stubs; }
 	const std::vector<DylibOverride>&	dylibOverrides() const { return fDylibOverrides; }
 	const char*					generatedMapPath() const { return fMapPath; }
+	const char*					generatedBinaryMapPath() const { return fBinaryMapPath; }
+	bool						tailMergeStrings() const { return fTailMergeStrings; }
+	bool						printSymbolMoveHits() const { return fPrintSymbolMoveHits; }
+	void						printSymbolMoveHitCounts() const;
+	bool						traceInputPaging() const { return fTraceInputPaging; }
+	bool						inputCostReport() const { return fInputCostReport; }
+	ld::tool::MemoryUsage&		memoryUsage() const { return fMemoryUsage; }
+	bool						traceSearchPathCache() const { return fTraceSearchPathCache; }
+	void						printSearchPathCacheStatistics() const { fSearchPathCache.printStatistics(); }
 	bool						positionIndependentExecutable() const { return fPositionIndependentExecutable; }
 	Options::FileInfo			findIndirectDylib(const std::string& installName, const ld::dylib::File* fromDylib) const;
 	bool						deadStripDylibs() const { return fDeadStripDylibs; }
@@ -471,6 +483,8 @@ public:
 	bool						addDataInCodeInfo() const { return fDataInCodeInfoLoadCommand; }
 	bool						canReExportSymbols() const { return fCanReExportSymbols; }
 	const char*					ltoCachePath() const { return fLtoCachePath; }
+	bool						concurrentParseLTO() const { return fConcurrentParseLTO; }
+	const char*					interfaceCacheDir() const { return fInterfaceCacheDir; }
 	bool						ltoPruneIntervalOverwrite() const { return fLtoPruneIntervalOverwrite; }
 	int							ltoPruneInterval() const { return fLtoPruneInterval; }
 	int							ltoPruneAfter() const { return fLtoPruneAfter; }
@@ -501,6 +515,7 @@ public:
 	bool						makeRebaseSection() const { return fMakeRebaseSection; }
 	bool					    chainedFixupsSectionUseVMOffsets() const { return fChainedFixupsSectionUseVMOffsets; }
 	bool						stealPointersFixupChains() const { return fFixupChainsStealPointers; }
+	bool						verifyFixupChains() const { return fVerifyFixupChains; }
 #if SUPPORT_ARCH_arm64e
 	bool						useAuthenticatedStubs() const { return fUseAuthenticatedStubs; }
 	bool						supportsAuthenticatedPointers() const { return fSupportsAuthenticatedPointers; }
@@ -528,6 +543,7 @@ public:
 	bool						forceNotWeakNonWildcard(const char* symbolName) const;
 	bool						forceCoalesce(const char* symbolName) const;
     Snapshot&                   snapshot() const { return fLinkSnapshot; }
+	const char*					perfSnapshotBaseline() const { return fPerfSnapshotBaseline; }
 	bool						errorBecauseOfWarnings() const;
 	bool						needsThreadLoadCommand() const { return fNeedsThreadLoadCommand; }
 	bool						needsEntryPointLoadCommand() const { return fEntryPointLoadCommand; }
@@ -589,6 +605,8 @@ private:
 	enum InterposeMode { kInterposeNone, kInterposeAllExternal, kInterposeSome };
 	enum SymbolMatchingMode { kAllowWildcards, kDisallowWildcards };
 
+	class SymbolMoveMatcher;
+
 	class SetWithWildcards {
 	public:
 		void					insert(const char*, SymbolMatchingMode);
@@ -600,6 +618,8 @@ private:
 		const NameSet&                          regular() const { return fRegular; }
 		void					remove(const NameSet&); 
 	private:
+		friend class SymbolMoveMatcher;
+
 		static bool				hasWildCards(const char*);
 		bool					wildCardMatch(const char* pattern, const char* candidate) const;
 		bool					inCharRange(const char*& range, unsigned char c) const;
@@ -613,6 +633,59 @@ private:
 		SetWithWildcards	symbols;
 	};
 
+	// All lists of one -move_to_rw_segment / -move_to_ro_segment kind compiled into a single lookup.
+	// Exact names are one hash probe.  Wildcard patterns hang off a trie keyed by their literal
+	// prefix (the characters before the first *, ? or [), so a symbol is only tried against the
+	// patterns whose prefix it starts with.  The first list to match wins, as with containsWithPrefix().
+	class SymbolMoveMatcher {
+	public:
+		void					build(const std::vector<SymbolsMove>& moves);
+		bool					match(const char* symbol, const char* file, const char*& seg, bool& wildCardMatch) const;
+		void					printHits(const char* optionName) const;
+	private:
+		struct Rule {
+			const char*			pattern;
+			uint32_t			moveIndex;
+			bool				wildCard;
+			mutable uint64_t	hits;
+		};
+		struct Match {
+			uint32_t			rule;
+			uint32_t			rank;		// moveIndex*4 + check, lowest wins
+		};
+		void					addWildCard(const char* pattern, uint32_t ruleIndex);
+		void					matchExact(const char* candidate, uint32_t check, Match& best) const;
+		void					matchWildCard(const char* candidate, uint32_t check, Match& best) const;
+
+		const std::vector<SymbolsMove>*			fMoves = nullptr;
+		std::vector<Rule>						fRules;
+		ld::CStringMap<uint32_t>				fExact;			// name -> rule of first list containing it
+		std::vector<std::vector<uint32_t>>		fTrieRules;		// node -> wildcard rules whose prefix ends there
+		std::unordered_map<uint64_t, uint32_t>	fTrieEdges;		// (node << 8) | char -> child node
+	};
+
+	// Library and framework searches probe the same few directories for many names.  Each
+	// directory is listed once, and a path whose leaf name is not in the listing of its directory
+	// is reported missing without a stat().  Listed names still go to stat() for the mod time.
+	// Names are compared ignoring ASCII case since the volume may be case-insensitive, and
+	// non-ASCII names are never answered from the listing.
+	class SearchPathCache {
+	public:
+		bool					mayExist(const char* path, bool trace);
+		void					printStatistics() const;
+	private:
+		struct Listing {
+			bool								readable;
+			std::unordered_set<std::string>		names;			// lower cased
+		};
+		const Listing&			listingFor(const std::string& dir);
+
+		std::mutex								fLock;
+		std::unordered_map<std::string, Listing> fListings;
+		uint64_t								fLookups = 0;
+		uint64_t								fAnsweredFromListing = 0;
+	};
+
 	struct DependencyEntry {
 		uint8_t				opcode;
 		std::string			path;
@@ -721,8 +794,18 @@ private:
 	const char*							fBundleLoader;
 	const char*							fDtraceScriptName;
 	const char*							fMapPath;
+	const char*							fBinaryMapPath;
+	bool								fTailMergeStrings;
+	bool								fPrintSymbolMoveHits;
+	bool								fTraceInputPaging;
+	bool								fInputCostReport;
+	mutable ld::tool::MemoryUsage		fMemoryUsage;
+	bool								fTraceSearchPathCache;
+	mutable SearchPathCache				fSearchPathCache;
 	const char*							fDyldInstallPath;
 	const char*							fLtoCachePath;
+	bool								fConcurrentParseLTO;
+	const char*							fInterfaceCacheDir;
 	bool										fLTOSoftloadRuntimeSymbols;
 	bool										fLTOSoftloadRuntimeSymbolsForceOn;
 	bool										fLTOSoftloadRuntimeSymbolsForceOff;
@@ -877,6 +960,7 @@ private:
 	bool							    fMakeRebaseSection;
 	bool								fChainedFixupsSectionUseVMOffsets = false;
 	bool								fFixupChainsStealPointers		= false;
+	bool								fVerifyFixupChains;
 #if SUPPORT_ARCH_arm64e
 	bool								fUseAuthenticatedStubs 			= false;
 	bool								fSupportsAuthenticatedPointers 	= false;
@@ -942,10 +1026,13 @@ private:
 	std::vector<SymbolsMove>			fSymbolsMovesData;
 	std::vector<SymbolsMove>			fSymbolsMovesCode;
 	std::vector<SymbolsMove>			fSymbolsMovesAXMethodLists;
+	SymbolMoveMatcher					fSymbolsMovesDataMatcher;
+	SymbolMoveMatcher					fSymbolsMovesCodeMatcher;
 	std::vector<const char*>			fImageSuffixes;
 	bool								fSaveTempFiles;
     mutable Snapshot					fLinkSnapshot;
     bool								fSnapshotRequested;
+	const char*							fPerfSnapshotBaseline;
     const char*							fPipelineFifo;
 	const char*							fDependencyInfoPath;
 	const char*							fBuildContextName;
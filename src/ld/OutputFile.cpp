@@ -33,6 +33,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <mach/mach_time.h>
 #include <mach/vm_statistics.h>
@@ -69,6 +70,7 @@ extern "C" {
 #include "LinkEdit.hpp"
 #include "LinkEditClassic.hpp"
 #include "generic_dylib_file.hpp"
+#include "LinkMap.h"
 #include "Containers.h"
 
 namespace ld {
@@ -170,6 +172,10 @@ void OutputFile::write(ld::Internal& state)
 	this->writeOutputFile(state);
 	this->writeMapFile(state);
 	this->writeJSONEntry(state);
+	// the symbol table has copied the debug note strings into the string pool
+	for (char* str : _debugNoteStrings)
+		free(str);
+	_debugNoteStrings.clear();
 }
 
 bool OutputFile::findSegment(ld::Internal& state, uint64_t addr, uint64_t* start, uint64_t* end, uint32_t* index)
@@ -3679,6 +3685,8 @@ void OutputFile::writeAtoms(ld::Internal& state, uint8_t* wholeBuffer)
 					memcpy(startsSection->chain_starts, startOffsets.data(), startsArraySize);
 				}
 			}
+			if ( _options.verifyFixupChains() )
+				this->verifyFixupChainStarts(wholeBuffer, startOffsets, imageLogicalStart, imageStartAddress);
 		}
 		else {
 			// chain together fixups
@@ -3753,10 +3761,198 @@ void OutputFile::writeAtoms(ld::Internal& state, uint8_t* wholeBuffer)
 				}
 				++segIndex;
 			}
+			if ( _options.verifyFixupChains() )
+				this->verifyFixupChains(state, wholeBuffer);
 		}
 	}
 }
 
+// Decodes the page chains just written and checks they visit exactly the fixup locations in _chainedFixupSegments.
+// 32-bit chains may also visit non-pointers co-opted into the chain, so there only the expected locations must be visited.
+void OutputFile::verifyFixupChains(ld::Internal& state, uint8_t* wholeBuffer)
+{
+	const uint8_t* chainHeader = nullptr;
+	for (ld::Internal::FinalSection* sect : state.sections) {
+		if ( (sect->type() == ld::Section::typeLinkEdit) && (strcmp(sect->sectionName(), "__chainfixups") == 0) )
+			chainHeader = &wholeBuffer[sect->fileOffset];
+	}
+	if ( chainHeader == nullptr )
+		throw "fixup chain verification failed: no __chainfixups content";
+	const dyld_chained_fixups_header*   header = (dyld_chained_fixups_header*)chainHeader;
+	const dyld_chained_starts_in_image* chains = (dyld_chained_starts_in_image*)(chainHeader + header->starts_offset);
+	if ( chains->seg_count != _chainedFixupSegments.size() )
+		throwf("fixup chain verification failed: %u segments in chain starts, expected %lu", chains->seg_count, _chainedFixupSegments.size());
+
+	uint32_t segIndex = 0;
+	for (const ChainedFixupSegInfo& segInfo : _chainedFixupSegments) {
+		if ( segInfo.pages.empty() ) {
+			++segIndex;
+			continue;
+		}
+		if ( chains->seg_info_offset[segIndex] == 0 )
+			throwf("fixup chain verification failed: segment %s has fixups but no chain starts", segInfo.name);
+		const dyld_chained_starts_in_segment* segChains = (dyld_chained_starts_in_segment*)((uint8_t*)chains + chains->seg_info_offset[segIndex]);
+		if ( segChains->page_count != segInfo.pages.size() )
+			throwf("fixup chain verification failed: segment %s has %u pages in chain starts, expected %lu", segInfo.name, segChains->page_count, segInfo.pages.size());
+		uint32_t stride;
+		uint32_t pointerSize;
+		switch ( segInfo.pointerFormat ) {
+			case DYLD_CHAINED_PTR_ARM64E:
+			case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+			case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+				stride = 8;
+				pointerSize = 8;
+				break;
+			case DYLD_CHAINED_PTR_ARM64E_KERNEL:
+			case DYLD_CHAINED_PTR_ARM64E_FIRMWARE:
+			case DYLD_CHAINED_PTR_64:
+			case DYLD_CHAINED_PTR_64_OFFSET:
+				stride = 4;
+				pointerSize = 8;
+				break;
+			case DYLD_CHAINED_PTR_32:
+			case DYLD_CHAINED_PTR_32_FIRMWARE:
+				stride = 4;
+				pointerSize = 4;
+				break;
+			default:
+				throwf("fixup chain verification failed: unsupported pointer format %u", segInfo.pointerFormat);
+		}
+		const uint8_t* pageBufferStart = &wholeBuffer[segInfo.fileOffset];
+		for (uint32_t pageIndex=0; pageIndex < segInfo.pages.size(); ++pageIndex, pageBufferStart += segInfo.pageSize) {
+			const std::vector<uint16_t>& expected = segInfo.pages[pageIndex].fixupOffsets;
+			// collect chain starts for this page
+			std::vector<uint16_t> starts;
+			uint16_t pageStart = segChains->page_start[pageIndex];
+			if ( pageStart == DYLD_CHAINED_PTR_START_NONE ) {
+				// no chain
+			}
+			else if ( pageStart & DYLD_CHAINED_PTR_START_MULTI ) {
+				uint32_t overflowIndex = pageStart & ~DYLD_CHAINED_PTR_START_MULTI;
+				while ( true ) {
+					uint16_t start = segChains->page_start[overflowIndex++];
+					starts.push_back(start & ~DYLD_CHAINED_PTR_START_LAST);
+					if ( start & DYLD_CHAINED_PTR_START_LAST )
+						break;
+				}
+			}
+			else {
+				starts.push_back(pageStart);
+			}
+			// walk each chain
+			std::vector<uint16_t> visited;
+			for (uint16_t start : starts) {
+				uint32_t pageOffset = start;
+				while ( true ) {
+					if ( pageOffset + pointerSize > segInfo.pageSize )
+						throwf("fixup chain verification failed: chain runs off page %u of segment %s at offset 0x%X", pageIndex, segInfo.name, pageOffset);
+					visited.push_back(pageOffset);
+					const uint8_t* loc = pageBufferStart + pageOffset;
+					uint32_t next;
+					switch ( segInfo.pointerFormat ) {
+						case DYLD_CHAINED_PTR_32:
+							next = ((dyld_chained_ptr_32_rebase*)loc)->next;
+							break;
+						case DYLD_CHAINED_PTR_32_FIRMWARE:
+							next = ((dyld_chained_ptr_32_firmware_rebase*)loc)->next;
+							break;
+						case DYLD_CHAINED_PTR_64:
+						case DYLD_CHAINED_PTR_64_OFFSET:
+							next = ((dyld_chained_ptr_64_rebase*)loc)->next;
+							break;
+						default:
+							next = ((dyld_chained_ptr_arm64e_rebase*)loc)->next;
+							break;
+					}
+					if ( next == 0 )
+						break;
+					pageOffset += next*stride;
+				}
+			}
+			std::sort(visited.begin(), visited.end());
+			bool match;
+			if ( segInfo.pointerFormat == DYLD_CHAINED_PTR_32 )
+				match = std::includes(visited.begin(), visited.end(), expected.begin(), expected.end());
+			else
+				match = (visited == expected);
+			if ( !match ) {
+				throwf("fixup chain verification failed: chains on page %u of segment %s visit %lu locations which do not match the %lu fixups",
+					   pageIndex, segInfo.name, visited.size(), expected.size());
+			}
+		}
+		++segIndex;
+	}
+}
+
+
+// Firmware chains are not page based, each __chain_starts entry begins a chain that may cross pages
+// and segments.  Walks them all and checks they visit exactly the fixup locations.
+void OutputFile::verifyFixupChainStarts(uint8_t* wholeBuffer, const std::vector<uint32_t>& startOffsets,
+										const uint8_t* imageLogicalStart, uint64_t imageStartAddress)
+{
+	const uint16_t pointerFormat = chainedPointerFormat();
+	std::vector<uint64_t> expected;
+	for (const ChainedFixupSegInfo& segInfo : _chainedFixupSegments) {
+		for (size_t pageIndex=0; pageIndex < segInfo.pages.size(); ++pageIndex) {
+			for (uint16_t pageOffset : segInfo.pages[pageIndex].fixupOffsets)
+				expected.push_back(segInfo.fileOffset + pageIndex*segInfo.pageSize + pageOffset);
+		}
+	}
+	std::sort(expected.begin(), expected.end());
+
+	const uint64_t fileSize = _fileSize;
+	std::vector<uint64_t> visited;
+	for (uint32_t startOffset : startOffsets) {
+		uint64_t fileOffset;
+		if ( _options.chainedFixupsSectionUseVMOffsets() ) {
+			uint64_t address = imageStartAddress + startOffset;
+			const ChainedFixupSegInfo* containing = nullptr;
+			for (const ChainedFixupSegInfo& segInfo : _chainedFixupSegments) {
+				if ( (segInfo.startAddr <= address) && (address < segInfo.endAddr) )
+					containing = &segInfo;
+			}
+			if ( containing == nullptr )
+				throwf("fixup chain verification failed: chain start 0x%X is not in any segment", startOffset);
+			fileOffset = containing->fileOffset + (address - containing->startAddr);
+		}
+		else {
+			if ( imageLogicalStart == nullptr )
+				throw "fixup chain verification failed: no __TEXT segment for chain starts";
+			fileOffset = (imageLogicalStart - wholeBuffer) + startOffset;
+		}
+		while ( true ) {
+			if ( fileOffset + 4 > fileSize )
+				throwf("fixup chain verification failed: chain from start 0x%X runs past end of file", startOffset);
+			visited.push_back(fileOffset);
+			const uint8_t* loc = &wholeBuffer[fileOffset];
+			uint32_t next;
+			switch ( pointerFormat ) {
+				case DYLD_CHAINED_PTR_32_FIRMWARE:
+					next = ((dyld_chained_ptr_32_firmware_rebase*)loc)->next;
+					break;
+				case DYLD_CHAINED_PTR_64:
+				case DYLD_CHAINED_PTR_64_OFFSET:
+					next = ((dyld_chained_ptr_64_rebase*)loc)->next;
+					break;
+				case DYLD_CHAINED_PTR_ARM64E_KERNEL:
+				case DYLD_CHAINED_PTR_ARM64E_FIRMWARE:
+					next = ((dyld_chained_ptr_arm64e_rebase*)loc)->next;
+					break;
+				default:
+					throwf("fixup chain verification failed: unsupported pointer format %u", pointerFormat);
+			}
+			if ( next == 0 )
+				break;
+			fileOffset += next*4;
+		}
+	}
+	std::sort(visited.begin(), visited.end());
+	if ( visited != expected ) {
+		throwf("fixup chain verification failed: chain starts visit %lu locations which do not match the %lu fixups",
+			   visited.size(), expected.size());
+	}
+}
+
 
 
 
@@ -4123,6 +4319,10 @@ void OutputFile::writeOutputFile(ld::Internal& state)
 	}
 
 	writeAtoms(state, wholeBuffer);
+
+	// atom content is all copied, so input pages are not needed while hashing the output
+	if ( _options.memoryUsage().overBudget("write output") )
+		_options.memoryUsage().releaseInputPages();
 	
 	// compute UUID 
 	if ( _options.UUIDMode() == Options::kUUIDContent )
@@ -5160,6 +5360,11 @@ void OutputFile::addLoadCommands(ld::Internal& state)
 	}
 }
 
+uint64_t OutputFile::tailMergedStringBytes() const
+{
+	return _stringPoolAtom->tailMergedBytes();
+}
+
 uint32_t OutputFile::dylibCount()
 {
 	return _dylibsToLoad.size();
@@ -5696,7 +5901,7 @@ void OutputFile::buildChainedFixupInfo(ld::Internal& state)
 			_importedSymbolsCount = sect->atoms.size();
 	}
 
-	// build table of segments, fixup locations, and symbol targets
+	// build table of segments
 	uint32_t							pageSize     = _options.segmentAlignment();
 	// The kernel and kexts need to support unaligned fixups, so just always force 4k alignment on them
 	// x86_64 binaries are 16KB segments to make rosetta easier, but still use 4KB pages when run natively
@@ -5705,6 +5910,8 @@ void OutputFile::buildChainedFixupInfo(ld::Internal& state)
 	const char* 						curSegName   = "";
 	const ld::Internal::FinalSection* 	firstSegSect = nullptr;
 	const ld::Internal::FinalSection* 	lastSect     = nullptr;
+	std::vector<uint32_t>				sectSegIndex;
+	sectSegIndex.reserve(state.sections.size());
 	for (ld::Internal::FinalSection* sect : state.sections) {
 		if ( strcmp(sect->segmentName(), curSegName) != 0 ) {
 			if ( firstSegSect != nullptr ) {
@@ -5722,12 +5929,43 @@ void OutputFile::buildChainedFixupInfo(ld::Internal& state)
 			seg.pointerFormat = chainedPointerFormat();
 			_chainedFixupSegments.push_back(seg);
 		}
+		sectSegIndex.push_back(_chainedFixupSegments.size()-1);
+		lastSect = sect;
+	}
+
+	// find fixup locations and symbol targets, each section in parallel
+	struct SectionFixups {
+		struct Bind {
+			const ld::Atom*		target;
+			uint64_t			addend;
+			bool				authPtr;
+		};
+		// formatted by the serial merge, demangling is not thread safe
+		struct Diagnostic {
+			enum Kind { weakOverride, unalignedPointer, pointerOnPageBoundary };
+			Kind				kind;
+			const ld::Atom*		atom;
+			uint64_t			address;
+			uint32_t			offsetInAtom;
+		};
+		std::vector<uint64_t>		addresses;			// sorted, chained locations in this section
+		std::vector<Bind>			binds;				// in atom/fixup order, so bind ordinals do not depend on threading
+		std::vector<Diagnostic>		diagnostics;
+		bool						overridesWeakDef = false;
+		bool						hasUnalignedFixup = false;
+		const char*					exception = nullptr;
+	};
+	__block std::vector<SectionFixups> sectionFixups(state.sections.size());
+	dispatch_apply(state.sections.size(), DISPATCH_APPLY_AUTO, ^(size_t sectIndex) {
+		const ld::Internal::FinalSection* sect = state.sections[sectIndex];
+		const ChainedFixupSegInfo& segInfo = _chainedFixupSegments[sectSegIndex[sectIndex]];
+		SectionFixups& result = sectionFixups[sectIndex];
 		for (const ld::Atom* atom : sect->atoms) {
 			// Record regular atoms that override a dylib's weak definitions
 			if ( (atom->scope() == ld::Atom::scopeGlobal) && atom->overridesDylibsWeakDef() ) {
-				this->overridesWeakExternalSymbols = true;
+				result.overridesWeakDef = true;
 				if ( _options.warnWeakExports()	)
-					warning("overrides weak external symbol: %s", atom->name());
+					result.diagnostics.push_back({ SectionFixups::Diagnostic::weakOverride, atom, 0, 0 });
 			}
 
 			const ld::Atom* target;
@@ -5736,182 +5974,217 @@ void OutputFile::buildChainedFixupInfo(ld::Internal& state)
 			uint64_t accumulator;
 			bool isBind = false;
 			bool isAuthPtr = false;
-			for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
-				if ( fit->firstInCluster() ) {
-					accumulator = 0;
-					target = NULL;
-					hadSubtract = false;
-					isBind = false;
-					isAuthPtr = false;
-				}
-				if ( this->setsTarget(*fit) ) {
-					switch ( fit->binding ) {
-						case ld::Fixup::bindingNone:
-						case ld::Fixup::bindingByNameUnbound:
+			try {
+				for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+					if ( fit->firstInCluster() ) {
+						accumulator = 0;
+						target = NULL;
+						hadSubtract = false;
+						isBind = false;
+						isAuthPtr = false;
+					}
+					if ( this->setsTarget(*fit) ) {
+						switch ( fit->binding ) {
+							case ld::Fixup::bindingNone:
+							case ld::Fixup::bindingByNameUnbound:
+								break;
+							case ld::Fixup::bindingByContentBound:
+								target = fit->u.target;
+								break;
+							case ld::Fixup::bindingDirectlyBound:
+								target = fit->u.target;
+								break;
+							case ld::Fixup::bindingsIndirectlyBound:
+								target = state.indirectBindingTable[fit->u.bindingIndex];
+								break;
+						}
+						assert(target != NULL);
+					}
+					switch ( fit->kind ) {
+						case ld::Fixup::kindSetTargetAddress:
+							accumulator = addressOf(state, fit, &target);
+							if ( targetIsThumb(state, fit) )
+								accumulator |= 1;
+							if ( fit->contentAddendOnly || fit->contentDetlaToAddendOnly )
+								accumulator = 0;
 							break;
-						case ld::Fixup::bindingByContentBound:
-							target = fit->u.target;
+						case ld::Fixup::kindSubtractTargetAddress:
+							accumulator -= addressOf(state, fit, &fromTarget);
+							hadSubtract = true;
 							break;
-						case ld::Fixup::bindingDirectlyBound:
-							target = fit->u.target;
+						case ld::Fixup::kindAddAddend:
+							accumulator += fit->u.addend;
 							break;
-						case ld::Fixup::bindingsIndirectlyBound:
-							target = state.indirectBindingTable[fit->u.bindingIndex];
+						case ld::Fixup::kindSubtractAddend:
+							accumulator -= fit->u.addend;
+							break;
+						case ld::Fixup::kindSetTargetImageOffset:
+							hadSubtract = true;
+							break;
+						case ld::Fixup::kindStoreLittleEndian32:
+						case ld::Fixup::kindStoreLittleEndian64:
+							isBind = true;
+							break;
+						case ld::Fixup::kindStoreTargetAddressLittleEndian32:
+							accumulator = addressOf(state, fit, &target);
+							if ( targetIsThumb(state, fit) )
+								accumulator |= 1;
+							if ( fit->contentAddendOnly )
+								accumulator = 0;
+							isBind = true;
+							break;
+						case ld::Fixup::kindStoreTargetAddressLittleEndian64:
+							accumulator = addressOf(state, fit, &target);
+							if ( fit->contentAddendOnly )
+								accumulator = 0;
+							isBind = true;
 							break;
-					}
-					assert(target != NULL);
-				}
-				switch ( fit->kind ) {
-					case ld::Fixup::kindSetTargetAddress:
-						accumulator = addressOf(state, fit, &target);
-						if ( targetIsThumb(state, fit) )
-							accumulator |= 1;
-						if ( fit->contentAddendOnly || fit->contentDetlaToAddendOnly )
-							accumulator = 0;
-						break;
-					case ld::Fixup::kindSubtractTargetAddress:
-                        accumulator -= addressOf(state, fit, &fromTarget);
-						hadSubtract = true;
-						break;
-                    case ld::Fixup::kindAddAddend:
-						accumulator += fit->u.addend;
-						break;
-                    case ld::Fixup::kindSubtractAddend:
-						accumulator -= fit->u.addend;
-						break;
-                    case ld::Fixup::kindSetTargetImageOffset:
-                        hadSubtract = true;
-                        break;
-					case ld::Fixup::kindStoreLittleEndian32:
-					case ld::Fixup::kindStoreLittleEndian64:
-						isBind = true;
-						break;
-					case ld::Fixup::kindStoreTargetAddressLittleEndian32:
-						accumulator = addressOf(state, fit, &target);
-						if ( targetIsThumb(state, fit) )
-							accumulator |= 1;
-						if ( fit->contentAddendOnly )
-							accumulator = 0;
-						isBind = true;
-						break;
-					case ld::Fixup::kindStoreTargetAddressLittleEndian64:
-						accumulator = addressOf(state, fit, &target);
-						if ( fit->contentAddendOnly )
-							accumulator = 0;
-						isBind = true;
-						break;
 #if SUPPORT_ARCH_arm64e
-					case ld::Fixup::kindStoreLittleEndianAuth64:
-						if ( fit->contentAddendOnly ) {
-							// ld -r mode.  We want to write out the original relocation again
+						case ld::Fixup::kindStoreLittleEndianAuth64:
+							if ( fit->contentAddendOnly ) {
+								// ld -r mode.  We want to write out the original relocation again
+								break;
+							}
+							isBind = true;
+							break;
+						case ld::Fixup::kindStoreTargetAddressLittleEndianAuth64:
+							accumulator = addressOf(state, fit, &target);
+							if ( fit->contentAddendOnly )
+								accumulator = 0;
+							isBind = true;
+							break;
+						case ld::Fixup::kindSetAuthData:
+							isAuthPtr = true;
 							break;
-						}
-						isBind = true;
-						break;
-					case ld::Fixup::kindStoreTargetAddressLittleEndianAuth64:
-						accumulator = addressOf(state, fit, &target);
-						if ( fit->contentAddendOnly )
-							accumulator = 0;
-						isBind = true;
-						break;
-					case ld::Fixup::kindSetAuthData:
-						isAuthPtr = true;
-						break;
 #endif
-					default:
-						break;
-				}
-				if ( fit->lastInCluster() && isBind ) {
-					// this is an absolute pointer which means it needs to be in fixup chain
-					if ( (target != NULL) && !hadSubtract ) {
-						uint64_t fixUpAddr = atom->finalAddress() + fit->offsetInAtom;
-						//fprintf(stderr, "fixUpAddr=0x%0llX\n",fixUpAddr);
-
-						// Diagnose unaligned pointers
-						switch (_chainedFixupSegments.back().pointerFormat) {
-							case DYLD_CHAINED_PTR_ARM64E:
-							case DYLD_CHAINED_PTR_ARM64E_USERLAND:
-							case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
-								if ( fixUpAddr % 8 ) {
-									warning("pointer not aligned at address 0x%llX ('%s' + %u from %s)",
-											fixUpAddr, _options.demangleSymbol(atom->name()), fit->offsetInAtom, atom->safeFilePath());
-									_hasUnalignedFixup = true;
-								}
-								break;
-							case DYLD_CHAINED_PTR_ARM64E_KERNEL:
-							case DYLD_CHAINED_PTR_64:
-							case DYLD_CHAINED_PTR_64_OFFSET:
-							case DYLD_CHAINED_PTR_ARM64E_FIRMWARE:
-							case DYLD_CHAINED_PTR_32:
-							case DYLD_CHAINED_PTR_32_FIRMWARE:
-								if ( fixUpAddr % 4 ) {
-									warning("pointer not aligned at address 0x%llX ('%s' + %u from %s)",
-										   fixUpAddr, _options.demangleSymbol(atom->name()), fit->offsetInAtom, atom->safeFilePath());
-									_hasUnalignedFixup = true;
-								}
-								break;
-							default:
-								assert(0 && "unknown pointer format");
-						}
-
-						// rdar://94340387 pointers at page boundaries can't be properly
-						// fixed up by the kernel when using pagein linking
-						if ( diagnosePointersOnPageBoundary ) {
-							uint64_t pageEnd = (fixUpAddr & ~((uint64_t)pageSize - 1)) + pageSize;
-							switch (_chainedFixupSegments.back().pointerFormat) {
+						default:
+							break;
+					}
+					if ( fit->lastInCluster() && isBind ) {
+						// this is an absolute pointer which means it needs to be in fixup chain
+						if ( (target != NULL) && !hadSubtract ) {
+							uint64_t fixUpAddr = atom->finalAddress() + fit->offsetInAtom;
+							//fprintf(stderr, "fixUpAddr=0x%0llX\n",fixUpAddr);
+
+							// Diagnose unaligned pointers
+							switch (segInfo.pointerFormat) {
 								case DYLD_CHAINED_PTR_ARM64E:
 								case DYLD_CHAINED_PTR_ARM64E_USERLAND:
 								case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+									if ( fixUpAddr % 8 ) {
+										result.diagnostics.push_back({ SectionFixups::Diagnostic::unalignedPointer, atom, fixUpAddr, fit->offsetInAtom });
+										result.hasUnalignedFixup = true;
+									}
+									break;
 								case DYLD_CHAINED_PTR_ARM64E_KERNEL:
 								case DYLD_CHAINED_PTR_64:
 								case DYLD_CHAINED_PTR_64_OFFSET:
 								case DYLD_CHAINED_PTR_ARM64E_FIRMWARE:
-									if ( (fixUpAddr + 8) > pageEnd ) {
-										warning("pointer not aligned at page boundary address 0x%llX ('%s' + %u from %s)",
-												fixUpAddr, _options.demangleSymbol(atom->name()), fit->offsetInAtom, atom->safeFilePath());
-										_hasUnalignedFixup = true;
-									}
-									break;
 								case DYLD_CHAINED_PTR_32:
 								case DYLD_CHAINED_PTR_32_FIRMWARE:
-									if ( (fixUpAddr + 4) > pageEnd ) {
-										warning("pointer not aligned at page boundary address 0x%llX ('%s' + %u from %s)",
-											   fixUpAddr, _options.demangleSymbol(atom->name()), fit->offsetInAtom, atom->safeFilePath());
-										_hasUnalignedFixup = true;
+									if ( fixUpAddr % 4 ) {
+										result.diagnostics.push_back({ SectionFixups::Diagnostic::unalignedPointer, atom, fixUpAddr, fit->offsetInAtom });
+										result.hasUnalignedFixup = true;
 									}
 									break;
 								default:
 									assert(0 && "unknown pointer format");
 							}
-						}
 
-						if ( targetNeedsNoFixup(target) )
-							continue;
+							// rdar://94340387 pointers at page boundaries can't be properly
+							// fixed up by the kernel when using pagein linking
+							if ( diagnosePointersOnPageBoundary ) {
+								uint64_t pageEnd = (fixUpAddr & ~((uint64_t)pageSize - 1)) + pageSize;
+								switch (segInfo.pointerFormat) {
+									case DYLD_CHAINED_PTR_ARM64E:
+									case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+									case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+									case DYLD_CHAINED_PTR_ARM64E_KERNEL:
+									case DYLD_CHAINED_PTR_64:
+									case DYLD_CHAINED_PTR_64_OFFSET:
+									case DYLD_CHAINED_PTR_ARM64E_FIRMWARE:
+										if ( (fixUpAddr + 8) > pageEnd ) {
+											result.diagnostics.push_back({ SectionFixups::Diagnostic::pointerOnPageBoundary, atom, fixUpAddr, fit->offsetInAtom });
+											result.hasUnalignedFixup = true;
+										}
+										break;
+									case DYLD_CHAINED_PTR_32:
+									case DYLD_CHAINED_PTR_32_FIRMWARE:
+										if ( (fixUpAddr + 4) > pageEnd ) {
+											result.diagnostics.push_back({ SectionFixups::Diagnostic::pointerOnPageBoundary, atom, fixUpAddr, fit->offsetInAtom });
+											result.hasUnalignedFixup = true;
+										}
+										break;
+									default:
+										assert(0 && "unknown pointer format");
+								}
+							}
+
+							if ( targetNeedsNoFixup(target) )
+								continue;
 
-						unsigned pageIndex = (fixUpAddr - _chainedFixupSegments.back().startAddr)/pageSize;
-						while ( pageIndex >= _chainedFixupSegments.back().pages.size() ) {
-							ChainedFixupPageInfo emptyPage;
-							_chainedFixupSegments.back().pages.push_back(emptyPage);
+							bool isRebase = !needsBind(target, isAuthPtr, &accumulator);
+							if ( !isRebase || _options.outputSlidable() )
+								result.addresses.push_back(fixUpAddr);
+							if ( !isRebase )
+								result.binds.push_back({ target, accumulator, isAuthPtr });
 						}
-						uint16_t pageOffset = fixUpAddr - (_chainedFixupSegments.back().startAddr + pageIndex*pageSize);
-						bool isRebase = !needsBind(target, isAuthPtr, &accumulator);
-						if ( !isRebase || _options.outputSlidable() )
-							_chainedFixupSegments.back().pages[pageIndex].fixupOffsets.push_back(pageOffset);
-						if ( !isRebase )
-							_chainedFixupBinds.ensureTarget(target, isAuthPtr, accumulator);
 					}
 				}
 			}
+			catch (const char* excMsg) {
+				result.exception = excMsg;
+				return;
+			}
 		}
-		lastSect = sect;
+		// sorted here, so merging sections in address order leaves every page's offsets sorted
+		std::sort(result.addresses.begin(), result.addresses.end());
+	});
+
+	// merge per-section results in section order, so warnings and bind ordinals are deterministic
+	for (size_t sectIndex=0; sectIndex < sectionFixups.size(); ++sectIndex) {
+		SectionFixups& result = sectionFixups[sectIndex];
+		for (const SectionFixups::Diagnostic& diag : result.diagnostics) {
+			const ld::Atom* atom = diag.atom;
+			switch ( diag.kind ) {
+				case SectionFixups::Diagnostic::weakOverride:
+					warning("overrides weak external symbol: %s", atom->name());
+					break;
+				case SectionFixups::Diagnostic::unalignedPointer:
+					warning("pointer not aligned at address 0x%llX ('%s' + %u from %s)",
+							diag.address, _options.demangleSymbol(atom->name()), diag.offsetInAtom, atom->safeFilePath());
+					break;
+				case SectionFixups::Diagnostic::pointerOnPageBoundary:
+					warning("pointer not aligned at page boundary address 0x%llX ('%s' + %u from %s)",
+							diag.address, _options.demangleSymbol(atom->name()), diag.offsetInAtom, atom->safeFilePath());
+					break;
+			}
+		}
+		if ( result.exception != nullptr )
+			throw result.exception;
+		if ( result.overridesWeakDef )
+			this->overridesWeakExternalSymbols = true;
+		if ( result.hasUnalignedFixup )
+			_hasUnalignedFixup = true;
+		ChainedFixupSegInfo& segInfo = _chainedFixupSegments[sectSegIndex[sectIndex]];
+		for (uint64_t fixUpAddr : result.addresses) {
+			unsigned pageIndex = (fixUpAddr - segInfo.startAddr)/pageSize;
+			if ( pageIndex >= segInfo.pages.size() )
+				segInfo.pages.resize(pageIndex+1);
+			uint16_t pageOffset = fixUpAddr - (segInfo.startAddr + pageIndex*pageSize);
+			segInfo.pages[pageIndex].fixupOffsets.push_back(pageOffset);
+		}
+		for (const SectionFixups::Bind& bind : result.binds)
+			_chainedFixupBinds.ensureTarget(bind.target, bind.authPtr, bind.addend);
 	}
 	if ( _hasUnalignedFixup )
 		throw "unaligned pointer(s)";
 
-	// sort all fixups on each page, so chain can be built
+	// sections are laid out in address order, so each page is already sorted unless sections overlap
 	for (ChainedFixupSegInfo& segInfo : _chainedFixupSegments) {
 		for (ChainedFixupPageInfo& pageInfo : segInfo.pages) {
-			std::sort(pageInfo.fixupOffsets.begin(), pageInfo.fixupOffsets.end());
+			if ( !std::is_sorted(pageInfo.fixupOffsets.begin(), pageInfo.fixupOffsets.end()) )
+				std::sort(pageInfo.fixupOffsets.begin(), pageInfo.fixupOffsets.end());
 		}
 	}
 
@@ -7174,223 +7447,496 @@ void OutputFile::makeSplitSegInfoV2(ld::Internal& state)
 }
 
 
-void OutputFile::writeMapFile(ld::Internal& state)
+static void appendMapFileLine(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+static void appendMapFileLine(std::string& out, const char* format, ...)
 {
-	if ( _options.generatedMapPath() != NULL ) {
-		FILE* mapFile = fopen(_options.generatedMapPath(), "w");
-		if ( mapFile != NULL ) {
-			// write output path
-			fprintf(mapFile, "# Path: %s\n", _options.outputFilePath());
-			// write output architecure
-			fprintf(mapFile, "# Arch: %s\n", _options.architectureName());
-			// write UUID
-			//if ( fUUIDAtom != NULL ) {
-			//	const uint8_t* uuid = fUUIDAtom->getUUID();
-			//	fprintf(mapFile, "# UUID: %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X \n",
-			//		uuid[0], uuid[1], uuid[2],  uuid[3],  uuid[4],  uuid[5],  uuid[6],  uuid[7],
-			//		uuid[8], uuid[9], uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
-			//}
-			// write table of object files
-			std::map<const ld::File*, ld::File::Ordinal> readerToOrdinal;
-			std::map<ld::File::Ordinal, const ld::File*> ordinalToReader;
-			std::map<const ld::File*, uint32_t> readerToFileOrdinal;
-			for (std::vector<ld::Internal::FinalSection*>::iterator sit = state.sections.begin(); sit != state.sections.end(); ++sit) {
-				ld::Internal::FinalSection* sect = *sit;
-				if ( sect->isSectionHidden() ) 
-					continue;
-				for (std::vector<const ld::Atom*>::iterator ait = sect->atoms.begin(); ait != sect->atoms.end(); ++ait) {
-					const ld::Atom* atom = *ait;
-					const ld::File* reader = atom->originalFile();
-					if ( reader == NULL )
-						continue;
-					ld::File::Ordinal readerOrdinal = reader->ordinal();
-					std::map<const ld::File*, ld::File::Ordinal>::iterator pos = readerToOrdinal.find(reader);
-					if ( pos == readerToOrdinal.end() ) {
-						readerToOrdinal[reader] = readerOrdinal;
-						ordinalToReader[readerOrdinal] = reader;
-					}
-				}
+	char	line[1024];
+	va_list	list;
+	va_start(list, format);
+	va_list	listCopy;
+	va_copy(listCopy, list);
+	int len = vsnprintf(line, sizeof(line), format, list);
+	va_end(list);
+	if ( len < (int)sizeof(line) ) {
+		out.append(line, len);
+	}
+	else {
+		// very long symbol name, format directly into the output
+		size_t start = out.size();
+		out.resize(start + len + 1);
+		vsnprintf(&out[start], len + 1, format, listCopy);
+		out.resize(start + len);
+	}
+	va_end(listCopy);
+}
+
+static const char* mapFileAtomName(const ld::Internal& state, const ld::Atom* atom, bool dead, char buffer[4096])
+{
+	const char* name = atom->name();
+	if ( atom->contentType() == ld::Atom::typeCString ) {
+		strcpy(buffer, "literal string: ");
+		const char* s = (char*)atom->rawContentPointer();
+		char* e = &buffer[4094];
+		for (char* b = &buffer[strlen(buffer)]; b < e;) {
+			char c = *s++;
+			if ( c == '\n' ) {
+				*b++ = '\\';
+				*b++ = 'n';
+			}
+			else if ( dead ) {
+				*b++ = c;
+			}
+			else if ( c == '\r' ) {
+				*b++ = '\\';
+				*b++ = 'r';
+			}
+			else if ( c == '\t' ) {
+				*b++ = '\\';
+				*b++ = 't';
+			}
+			else if ( c == '\"' ) {
+				*b++ = '\\';
+				*b++ = '\"';
 			}
-			// for LTO build map of symbols back to original .o file
-			__block std::map<std::string, const ld::File*> ltoSymbolsMap;
-			for (const ld::relocatable::File* ltoFile : state.filesForLTO) {
-				ltoFile->forEachLtoSymbol(^(const char* symName) {
-					auto pos = ltoSymbolsMap.find(symName);
-					if ( pos == ltoSymbolsMap.end() ) {
-						ltoSymbolsMap[symName] = ltoFile;
-					}
-					else {
-						// same symbol in multiple files, map will show lto.o
-						pos->second = nullptr;
-					}
-				});
-				// add to object file table even if nothing used from it
-				if ( readerToOrdinal.count(ltoFile) == 0 ) {
-					ld::File::Ordinal readerOrdinal = ltoFile->ordinal();
-					readerToOrdinal[ltoFile] = readerOrdinal;
-					ordinalToReader[readerOrdinal] = ltoFile;
+			else {
+				*b++ = c;
+			}
+			if ( c == '\0' )
+				break;
+		}
+		buffer[4095] = '\0';
+		name = buffer;
+	}
+	else if ( dead ) {
+		// dead stripped atoms are shown with their own name
+	}
+	else if ( (atom->contentType() == ld::Atom::typeCFI) && (strcmp(name, "FDE") == 0) ) {
+		for (ld::Fixup::iterator fit = atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit) {
+			if ( (fit->kind == ld::Fixup::kindSetTargetAddress) && (fit->clusterSize == ld::Fixup::k1of4) ) {
+				if ( (fit->binding == ld::Fixup::bindingDirectlyBound)
+				 &&  (fit->u.target->section().type() == ld::Section::typeCode) ) {
+					strcpy(buffer, "FDE for: ");
+					strlcat(buffer, fit->u.target->name(), 4096);
+					name = buffer;
 				}
 			}
+		}
+	}
+	else if ( atom->contentType() == ld::Atom::typeNonLazyPointer ) {
+		strcpy(buffer, "non-lazy-pointer");
+		for (ld::Fixup::iterator fit = atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit) {
+			if ( fit->binding == ld::Fixup::bindingsIndirectlyBound ) {
+				strcpy(buffer, "non-lazy-pointer-to: ");
+				strlcat(buffer, state.indirectBindingTable[fit->u.bindingIndex]->name(), 4096);
+				break;
+			}
+			else if ( fit->binding == ld::Fixup::bindingDirectlyBound ) {
+				strcpy(buffer, "non-lazy-pointer-to-local: ");
+				strlcat(buffer, fit->u.target->name(), 4096);
+				break;
+			}
+		}
+		name = buffer;
+	}
+	return name;
+}
 
-			for (const ld::Atom* atom : state.deadAtoms) {
-				const ld::File* reader = atom->originalFile();
-				if ( reader == NULL )
-					continue;
-				ld::File::Ordinal readerOrdinal = reader->ordinal();
-				std::map<const ld::File*, ld::File::Ordinal>::iterator pos = readerToOrdinal.find(reader);
-				if ( pos == readerToOrdinal.end() ) {
-					readerToOrdinal[reader] = readerOrdinal;
-					ordinalToReader[readerOrdinal] = reader;
-				}
-			}
-			fprintf(mapFile, "# Object files:\n");
-			fprintf(mapFile, "[%3u] %s\n", 0, "linker synthesized");
-			uint32_t fileIndex = 1;
-			for(std::map<ld::File::Ordinal, const ld::File*>::iterator it = ordinalToReader.begin(); it != ordinalToReader.end(); ++it) {
-				fprintf(mapFile, "[%3u] %s\n", fileIndex, it->second->path());
-				readerToFileOrdinal[it->second] = fileIndex++;
-			}
-			// write table of sections
-			fprintf(mapFile, "# Sections:\n");
-			fprintf(mapFile, "# Address\tSize    \tSegment\tSection\n"); 
-			for (std::vector<ld::Internal::FinalSection*>::iterator sit = state.sections.begin(); sit != state.sections.end(); ++sit) {
-				ld::Internal::FinalSection* sect = *sit;
-				if ( sect->isSectionHidden() ) 
-					continue;
-				fprintf(mapFile, "0x%08llX\t0x%08llX\t%s\t%s\n", sect->address, sect->size, 
-							sect->segmentName(), sect->sectionName());
+//
+// The map file is rendered in independent chunks (slices of a section's atoms, or of the dead
+// atom list) on all cores, a bounded batch at a time.  Each batch is written out in order and
+// freed before the next one is rendered, so the whole map is never held in memory.  Each chunk
+// carries both the text lines for -map and the records and strings for -binary_map.
+//
+struct MapFileChunk
+{
+	ld::Internal::FinalSection*		section			= nullptr;		// nullptr for dead atoms
+	uint16_t						sectionIndex	= LINK_MAP_NO_SECTION;
+	size_t							start			= 0;			// range in section->atoms or state.deadAtoms
+	size_t							end				= 0;
+	uint64_t						symbolCount		= 0;
+	std::string						text;
+	std::vector<link_map_symbol>	symbols;
+	std::string						strings;
+};
+
+static uint64_t appendMapFileString(std::string& pool, const char* str)
+{
+	uint64_t offset = pool.size();
+	pool.append(str);
+	pool.push_back('\0');
+	return offset;
+}
+
+// the binary map is little endian whatever the host, convert each record just before it is written
+static void linkMapToLittleEndian(link_map_header& header)
+{
+	LittleEndian::set32(header.version,			header.version);
+	LittleEndian::set32(header.headerSize,		header.headerSize);
+	LittleEndian::set32(header.cputype,			header.cputype);
+	LittleEndian::set32(header.cpusubtype,		header.cpusubtype);
+	LittleEndian::set32(header.outputPathStrx,	header.outputPathStrx);
+	LittleEndian::set32(header.archNameStrx,	header.archNameStrx);
+	LittleEndian::set64(header.filesOffset,		header.filesOffset);
+	LittleEndian::set64(header.filesCount,		header.filesCount);
+	LittleEndian::set64(header.sectionsOffset,	header.sectionsOffset);
+	LittleEndian::set64(header.sectionsCount,	header.sectionsCount);
+	LittleEndian::set64(header.symbolsOffset,	header.symbolsOffset);
+	LittleEndian::set64(header.symbolsCount,	header.symbolsCount);
+	LittleEndian::set64(header.stringsOffset,	header.stringsOffset);
+	LittleEndian::set64(header.stringsSize,		header.stringsSize);
+}
+
+static void linkMapToLittleEndian(link_map_file& file)
+{
+	LittleEndian::set64(file.pathStrx, file.pathStrx);
+}
+
+static void linkMapToLittleEndian(link_map_section& sect)
+{
+	LittleEndian::set64(sect.address,		sect.address);
+	LittleEndian::set64(sect.size,			sect.size);
+	LittleEndian::set32(sect.segmentStrx,	sect.segmentStrx);
+	LittleEndian::set32(sect.sectionStrx,	sect.sectionStrx);
+}
+
+static void linkMapToLittleEndian(link_map_symbol& sym)
+{
+	LittleEndian::set64(sym.address,		sym.address);
+	LittleEndian::set64(sym.size,			sym.size);
+	LittleEndian::set64(sym.nameStrx,		sym.nameStrx);
+	LittleEndian::set32(sym.fileIndex,		sym.fileIndex);
+	LittleEndian::set16(sym.sectionIndex,	sym.sectionIndex);
+	LittleEndian::set16(sym.flags,			sym.flags);
+}
+
+static void writeLinkMapHeader(FILE* binaryMapFile, link_map_header header)
+{
+	linkMapToLittleEndian(header);
+	fseeko(binaryMapFile, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, binaryMapFile);
+}
+
+// don't add auto-stripped aliases to .map file
+static bool skipInMapFile(const ld::Atom* atom)
+{
+	return (atom->size() == 0) && (atom->symbolTableInclusion() == ld::Atom::symbolTableNotInFinalLinkedImages);
+}
+
+void OutputFile::writeMapFile(ld::Internal& state)
+{
+	const char* textMapPath   = _options.generatedMapPath();
+	const char* binaryMapPath = _options.generatedBinaryMapPath();
+	if ( (textMapPath == NULL) && (binaryMapPath == NULL) )
+		return;
+
+	FILE* mapFile = NULL;
+	if ( textMapPath != NULL ) {
+		mapFile = fopen(textMapPath, "w");
+		if ( mapFile == NULL )
+			warning("could not write map file: %s\n", textMapPath);
+	}
+	FILE* binaryMapFile = NULL;
+	if ( binaryMapPath != NULL ) {
+		binaryMapFile = fopen(binaryMapPath, "w");
+		if ( binaryMapFile == NULL )
+			warning("could not write binary map file: %s\n", binaryMapPath);
+	}
+	if ( binaryMapFile != NULL ) {
+		// symbols record their section in 16 bits, and the largest value means none
+		size_t visibleSectionCount = std::count_if(state.sections.begin(), state.sections.end(), [](const ld::Internal::FinalSection* sect) {
+			return !sect->isSectionHidden();
+		});
+		if ( visibleSectionCount >= LINK_MAP_NO_SECTION ) {
+			warning("could not write binary map file: %s, output has more than %u sections\n", binaryMapPath, LINK_MAP_NO_SECTION - 1);
+			fclose(binaryMapFile);
+			::unlink(binaryMapPath);
+			binaryMapFile = NULL;
+		}
+	}
+	if ( (mapFile == NULL) && (binaryMapFile == NULL) )
+		return;
+	const bool makeText   = (mapFile != NULL);
+	const bool makeBinary = (binaryMapFile != NULL);
+
+	// build table of object files, ordered by file ordinal
+	__block std::unordered_map<const ld::File*, uint32_t> readerToFileOrdinal;
+	std::vector<const ld::File*> readers;
+	auto noteReader = [&](const ld::File* reader) {
+		if ( reader == NULL )
+			return;
+		if ( readerToFileOrdinal.emplace(reader, 0).second )
+			readers.push_back(reader);
+	};
+	for (ld::Internal::FinalSection* sect : state.sections) {
+		if ( sect->isSectionHidden() )
+			continue;
+		const ld::File* lastReader = NULL;
+		for (const ld::Atom* atom : sect->atoms) {
+			// atoms from the same file are usually adjacent, so skip the hash lookup for them
+			const ld::File* reader = atom->originalFile();
+			if ( reader == lastReader )
+				continue;
+			lastReader = reader;
+			noteReader(reader);
+		}
+	}
+	// for LTO build map of symbols back to original .o file
+	__block std::unordered_map<std::string, const ld::File*> ltoSymbolsMap;
+	for (const ld::relocatable::File* ltoFile : state.filesForLTO) {
+		ltoFile->forEachLtoSymbol(^(const char* symName) {
+			auto pos = ltoSymbolsMap.find(symName);
+			if ( pos == ltoSymbolsMap.end() ) {
+				ltoSymbolsMap[symName] = ltoFile;
 			}
-			// write table of symbols
-			fprintf(mapFile, "# Symbols:\n");
-			fprintf(mapFile, "# Address\tSize    \tFile  Name\n"); 
-			for (std::vector<ld::Internal::FinalSection*>::iterator sit = state.sections.begin(); sit != state.sections.end(); ++sit) {
-				ld::Internal::FinalSection* sect = *sit;
-				if ( sect->isSectionHidden() ) 
+			else {
+				// same symbol in multiple files, map will show lto.o
+				pos->second = nullptr;
+			}
+		});
+		// add to object file table even if nothing used from it
+		noteReader(ltoFile);
+	}
+	for (const ld::Atom* atom : state.deadAtoms)
+		noteReader(atom->originalFile());
+	std::sort(readers.begin(), readers.end(), [](const ld::File* left, const ld::File* right) {
+		return left->ordinal() < right->ordinal();
+	});
+	uint32_t fileIndex = 1;
+	for (const ld::File* reader : readers)
+		readerToFileOrdinal[reader] = fileIndex++;
+
+	// carve the work into chunks that can be rendered independently
+	const size_t kAtomsPerChunk = 4096;
+	std::vector<const ld::Internal::FinalSection*> visibleSections;
+	__block std::vector<MapFileChunk> chunks;
+	for (ld::Internal::FinalSection* sect : state.sections) {
+		if ( sect->isSectionHidden() )
+			continue;
+		const uint16_t sectionIndex = (uint16_t)visibleSections.size();
+		visibleSections.push_back(sect);
+		for (size_t start = 0; start < sect->atoms.size(); start += kAtomsPerChunk) {
+			MapFileChunk chunk;
+			chunk.section      = sect;
+			chunk.sectionIndex = sectionIndex;
+			chunk.start        = start;
+			chunk.end          = std::min(start + kAtomsPerChunk, sect->atoms.size());
+			chunks.push_back(std::move(chunk));
+		}
+	}
+	const bool emitDeadStrippedSymbols = _options.deadCodeStrip();
+	const size_t firstDeadChunk = chunks.size();
+	if ( emitDeadStrippedSymbols ) {
+		for (size_t start = 0; start < state.deadAtoms.size(); start += kAtomsPerChunk) {
+			MapFileChunk chunk;
+			chunk.start = start;
+			chunk.end   = std::min(start + kAtomsPerChunk, state.deadAtoms.size());
+			chunks.push_back(std::move(chunk));
+		}
+	}
+	auto chunkAtom = [&](const MapFileChunk& chunk, size_t i) -> const ld::Atom* {
+		return (chunk.section != nullptr) ? chunk.section->atoms[i] : state.deadAtoms[i];
+	};
+
+	if ( mapFile != NULL ) {
+		// write output path
+		fprintf(mapFile, "# Path: %s\n", _options.outputFilePath());
+		// write output architecure
+		fprintf(mapFile, "# Arch: %s\n", _options.architectureName());
+		// write table of object files
+		fprintf(mapFile, "# Object files:\n");
+		fprintf(mapFile, "[%3u] %s\n", 0, "linker synthesized");
+		for (const ld::File* reader : readers)
+			fprintf(mapFile, "[%3u] %s\n", readerToFileOrdinal[reader], reader->path());
+		// write table of sections
+		fprintf(mapFile, "# Sections:\n");
+		fprintf(mapFile, "# Address\tSize    \tSegment\tSection\n"); 
+		for (const ld::Internal::FinalSection* sect : visibleSections) {
+			fprintf(mapFile, "0x%08llX\t0x%08llX\t%s\t%s\n", sect->address, sect->size,
+						sect->segmentName(), sect->sectionName());
+		}
+		// write table of symbols
+		fprintf(mapFile, "# Symbols:\n");
+		fprintf(mapFile, "# Address\tSize    \tFile  Name\n"); 
+	}
+
+	// the binary map's tables are sized up front, so each rendered chunk can be written straight to its place:
+	// header, files, sections, then all symbols, then the string pool starting with the header strings
+	link_map_header header;
+	std::string headerStrings;
+	off_t symbolsPos = 0;
+	off_t stringsPos = 0;
+	uint64_t stringsSize = 0;
+	if ( binaryMapFile != NULL ) {
+		dispatch_apply(chunks.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
+			MapFileChunk& chunk = chunks[index];
+			for (size_t i = chunk.start; i < chunk.end; ++i) {
+				if ( !skipInMapFile(chunkAtom(chunk, i)) )
+					++chunk.symbolCount;
+			}
+		});
+		uint64_t symbolsCount = 0;
+		for (const MapFileChunk& chunk : chunks)
+			symbolsCount += chunk.symbolCount;
+
+		appendMapFileString(headerStrings, "");
+		std::vector<link_map_file> files;
+		files.push_back({ appendMapFileString(headerStrings, "linker synthesized") });
+		for (const ld::File* reader : readers)
+			files.push_back({ appendMapFileString(headerStrings, reader->path()) });
+		std::vector<link_map_section> sections;
+		for (const ld::Internal::FinalSection* finalSect : visibleSections) {
+			link_map_section sect;
+			sect.address     = finalSect->address;
+			sect.size        = finalSect->size;
+			sect.segmentStrx = (uint32_t)appendMapFileString(headerStrings, finalSect->segmentName());
+			sect.sectionStrx = (uint32_t)appendMapFileString(headerStrings, finalSect->sectionName());
+			sections.push_back(sect);
+		}
+		bzero(&header, sizeof(header));
+		memcpy(header.magic, LINK_MAP_MAGIC, sizeof(header.magic));
+		header.version        = LINK_MAP_VERSION;
+		header.headerSize     = sizeof(link_map_header);
+		header.cputype        = _options.architecture();
+		header.cpusubtype     = _options.subArchitecture();
+		header.outputPathStrx = (uint32_t)appendMapFileString(headerStrings, _options.outputFilePath());
+		header.archNameStrx   = (uint32_t)appendMapFileString(headerStrings, _options.architectureName());
+		header.filesOffset    = sizeof(link_map_header);
+		header.filesCount     = files.size();
+		header.sectionsOffset = header.filesOffset + files.size() * sizeof(link_map_file);
+		header.sectionsCount  = sections.size();
+		header.symbolsOffset  = header.sectionsOffset + sections.size() * sizeof(link_map_section);
+		header.symbolsCount   = symbolsCount;
+		header.stringsOffset  = header.symbolsOffset + symbolsCount * sizeof(link_map_symbol);
+
+		// header is written again once the string pool size is known
+		writeLinkMapHeader(binaryMapFile, header);
+		for (link_map_file& file : files)
+			linkMapToLittleEndian(file);
+		for (link_map_section& sect : sections)
+			linkMapToLittleEndian(sect);
+		fwrite(files.data(), files.size() * sizeof(link_map_file), 1, binaryMapFile);
+		fwrite(sections.data(), sections.size() * sizeof(link_map_section), 1, binaryMapFile);
+		fseeko(binaryMapFile, header.stringsOffset, SEEK_SET);
+		fwrite(headerStrings.data(), headerStrings.size(), 1, binaryMapFile);
+		symbolsPos  = header.symbolsOffset;
+		stringsPos  = header.stringsOffset + headerStrings.size();
+		stringsSize = headerStrings.size();
+	}
+
+	void (^renderChunk)(size_t) = ^(size_t index) {
+		MapFileChunk& chunk = chunks[index];
+		auto fileOrdinalFor = [&](const ld::File* file) -> uint32_t {
+			const auto& pos = readerToFileOrdinal.find(file);
+			return (pos != readerToFileOrdinal.end()) ? pos->second : 0;
+		};
+		auto addSymbol = [&](const ld::Atom* atom, const char* name, uint32_t fromFileOrdinal, bool dead) {
+			link_map_symbol sym;
+			sym.address      = dead ? 0 : atom->finalAddress();
+			sym.size         = atom->size();
+			sym.nameStrx     = appendMapFileString(chunk.strings, name);
+			sym.fileIndex    = fromFileOrdinal;
+			sym.sectionIndex = chunk.sectionIndex;
+			sym.flags        = (dead ? LINK_MAP_SYMBOL_DEAD : 0) | ((name != atom->name()) ? LINK_MAP_SYMBOL_SYNTHESIZED : 0);
+			chunk.symbols.push_back(sym);
+		};
+		char buffer[4096];
+		if ( chunk.section != nullptr ) {
+			for (size_t i = chunk.start; i < chunk.end; ++i) {
+				const ld::Atom* atom = chunk.section->atoms[i];
+				if ( skipInMapFile(atom) )
 					continue;
-				//bool isCstring = (sect->type() == ld::Section::typeCString);
-				for (std::vector<const ld::Atom*>::iterator ait = sect->atoms.begin(); ait != sect->atoms.end(); ++ait) {
-					char buffer[4096];
-					const ld::Atom* atom = *ait;
-					const char* name = atom->name();
-					// don't add auto-stripped aliases to .map file
-					if ( (atom->size() == 0) && (atom->symbolTableInclusion() == ld::Atom::symbolTableNotInFinalLinkedImages) )
-						continue;
-					if ( atom->contentType() == ld::Atom::typeCString ) {
-						strcpy(buffer, "literal string: ");
-						const char* s = (char*)atom->rawContentPointer();
-						char* e = &buffer[4094];
-						for (char* b = &buffer[strlen(buffer)]; b < e;) {
-							char c = *s++;
-							if ( c == '\n' ) {
-								*b++ = '\\';
-								*b++ = 'n';
-							}
-							else if ( c == '\r' ) {
-								*b++ = '\\';
-								*b++ = 'r';
-							}
-							else if ( c == '\t' ) {
-								*b++ = '\\';
-								*b++ = 't';
-							}
-							else if ( c == '\"' ) {
-								*b++ = '\\';
-								*b++ = '\"';
-							}
-							else {
-								*b++ = c;
-							}
-							if ( c == '\0' )
-								break;
-						}
-						buffer[4095] = '\0';
-						name = buffer;
-					}
-					else if ( (atom->contentType() == ld::Atom::typeCFI) && (strcmp(name, "FDE") == 0) ) {
-						for (ld::Fixup::iterator fit = atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit) {
-							if ( (fit->kind == ld::Fixup::kindSetTargetAddress) && (fit->clusterSize == ld::Fixup::k1of4) ) {
-								if ( (fit->binding == ld::Fixup::bindingDirectlyBound)
-								 &&  (fit->u.target->section().type() == ld::Section::typeCode) ) {
-									strcpy(buffer, "FDE for: ");
-									strlcat(buffer, fit->u.target->name(), 4096);
-									name = buffer;
-								}
-							}
+				const char* name = mapFileAtomName(state, atom, false, buffer);
+				// <rdar://problem/50031245> LTO: preserve the original file reference for symbols in link map
+				uint32_t fromFileOrdinal = fileOrdinalFor(atom->originalFile());
+				const ld::relocatable::File* objFile = dynamic_cast<const ld::relocatable::File*>(atom->originalFile());
+				if ( (objFile != nullptr) && (objFile->sourceKind() == ld::relocatable::File::kSourceLTO) ) {
+					const auto& pos = ltoSymbolsMap.find(atom->name());
+					if ( pos != ltoSymbolsMap.end() ) {
+						const ld::File* betterFile = pos->second;
+						if ( betterFile != nullptr ) {
+							const auto& pos2 = readerToFileOrdinal.find(betterFile);
+							if ( pos2 != readerToFileOrdinal.end() )
+								fromFileOrdinal = pos2->second;
 						}
 					}
-					else if ( atom->contentType() == ld::Atom::typeNonLazyPointer ) {
-						strcpy(buffer, "non-lazy-pointer");
-						for (ld::Fixup::iterator fit = atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit) {
-							if ( fit->binding == ld::Fixup::bindingsIndirectlyBound ) {
-								strcpy(buffer, "non-lazy-pointer-to: ");
-								strlcat(buffer, state.indirectBindingTable[fit->u.bindingIndex]->name(), 4096);
-								break;
-							}
-							else if ( fit->binding == ld::Fixup::bindingDirectlyBound ) {
-								strcpy(buffer, "non-lazy-pointer-to-local: ");
-								strlcat(buffer, fit->u.target->name(), 4096);
-								break;
-							}
-						}
-						name = buffer;
-					}
-					// <rdar://problem/50031245> LTO: preserve the original file reference for symbols in link map
-					unsigned fromFileOrdinal = readerToFileOrdinal[atom->originalFile()];
-					const ld::relocatable::File* objFile = dynamic_cast<const ld::relocatable::File*>(atom->originalFile());
-					if ( (objFile != nullptr) && (objFile->sourceKind() == ld::relocatable::File::kSourceLTO) ) {
-						const auto& pos = ltoSymbolsMap.find(atom->name());
-						if ( pos != ltoSymbolsMap.end() ) {
-							const ld::File* betterFile = pos->second;
-							if ( betterFile != nullptr ) {
-								const auto& pos2 = readerToFileOrdinal.find(betterFile);
-								if ( pos2 != readerToFileOrdinal.end() )
-									fromFileOrdinal = pos2->second;
-							}
-						}
-					}
-					fprintf(mapFile, "0x%08llX\t0x%08llX\t[%3u] %s\n", atom->finalAddress(), atom->size(), fromFileOrdinal, name);
-				}
-			}
-			bool emitDeadStrippedSymbols = _options.deadCodeStrip();
-			if ( emitDeadStrippedSymbols  ) {
-				fprintf(mapFile, "\n");
-				fprintf(mapFile, "# Dead Stripped Symbols:\n");
-				fprintf(mapFile, "#        \tSize    \tFile  Name\n");
-				for (const ld::Atom* atom : state.deadAtoms) {
-					char buffer[4096];
-					const char* name = atom->name();
-					// don't add auto-stripped aliases to .map file
-					if ( (atom->size() == 0) && (atom->symbolTableInclusion() == ld::Atom::symbolTableNotInFinalLinkedImages) )
-						continue;
-					if ( atom->contentType() == ld::Atom::typeCString ) {
-						strcpy(buffer, "literal string: ");
-						const char* s = (char*)atom->rawContentPointer();
-						char* e = &buffer[4094];
-						for (char* b = &buffer[strlen(buffer)]; b < e;) {
-							char c = *s++;
-							if ( c == '\n' ) {
-								*b++ = '\\';
-								*b++ = 'n';
-							}
-							else {
-								*b++ = c;
-							}
-							if ( c == '\0' )
-								break;
-						}
-						buffer[4095] = '\0';
-						name = buffer;
-					}
-					fprintf(mapFile, "<<dead>> \t0x%08llX\t[%3u] %s\n",  atom->size(),
-							readerToFileOrdinal[atom->originalFile()], name);
 				}
+				if ( makeText )
+					appendMapFileLine(chunk.text, "0x%08llX\t0x%08llX\t[%3u] %s\n", atom->finalAddress(), atom->size(), fromFileOrdinal, name);
+				if ( makeBinary )
+					addSymbol(atom, name, fromFileOrdinal, false);
 			}
-			fclose(mapFile);
 		}
 		else {
-			warning("could not write map file: %s\n", _options.generatedMapPath());
+			for (size_t i = chunk.start; i < chunk.end; ++i) {
+				const ld::Atom* atom = state.deadAtoms[i];
+				if ( skipInMapFile(atom) )
+					continue;
+				const char* name = mapFileAtomName(state, atom, true, buffer);
+				uint32_t fromFileOrdinal = fileOrdinalFor(atom->originalFile());
+				if ( makeText )
+					appendMapFileLine(chunk.text, "<<dead>> \t0x%08llX\t[%3u] %s\n", atom->size(), fromFileOrdinal, name);
+				if ( makeBinary )
+					addSymbol(atom, name, fromFileOrdinal, true);
+			}
+		}
+	};
+
+	// render a batch on all cores, write it out in order, and free it before rendering the next
+	const size_t kChunksPerBatch = 64;
+	bool wroteDeadHeader = false;
+	auto writeDeadHeader = [&]() {
+		fprintf(mapFile, "\n");
+		fprintf(mapFile, "# Dead Stripped Symbols:\n");
+		fprintf(mapFile, "#        \tSize    \tFile  Name\n");
+		wroteDeadHeader = true;
+	};
+	for (size_t batchStart = 0; batchStart < chunks.size(); batchStart += kChunksPerBatch) {
+		const size_t batchEnd = std::min(batchStart + kChunksPerBatch, chunks.size());
+		dispatch_apply(batchEnd - batchStart, DISPATCH_APPLY_AUTO, ^(size_t i) {
+			renderChunk(batchStart + i);
+		});
+		for (size_t index = batchStart; index < batchEnd; ++index) {
+			MapFileChunk& chunk = chunks[index];
+			if ( mapFile != NULL ) {
+				if ( (index == firstDeadChunk) && !wroteDeadHeader )
+					writeDeadHeader();
+				fwrite(chunk.text.data(), chunk.text.size(), 1, mapFile);
+			}
+			if ( binaryMapFile != NULL ) {
+				assert(chunk.symbols.size() == chunk.symbolCount);
+				for (link_map_symbol& sym : chunk.symbols) {
+					sym.nameStrx += stringsSize;
+					linkMapToLittleEndian(sym);
+				}
+				fseeko(binaryMapFile, symbolsPos, SEEK_SET);
+				fwrite(chunk.symbols.data(), chunk.symbols.size() * sizeof(link_map_symbol), 1, binaryMapFile);
+				symbolsPos += chunk.symbols.size() * sizeof(link_map_symbol);
+				fseeko(binaryMapFile, stringsPos, SEEK_SET);
+				fwrite(chunk.strings.data(), chunk.strings.size(), 1, binaryMapFile);
+				stringsPos  += chunk.strings.size();
+				stringsSize += chunk.strings.size();
+			}
+			std::string().swap(chunk.text);
+			std::vector<link_map_symbol>().swap(chunk.symbols);
+			std::string().swap(chunk.strings);
 		}
 	}
+
+	if ( mapFile != NULL ) {
+		if ( emitDeadStrippedSymbols && !wroteDeadHeader )
+			writeDeadHeader();
+		if ( ferror(mapFile) )
+			warning("could not write map file: %s\n", textMapPath);
+		fclose(mapFile);
+	}
+
+	if ( binaryMapFile != NULL ) {
+		header.stringsSize = stringsSize;
+		writeLinkMapHeader(binaryMapFile, header);
+		if ( ferror(binaryMapFile) )
+			warning("could not write binary map file: %s\n", binaryMapPath);
+		fclose(binaryMapFile);
+	}
 }
 
 static std::string realPathString(const char* path)
@@ -7578,25 +8124,58 @@ static time_t fileModTime(const char* path) {
 }
 
 
+// splits a translation unit path into the directory (with trailing '/') and leaf name for N_SO stabs,
+// both in one malloc()ed buffer which starts at dirPath
+static void splitTranslationUnitPath(const char* path, const char*& dirPath, const char*& fileName)
+{
+	const char* lastSlash = strrchr(path, '/');
+	if ( lastSlash == nullptr ) {
+		// Not a single slash found - there should be at
+		// least one separating directory and filename.
+		dirPath  = nullptr;
+		fileName = nullptr;
+		return;
+	}
+	// lldb wants directory SO's to end in '/'
+	size_t dirLen = lastSlash - path + 1;
+	char* buffer = (char*)malloc(strlen(path) + 2);
+	memcpy(buffer, path, dirLen);
+	buffer[dirLen] = '\0';
+	strcpy(&buffer[dirLen+1], lastSlash+1);
+	dirPath  = buffer;
+	fileName = &buffer[dirLen+1];
+}
+
 void OutputFile::synthesizeDebugNotes(ld::Internal& state)
 {
 	// -S means don't synthesize debug map
 	if ( _options.debugInfoStripping() == Options::kDebugInfoNone )
 		return;
-	// make a vector of atoms that come from files compiled with dwarf debug info
-	std::set<const ld::Atom*> atomsWithStabs;
-	std::set<const ld::relocatable::File*> filesSeenWithStabs;
-	const ld::relocatable::File* curObjFile = nullptr;
-	bool 						 curObjFileHasDwarf = false;
-	bool 					     curObjFileHasStabs = false;
-	std::map<const ld::relocatable::File*, std::vector<const ld::Atom*>> allStabs;
-	std::vector<const ld::relocatable::File*> fileOrder;
-	for (const ld::Internal::FinalSection* sect : state.sections) {
-		for (const ld::Atom* atom : sect->atoms) {
+
+	// find atoms that come from files compiled with debug info, one section per thread
+	struct DebugNoteAtom {
+		const ld::relocatable::File*	file;
+		const ld::Atom*					atom;
+	};
+	struct SectionDebugAtoms {
+		std::vector<DebugNoteAtom>					dwarfAtoms;
+		std::vector<const ld::Atom*>				stabsAtoms;
+		std::vector<const ld::relocatable::File*>	stabsFiles;
+	};
+	__block std::vector<SectionDebugAtoms> perSection(state.sections.size());
+	const bool objectFileOutput = (_options.outputKind() == Options::kObjectFile);
+	const bool staticExecutable = (_options.outputKind() == Options::kStaticExecutable);
+	dispatch_apply(state.sections.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
+		SectionDebugAtoms&			 result				= perSection[index];
+		const ld::File*				 curFile			= nullptr;
+		const ld::relocatable::File* curObjFile			= nullptr;
+		bool 						 curObjFileHasDwarf = false;
+		bool 					     curObjFileHasStabs = false;
+		for (const ld::Atom* atom : state.sections[index]->atoms) {
 			// no stabs for atoms that would not be in the symbol table
 			if ( atom->symbolTableInclusion() == ld::Atom::symbolTableNotIn )
 				continue;
-			if ( (atom->symbolTableInclusion() == ld::Atom::symbolTableNotInFinalLinkedImages) && (_options.outputKind() != Options::kObjectFile) )
+			if ( (atom->symbolTableInclusion() == ld::Atom::symbolTableNotInFinalLinkedImages) && !objectFileOutput )
 				continue;
 			if ( atom->symbolTableInclusion() == ld::Atom::symbolTableInWithRandomAutoStripLabel )
 				continue;
@@ -7612,13 +8191,14 @@ void OutputFile::synthesizeDebugNotes(ld::Internal& state)
 			if ( atom->contentType() == ld::Atom::typeCString )
 				continue;
 			// no stabs for kernel dtrace probes
-			if ( (_options.outputKind() == Options::kStaticExecutable) && (strncmp(atom->name(), "__dtrace_probe$", 15) == 0) )
+			if ( staticExecutable && (strncmp(atom->name(), "__dtrace_probe$", 15) == 0) )
 				continue;
 			// no stabs for empty atoms, they may overlap with other symbols which would make the stabs target ambiguous
 			if ( atom->size() == 0 )
 				continue;
 			if ( const ld::File* file = atom->file() ) {
-				if ( file != curObjFile ) {
+				if ( file != curFile ) {
+					curFile            = file;
 					curObjFile         = dynamic_cast<const ld::relocatable::File*>(file);
 					curObjFileHasDwarf = false;
 					curObjFileHasStabs = false;
@@ -7635,25 +8215,91 @@ void OutputFile::synthesizeDebugNotes(ld::Internal& state)
 								break;
 						}
 					}
-					if ( allStabs.count(curObjFile) == 0 )
-						fileOrder.push_back(curObjFile);
 				}
 				if ( curObjFileHasDwarf ) {
-					allStabs[curObjFile].push_back(atom);
+					result.dwarfAtoms.push_back({ curObjFile, atom });
 				}
 				if ( curObjFileHasStabs ) {
-					atomsWithStabs.insert(atom);
-					if ( curObjFile != NULL )
-						filesSeenWithStabs.insert(curObjFile);
+					result.stabsAtoms.push_back(atom);
+					if ( result.stabsFiles.empty() || (result.stabsFiles.back() != curObjFile) )
+						result.stabsFiles.push_back(curObjFile);
 				}
 			}
 		}
-	}
+	});
 
-	// sort fileOrder by command line order
-	std::sort(fileOrder.begin(), fileOrder.end(), [](const ld::relocatable::File* lhs, const ld::relocatable::File* rhs) {
-		return (lhs->ordinal() < rhs->ordinal());
+	// merge into flat vectors
+	std::vector<DebugNoteAtom>					dwarfAtoms;
+	std::vector<const ld::Atom*>				atomsWithStabs;
+	std::vector<const ld::relocatable::File*>	filesSeenWithStabs;
+	for (const SectionDebugAtoms& sectionAtoms : perSection) {
+		dwarfAtoms.insert(dwarfAtoms.end(), sectionAtoms.dwarfAtoms.begin(), sectionAtoms.dwarfAtoms.end());
+		atomsWithStabs.insert(atomsWithStabs.end(), sectionAtoms.stabsAtoms.begin(), sectionAtoms.stabsAtoms.end());
+		filesSeenWithStabs.insert(filesSeenWithStabs.end(), sectionAtoms.stabsFiles.begin(), sectionAtoms.stabsFiles.end());
+	}
+	perSection.clear();
+	std::sort(atomsWithStabs.begin(), atomsWithStabs.end());
+
+	// group atoms by file in command line order, keeping section order within each file
+	std::stable_sort(dwarfAtoms.begin(), dwarfAtoms.end(), [](const DebugNoteAtom& lhs, const DebugNoteAtom& rhs) {
+		return (lhs.file->ordinal() < rhs.file->ordinal());
+	});
+
+	// per-file work that does not depend on other files: OSO path and splitting of translation unit paths
+	struct TranslationUnitChange {
+		size_t			atomIndex;
+		const char*		dirPath;
+		const char*		fileName;
+	};
+	struct FileDebugNotes {
+		const ld::relocatable::File*		file;
+		size_t								atomsStart;
+		size_t								atomsEnd;
+		const char*							osoPath;
+		time_t								osoModTime;
+		std::vector<TranslationUnitChange>	tuChanges;
+		std::vector<char*>					splitBuffers;
+	};
+	__block std::vector<FileDebugNotes> fileNotes;
+	for (size_t i = 0; i < dwarfAtoms.size(); ++i) {
+		if ( fileNotes.empty() || (fileNotes.back().file != dwarfAtoms[i].file) )
+			fileNotes.push_back({ dwarfAtoms[i].file, i, i, nullptr, 0, {}, {} });
+		fileNotes.back().atomsEnd = i + 1;
+	}
+	const bool zeroModTime = _options.zeroModTimeInDebugMap();
+	const DebugNoteAtom* dwarfAtomsArray = dwarfAtoms.data();
+	dispatch_apply(fileNotes.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
+		FileDebugNotes& notes = fileNotes[index];
+		notes.osoPath    = canonicalOSOPath(notes.file->debugInfoPath());
+		notes.osoModTime = zeroModTime ? 0 : notes.file->debugInfoModificationTime();
+		const char* prevTUPath = nullptr;
+		// translation unit path -> index in tuChanges of its first change, to reuse the split
+		std::unordered_map<std::string_view, size_t> seenTUs;
+		for (size_t i = notes.atomsStart; i < notes.atomsEnd; ++i) {
+			const char* tuPath = dwarfAtomsArray[i].atom->translationUnitSource();
+			if ( tuPath == nullptr )
+				continue;
+			if ( (prevTUPath == nullptr) || (strcmp(prevTUPath, tuPath) != 0) ) {
+				TranslationUnitChange change = { i, nullptr, nullptr };
+				auto pos = seenTUs.find(tuPath);
+				if ( pos != seenTUs.end() ) {
+					change.dirPath  = notes.tuChanges[pos->second].dirPath;
+					change.fileName = notes.tuChanges[pos->second].fileName;
+				}
+				else {
+					splitTranslationUnitPath(tuPath, change.dirPath, change.fileName);
+					if ( change.dirPath != nullptr )
+						notes.splitBuffers.push_back((char*)change.dirPath);
+					seenTUs[tuPath] = notes.tuChanges.size();
+				}
+				notes.tuChanges.push_back(change);
+			}
+			prevTUPath = tuPath;
+		}
 	});
+	// the N_SO stabs point into the split buffers until the symbol table is written
+	for (FileDebugNotes& notes : fileNotes)
+		_debugNoteStrings.insert(_debugNoteStrings.end(), notes.splitBuffers.begin(), notes.splitBuffers.end());
 
 	// <rdar://problem/17689030> Add -add_ast_path option to linker which add N_AST stab entry to output
 	std::set<std::string> seenAstPaths;
@@ -7676,47 +8322,30 @@ void OutputFile::synthesizeDebugNotes(ld::Internal& state)
 	}
 	
 	// synthesize "debug notes" and add them to master stabs vector
-	const char* curDirPath  = nullptr;
-	const char* curFilename = nullptr;
 	const char* curTUPath   = nullptr;
 	bool wroteStartSO = false;
-	state.stabs.reserve(4096);
+	state.stabs.reserve(state.stabs.size() + fileNotes.size()*4 + dwarfAtoms.size()*2);
 	CStringSet seenFiles;
 
-	char* p = (char*)malloc(fileOrder.size() * PATH_MAX);
-	for (const ld::relocatable::File* atomObjFile : fileOrder ) {
-	  for (const ld::Atom* atom : allStabs[atomObjFile]) {
+	for (const FileDebugNotes& notes : fileNotes) {
+	  const ld::relocatable::File* atomObjFile = notes.file;
+	  size_t nextTUChange = 0;
+	  for (size_t i = notes.atomsStart; i < notes.atomsEnd; ++i) {
+		const ld::Atom* atom = dwarfAtoms[i].atom;
 		//fprintf(stderr, "debug note for %s\n", atom->name());
 		if ( const char* newTUPath = atom->translationUnitSource() ) {
 			//fprintf(stderr, "  TU: %s\n", newTUPath);
-			const char* newDirPath = p;
-			const char* newFilename = nullptr;
+			const TranslationUnitChange* tuChange = nullptr;
+			if ( (nextTUChange < notes.tuChanges.size()) && (notes.tuChanges[nextTUChange].atomIndex == i) )
+				tuChange = &notes.tuChanges[nextTUChange++];
 			// need SO's whenever the translation unit source file changes
 			if ( (curTUPath == nullptr) || (strcmp(curTUPath,newTUPath) != 0) ) {
 				curTUPath = newTUPath;
-				// copy full path to buffer and remember where last slash was
-				const char* s = newTUPath;
-				char* lastSlash = nullptr;
-				while (true) {
-					char c = *s++;
-					if ( c == '/' )
-						lastSlash = p;
-					*p++ = c;
-					if ( c == '\0' )
-						break;
-				}
-				// Not a single slash found - there should be at
-				// least one separating directory and filename.
-				if ( lastSlash == nullptr )
+				assert(tuChange != nullptr);
+				const char* newDirPath  = tuChange->dirPath;
+				const char* newFilename = tuChange->fileName;
+				if ( newFilename == nullptr )
 					continue;
-				// lldb wants directory SO's to end in '/',
-				// shuffle leaf name over so nul can be inserted after last slash
-				*p++ = '\0';
-				for (char* s=p-2; s > lastSlash; --s) {
-					s[1] = s[0];
-				}
-				lastSlash[1] = '\0';
-				newFilename = lastSlash+2;
 				if ( curTUPath != nullptr ) {
 					// translation unit change, emit ending SO
 					ld::relocatable::File::Stab endFileStab;
@@ -7752,20 +8381,8 @@ void OutputFile::synthesizeDebugNotes(ld::Internal& state)
 				// <rdar://problem/6337329> linker should put cpusubtype in n_sect field of nlist entry for N_OSO debug note entries
 				objStab.other		= atomObjFile->cpuSubType();
 				objStab.desc		= 1;
-				if ( atomObjFile != NULL ) {
-					objStab.string	= canonicalOSOPath(atomObjFile->debugInfoPath());
-					if ( _options.zeroModTimeInDebugMap() )
-						objStab.value	= 0;
-					else
-						objStab.value	= atomObjFile->debugInfoModificationTime();
-				}
-				else {
-					objStab.string	= canonicalOSOPath(atomObjFile->path());
-					if ( _options.zeroModTimeInDebugMap() )
-						objStab.value	= 0;
-					else
-						objStab.value	= atomObjFile->modificationTime();
-				}
+				objStab.string		= notes.osoPath;
+				objStab.value		= notes.osoModTime;
 				state.stabs.push_back(objStab);
 				wroteStartSO = true;
 				// add the source file path to seenFiles so it does not show up in SOLs
@@ -7792,8 +8409,6 @@ void OutputFile::synthesizeDebugNotes(ld::Internal& state)
 					}
 				}
 			}
-			curFilename = newFilename;
-			curDirPath  = newDirPath;
 			if ( atom->section().type() == ld::Section::typeCode ) {
 				// Synthesize BNSYM and start FUN stabs
 				ld::relocatable::File::Stab beginSym;
@@ -7898,21 +8513,19 @@ void OutputFile::synthesizeDebugNotes(ld::Internal& state)
 	}
 
 	// <rdar://66170674> sort .o files into canonical order
-	std::vector<const ld::relocatable::File*> orderedFilesSeen;
-	for (const ld::relocatable::File* obj : filesSeenWithStabs)
-		orderedFilesSeen.push_back(obj);
-	std::sort(orderedFilesSeen.begin(), orderedFilesSeen.end(), [](const ld::relocatable::File* lhs, const ld::relocatable::File* rhs) {
+	std::sort(filesSeenWithStabs.begin(), filesSeenWithStabs.end(), [](const ld::relocatable::File* lhs, const ld::relocatable::File* rhs) {
 		return (lhs->ordinal() < rhs->ordinal());
 	});
+	filesSeenWithStabs.erase(std::unique(filesSeenWithStabs.begin(), filesSeenWithStabs.end()), filesSeenWithStabs.end());
 
 	// copy any stabs from .o files
 	bool deadStripping = _options.deadCodeStrip();
-	for (const ld::relocatable::File* obj : orderedFilesSeen) {
+	for (const ld::relocatable::File* obj : filesSeenWithStabs) {
 		const std::vector<ld::relocatable::File::Stab>* filesStabs = obj->stabs();
 		if ( filesStabs != NULL ) {
 			for (const ld::relocatable::File::Stab& stab : *filesStabs ) {
 				// ignore stabs associated with atoms that were dead stripped or coalesced away
-				if ( (stab.atom != NULL) && (atomsWithStabs.count(stab.atom) == 0) )
+				if ( (stab.atom != NULL) && !std::binary_search(atomsWithStabs.begin(), atomsWithStabs.end(), stab.atom) )
 					continue;
 				// <rdar://problem/8284718> Value of N_SO stabs should be address of first atom from translation unit
 				if ( (stab.type == N_SO) && (stab.string != NULL) && (stab.string[0] != '\0') ) {
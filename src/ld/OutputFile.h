@@ -66,6 +66,7 @@ public:
 	uint32_t					encryptedTextEndOffset()	{ return _encryptedTEXTendOffset; }
 	int							compressedOrdinalForAtom(const ld::Atom* target) const;
 	uint64_t					fileSize() const { return _fileSize; }
+	uint64_t					tailMergedStringBytes() const;
 
 	bool						targetNeedsNoFixup(const ld::Atom* toTarget);
 	bool						needsBind(const ld::Atom*& toTarget, bool authPtr, uint64_t* accumulator = nullptr,
@@ -310,6 +311,9 @@ private:
 	void 						chain32bitFirmwarePointers(dyld_chained_ptr_32_firmware_rebase* prevLoc, dyld_chained_ptr_32_firmware_rebase* finalLoc,
 															ChainedFixupSegInfo& segInfo, uint8_t* pageBufferStart, uint32_t pageIndex);
 	dyld_chained_ptr_32_firmware_rebase* farthestChainableLocation(dyld_chained_ptr_32_firmware_rebase* start);
+	void						verifyFixupChains(ld::Internal& state, uint8_t* wholeBuffer);
+	void						verifyFixupChainStarts(uint8_t* wholeBuffer, const std::vector<uint32_t>& startOffsets,
+													   const uint8_t* imageLogicalStart, uint64_t imageStartAddress);
 
 	struct InstructionInfo {
 		uint32_t			offsetInAtom;
@@ -417,6 +421,7 @@ public:
 #endif
 	std::vector<SplitSegInfoEntry>			_splitSegInfos;
 	std::vector<SplitSegInfoV2Entry>		_splitSegV2Infos;
+	std::vector<char*>						_debugNoteStrings;		// N_SO paths made by synthesizeDebugNotes(), freed once written
 	class HeaderAndLoadCommandsAbtract*		_headersAndLoadCommandAtom;
 	class RelocationsAtomAbstract*			_sectionsRelocationsAtom;
 	class RelocationsAtomAbstract*			_localRelocsAtom;
@@ -373,6 +373,7 @@ void Resolver::doFile(const ld::File& file)
 			if ( _completedInitialObjectFiles ) {
 				_inputFiles.addLinkerOptionLibraries(_internal, *this);
 				_inputFiles.createIndirectDylibs();
+				_rescanUndefines = true;
 			}
 		}
 		// update which form of ObjC is being used
@@ -719,6 +720,8 @@ void Resolver::doAtom(const ld::Atom& atom)
 
 	// add to list of known atoms
 	_atoms.push_back(&atom);
+	if ( _options.inputCostReport() )
+		_inputFiles.costReport().noteAtom(atom);
 	
 	// adjust scope
 	if ( _options.hasExportRestrictList() || _options.hasReExportList() ) {
@@ -916,8 +919,19 @@ void Resolver::addInitialUndefines()
 }
 
 void Resolver::resolveCurrentUndefines() {
+	// An undefine that no library provided in an earlier round can only be found now if
+	// libraries were added since, so normally only the slots created since the last round
+	// need to be searched.  Skipping the others does not change which files get loaded
+	// or in what order, because searching for them again would find nothing.
 	std::vector<std::string_view> undefineNames;
-	_symbolTable.undefines(undefineNames);
+	if ( _rescanUndefines ) {
+		_rescanUndefines = false;
+		_symbolTable.undefines(undefineNames);
+	}
+	else {
+		_symbolTable.newUndefines(undefineNames);
+	}
+	_inputFiles.parseArchiveMembersAhead(undefineNames);
 	for (const std::string_view& undefsv : undefineNames) {
 		// <rdar://95875374> Don't search libraries for objc_msgSend stubs, they're synthesized.
 		if ( undefsv.starts_with("_objc_msgSend$") ) {
@@ -991,6 +1005,7 @@ void Resolver::resolveAllUndefines()
 {
 	// keep resolving undefines and tentative overrides until no more undefines
 	// were added in last loop
+	_rescanUndefines = true;
 	unsigned int undefineGenCount = 0xFFFFFFFF;
 	while ( undefineGenCount != _symbolTable.updateCount() ) {
 		// first resolve all undefines, there can be several iterations needed as
@@ -2375,6 +2390,7 @@ void Resolver::resolve()
 	this->removeCoalescedAwayAtoms();
 	this->fillInEntryPoint();
 	this->linkTimeOptimize();
+	_inputFiles.dropArchiveMembersParsedAhead();
 	this->fillInInternalState();
 	this->tweakWeakness();
     _symbolTable.checkDuplicateSymbols();
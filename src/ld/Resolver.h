@@ -68,7 +68,8 @@ public:
 								  _haveAliases(false), _havellvmProfiling(false),
 								  _printWhyLive(opts.printWhyLive()),
 								  _synthesizeObjcMsgSendStubs(opts.dyldLoadsOutput()),
-								  _needsObjcMsgSendProxy(false) {}
+								  _needsObjcMsgSendProxy(false),
+								  _rescanUndefines(true) {}
 								
 
 		virtual void		doAtom(const ld::Atom&);
@@ -143,6 +144,7 @@ private:
 	bool							_printWhyLive;
 	bool							_synthesizeObjcMsgSendStubs;
 	bool							_needsObjcMsgSendProxy;
+	bool							_rescanUndefines;		// libraries changed, so older undefines may now resolve
 };
 
 
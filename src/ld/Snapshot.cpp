@@ -17,6 +17,9 @@
 #include <libgen.h>
 #include <time.h>
 #include <Block.h>
+#include <mach/mach_time.h>
+
+#include <algorithm>
 
 #include "Snapshot.h"
 #include "Options.h"
@@ -39,10 +42,26 @@ static const char *origCommandLineString    = "orig_command_line";  // text file
 static const char *linkCommandString        = "link_command";       // text file containing the snapshot equivalent command line
 static const char *assertFileString         = "assert_info";        // text file containing assertion failure logs
 static const char *compileFileString        = "compile_stubs";      // text file containing compile_stubs script
+static const char *timingsString            = "timings";            // text file containing phase and input file timings
+static const char *replayString             = "replay";             // script that re-links the snapshot and compares timings
+
+// Written to the snapshot root for -perf_snapshot. link_command has no -o, and its first word
+// is the linker that made the snapshot, which can be overridden with LD.
+static const char *replayScript =
+    "#!/bin/sh\n"
+    "# Re-links this snapshot with the same inputs in the same order, then compares\n"
+    "# the phase timings with the recorded ones.  Set LD to use a different linker.\n"
+    "cd \"$(dirname \"$0\")\" || exit 1\n"
+    "./compile_stubs || exit 1\n"
+    "cmd=$(cat link_command)\n"
+    "if [ -n \"$LD\" ]; then\n"
+    "\tcmd=\"$LD ${cmd#* }\"\n"
+    "fi\n"
+    "eval \"$cmd -o replay.out -perf_snapshot_baseline timings\"\n";
 
 Snapshot *Snapshot::globalSnapshot = NULL;
 
-Snapshot::Snapshot(const Options * opts) : fOptions(opts), fRecordArgs(false), fRecordObjects(false), fRecordDylibSymbols(false), fRecordArchiveFiles(false), fRecordUmbrellaFiles(false), fRecordDataFiles(false), fFrameworkArgAdded(false), fRecordKext(false), fSnapshotLocation(NULL), fSnapshotName(NULL), fRootDir(NULL), fFilelistFile(-1), fCopiedArchives(NULL)
+Snapshot::Snapshot(const Options * opts) : fOptions(opts), fRecordArgs(false), fRecordObjects(false), fRecordDylibSymbols(false), fRecordArchiveFiles(false), fRecordUmbrellaFiles(false), fRecordDataFiles(false), fFrameworkArgAdded(false), fRecordKext(false), fRecordTimings(false), fSnapshotLocation(NULL), fSnapshotName(NULL), fRootDir(NULL), fFilelistFile(-1), fCopiedArchives(NULL)
 {
     if (globalSnapshot != NULL)
         throw "only one snapshot supported";
@@ -653,3 +672,119 @@ void Snapshot::recordAssertionMessage(const char *fmt, ...)
         }    
     }
 }
+
+
+uint64_t Snapshot::nanoseconds(uint64_t duration)
+{
+    static mach_timebase_info_data_t timeBaseInfo;
+    if (timeBaseInfo.denom == 0)
+        mach_timebase_info(&timeBaseInfo);
+    return duration * timeBaseInfo.numer / timeBaseInfo.denom;
+}
+
+void Snapshot::recordPhaseTime(const char *phase, uint64_t duration)
+{
+    fPhaseTimes.push_back({ phase, nanoseconds(duration) });
+}
+
+void Snapshot::recordFileTime(unsigned index, const char *path, uint64_t duration)
+{
+    std::lock_guard<std::mutex> guard(fFileTimesLock);
+    fFileTimes.push_back({ index, path, nanoseconds(duration) });
+}
+
+void Snapshot::writeTimings()
+{
+    if (isLazy() || !fRecordTimings)
+        return;
+
+    char path[PATH_MAX];
+    buildPath(path, NULL, timingsString);
+    FILE *timings = fopen(path, "w");
+    if (timings == NULL) {
+        warning("unable to write link snapshot timings: %s", path);
+        return;
+    }
+    // the linker sizes its thread pools from the cpu count, so a replay is only comparable on a similar host
+    fprintf(timings, "cpus %ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+    for (const PhaseTime &phase : fPhaseTimes)
+        fprintf(timings, "phase %llu %s\n", (unsigned long long)phase.nanoseconds, phase.name);
+    // list files in command line order, whichever thread parsed them
+    std::sort(fFileTimes.begin(), fFileTimes.end(), [](const FileTime &left, const FileTime &right) {
+        return left.index < right.index;
+    });
+    for (const FileTime &file : fFileTimes)
+        fprintf(timings, "file %llu %s\n", (unsigned long long)file.nanoseconds, file.path);
+    bool failed = (ferror(timings) != 0);
+    if (fclose(timings) != 0)
+        failed = true;
+    if (failed) {
+        warning("unable to write link snapshot timings: %s", path);
+        return;
+    }
+
+    buildPath(path, NULL, replayString);
+    int replay = open(path, O_WRONLY|O_CREAT|O_TRUNC, S_IXUSR|S_IRUSR|S_IWUSR|S_IROTH);
+    if (replay == -1) {
+        warning("unable to write link snapshot replay script: %s", path);
+        return;
+    }
+    size_t replayLength = strlen(replayScript);
+    if (write(replay, replayScript, replayLength) != (ssize_t)replayLength)
+        warning("unable to write link snapshot replay script: %s", path);
+    close(replay);
+}
+
+void Snapshot::compareTimings(const char *baselinePath)
+{
+    FILE *baseline = fopen(baselinePath, "r");
+    if (baseline == NULL) {
+        warning("unable to read link snapshot timings: %s", baselinePath);
+        return;
+    }
+    std::map<std::string, uint64_t> recordedPhases;
+    long recordedCpus = 0;
+    uint64_t recordedFileTime = 0;
+    unsigned recordedFileCount = 0;
+    char line[PATH_MAX+64];
+    while (fgets(line, sizeof(line), baseline) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        unsigned long long value;
+        int nameStart = 0;
+        if (sscanf(line, "cpus %llu", &value) == 1) {
+            recordedCpus = (long)value;
+        } else if ((sscanf(line, "phase %llu %n", &value, &nameStart) == 1) && (nameStart != 0)) {
+            recordedPhases[&line[nameStart]] = value;
+        } else if (sscanf(line, "file %llu", &value) == 1) {
+            recordedFileTime += value;
+            recordedFileCount++;
+        }
+    }
+    fclose(baseline);
+
+    uint64_t fileTime = 0;
+    for (const FileTime &file : fFileTimes)
+        fileTime += file.nanoseconds;
+
+    auto printRow = ^(const char *name, uint64_t before, uint64_t after) {
+        if (before == 0) {
+            fprintf(stderr, "%28s: %12s %12.1f\n", name, "-", after/1000000.0);
+        } else {
+            double change = (((double)after - (double)before) * 100.0) / (double)before;
+            fprintf(stderr, "%28s: %12.1f %12.1f %+8.1f%%\n", name, before/1000000.0, after/1000000.0, change);
+        }
+    };
+    fprintf(stderr, "%28s  %12s %12s %9s\n", "milliseconds", "recorded", "replay", "change");
+    for (const PhaseTime &phase : fPhaseTimes) {
+        auto pos = recordedPhases.find(phase.name);
+        printRow(phase.name, (pos == recordedPhases.end()) ? 0 : pos->second, phase.nanoseconds);
+    }
+    if ((recordedFileCount != 0) || !fFileTimes.empty()) {
+        char name[64];
+        snprintf(name, sizeof(name), "parse %u/%zu input files", recordedFileCount, fFileTimes.size());
+        printRow(name, recordedFileTime, fileTime);
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if ((recordedCpus != 0) && (recordedCpus != cpus))
+        fprintf(stderr, "note: timings were recorded with %ld cpus, replayed with %ld\n", recordedCpus, cpus);
+}
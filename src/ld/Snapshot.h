@@ -11,6 +11,8 @@
 #include <stdint.h>
 #include <string.h>
 #include <map>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include "ld.hpp"
@@ -71,6 +73,26 @@ public:
     // Copies the library binary into the snapshot dylibs directory.
     void recordSubLibrary(const char *dylibPath);
     
+    // Also record how long each link phase and each input file took, for -perf_snapshot.
+    // The snapshot then gets a "timings" file and a "replay" script that re-links it and
+    // compares the new timings with the recorded ones.
+    void setRecordTimings(bool record) { fRecordTimings = record; }
+    bool recordingTimings() const { return fRecordTimings; }
+
+    // Records the duration (in mach_absolute_time() units) of a link phase. Phases are kept
+    // even when no snapshot is made, so compareTimings() can be used on a replay.
+    void recordPhaseTime(const char *phase, uint64_t duration);
+
+    // Records the duration (in mach_absolute_time() units) of parsing input file index.
+    // Safe to call from parser threads.
+    void recordFileTime(unsigned index, const char *path, uint64_t duration);
+
+    // Writes the recorded timings to the snapshot, if recording timings.
+    void writeTimings();
+
+    // Prints the recorded phase timings next to those in a "timings" file from an earlier snapshot.
+    void compareTimings(const char *baselinePath);
+
     // Records arbitrary text messages into a log file in the snapshot.
     // Used by the assertion failure machienery.
     void recordAssertionMessage(const char *fmt, ...);
@@ -97,6 +119,8 @@ private:
     typedef std::map<const char *, int, strcompclass > DylibMap;
     typedef std::map<const char *, const char *, strcompclass> PathMap;
     typedef std::vector<unsigned> IntVector;
+    struct PhaseTime { const char *name; uint64_t nanoseconds; };
+    struct FileTime { unsigned index; const char *path; uint64_t nanoseconds; };
     
     // Write the current contents of the args vector to a file in the snapshot.
     // If filename is NULL then "link_command" is used.
@@ -125,6 +149,9 @@ private:
     // then a path buffer can be supplied in buf. Otherwise an internal buffer is used.
     void copyFileToSnapshot(const char *sourcePath, const char *subdir, char *buf=NULL);
     
+    // Converts a mach_absolute_time() duration to nanoseconds.
+    static uint64_t nanoseconds(uint64_t duration);
+
     // Convert a full path to snapshot relative by constructing an interior pointer at the right offset.
     const char *snapshotRelativePath(const char *path) { return path+strlen(fRootDir)+1; }
     
@@ -144,6 +171,7 @@ private:
     bool fRecordDataFiles;      // record other data files
     bool fFrameworkArgAdded;
     bool fRecordKext;
+    bool fRecordTimings;        // record phase and input file timings, and a replay script
 
     const char *fSnapshotLocation; // parent directory of frootDir
     const char *fSnapshotName;    // a string to use in constructing the snapshot name
@@ -159,6 +187,10 @@ private:
     
     DylibMap fDylibSymbols;    // map of dylib names to string vector containing referenced symbol names
     StringVector *fCopiedArchives;  // vector of .a files that have been copied to the snapshot
+
+    std::vector<PhaseTime> fPhaseTimes;     // in the order phases ran
+    std::vector<FileTime> fFileTimes;       // in the order files finished parsing
+    std::mutex fFileTimesLock;
 };
 
 #endif
@@ -0,0 +1,143 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-*
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef __SUFFIX_STRING_TABLE_H__
+#define __SUFFIX_STRING_TABLE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+#include <algorithm>
+
+namespace ld {
+
+//
+// Builds a string table where a string that is a suffix of another string
+// is not stored on its own, but points into the tail of the longer string
+// (e.g. "Bar" shares the bytes of "_FooBar").  Identical strings are stored once.
+//
+// Usage: add() all strings, call finalize(), then query offsets and copy the table.
+//
+class SuffixStringTable
+{
+public:
+	// returns the index used to query the string's placement after finalize()
+	size_t			add(const char* str, size_t len)	{ _entries.push_back({ str, len, 0, _entries.size() }); return _entries.size()-1; }
+	size_t			count() const						{ return _entries.size(); }
+
+	void			finalize();
+
+	// offset of the string in the table
+	uint64_t		offset(size_t index) const			{ return _entries[index].offset; }
+	// index of the string whose bytes hold this string (itself when it was not merged)
+	size_t			container(size_t index) const		{ return _entries[index].container; }
+	// bytes needed for the merged table, including NUL terminators
+	uint64_t		size() const						{ return _size; }
+	// bytes the strings would need without suffix sharing
+	uint64_t		unmergedSize() const				{ return _unmergedSize; }
+	void			copyTo(char* buffer) const;
+
+private:
+	struct Entry {
+		const char*		str;
+		size_t			len;
+		uint64_t		offset;
+		size_t			container;
+	};
+
+	static bool		reverseLess(const Entry& left, const Entry& right);
+
+	std::vector<Entry>		_entries;
+	std::vector<size_t>		_placed;
+	uint64_t				_size			= 0;
+	uint64_t				_unmergedSize	= 0;
+};
+
+
+// compares strings by their characters from last to first
+inline bool SuffixStringTable::reverseLess(const Entry& left, const Entry& right)
+{
+	const char* l = left.str + left.len;
+	const char* r = right.str + right.len;
+	while ( (l != left.str) && (r != right.str) ) {
+		unsigned char lc = *--l;
+		unsigned char rc = *--r;
+		if ( lc != rc )
+			return (lc < rc);
+	}
+	// when one is a suffix of the other, the shorter sorts first
+	if ( left.len != right.len )
+		return (left.len < right.len);
+	return false;
+}
+
+inline void SuffixStringTable::finalize()
+{
+	// sort by reversed string, so every string is followed by all strings it is a suffix of
+	std::vector<size_t> order(_entries.size());
+	for (size_t i=0; i < order.size(); ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](size_t left, size_t right) {
+		if ( reverseLess(_entries[left], _entries[right]) )
+			return true;
+		if ( reverseLess(_entries[right], _entries[left]) )
+			return false;
+		return (left < right);
+	});
+
+	// walk from longest to shortest within each suffix chain, sharing tails where possible
+	_size = 0;
+	_unmergedSize = 0;
+	_placed.clear();
+	const Entry* prev = nullptr;
+	for (auto it = order.rbegin(); it != order.rend(); ++it) {
+		Entry& entry = _entries[*it];
+		_unmergedSize += entry.len + 1;
+		if ( (prev != nullptr) && (prev->len >= entry.len) && (memcmp(prev->str + prev->len - entry.len, entry.str, entry.len) == 0) ) {
+			entry.offset    = prev->offset + prev->len - entry.len;
+			entry.container = prev->container;
+		}
+		else {
+			entry.offset    = _size;
+			entry.container = *it;
+			_size += entry.len + 1;
+			_placed.push_back(*it);
+		}
+		prev = &entry;
+	}
+}
+
+inline void SuffixStringTable::copyTo(char* buffer) const
+{
+	for (size_t index : _placed) {
+		const Entry& entry = _entries[index];
+		memcpy(&buffer[entry.offset], entry.str, entry.len);
+		buffer[entry.offset + entry.len] = '\0';
+	}
+}
+
+} // namespace ld
+
+#endif // __SUFFIX_STRING_TABLE_H__
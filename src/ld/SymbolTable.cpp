@@ -456,6 +456,8 @@ bool SymbolTable::addByName(const ld::Atom& newAtom, Options::Treatment duplicat
 		}
 		if ( newAtom.definition() == ld::Atom::definitionTentative ) {
 			_hasTentativeDefinitions = true;
+			if ( (existingAtom == NULL) || (existingAtom->definition() != ld::Atom::definitionTentative) )
+				_tentativeSlots.push_back(slot);
 		}
 	}
 	else {
@@ -564,12 +566,22 @@ void SymbolTable::markCoalescedAway(const ld::Atom* atom)
 
 void SymbolTable::undefines(std::vector<std::string_view>& undefs)
 {
-	for (size_t slot = 0; slot < _indirectBindingTable.size(); ++slot) {
+	_undefinesScanned = 0;
+	newUndefines(undefs);
+}
+
+
+void SymbolTable::newUndefines(std::vector<std::string_view>& undefs)
+{
+	// slots are only ever appended, so the slots past the last scan are exactly the names
+	// referenced since then
+	for (size_t slot = _undefinesScanned; slot < _indirectBindingTable.size(); ++slot) {
 		if (_indirectBindingTable[slot] == NULL) {
 			if (const auto& nameIt = _byNameReverseTable.find(slot); nameIt != _byNameReverseTable.end())
 				undefs.push_back(nameIt->second);
 		}
 	}
+	_undefinesScanned = _indirectBindingTable.size();
 	// sort so that undefines are in a stable order (not dependent on hashing functions)
 	std::sort(undefs.begin(), undefs.end());
 }
@@ -577,14 +589,22 @@ void SymbolTable::undefines(std::vector<std::string_view>& undefs)
 
 void SymbolTable::tentativeDefs(std::vector<std::string_view>& tents)
 {
-	// return all names in _byNameTable that have no associated atom
-	for (size_t slot = 0; slot < _indirectBindingTable.size(); ++slot) {
+	// return all names whose slot is still bound to a tentative definition, and forget
+	// slots that have since been overridden
+	size_t kept = 0;
+	for (IndirectBindingSlot slot : _tentativeSlots) {
 		if (const ld::Atom* atom = _indirectBindingTable[slot];
-				atom != nullptr && (atom->definition() == ld::Atom::definitionTentative))
-			if (const auto& nameIt = _byNameReverseTable.find(slot); nameIt != _byNameReverseTable.end())
+				atom != nullptr && (atom->definition() == ld::Atom::definitionTentative)) {
+			if (const auto& nameIt = _byNameReverseTable.find(slot); nameIt != _byNameReverseTable.end()) {
 				tents.push_back(nameIt->second);
+				_tentativeSlots[kept++] = slot;
+			}
+		}
 	}
+	_tentativeSlots.resize(kept);
 	std::sort(tents.begin(), tents.end());
+	// a slot can be recorded twice if it went from tentative to real and back between calls
+	tents.erase(std::unique(tents.begin(), tents.end()), tents.end());
 }
 
 
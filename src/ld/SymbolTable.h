@@ -125,6 +125,8 @@ public:
 	const ld::Atom*		atomForName(const std::string_view& name) const;
 	unsigned int		updateCount()						{ return _indirectBindingTable.size(); }
 	void				undefines(std::vector<std::string_view>& undefines);
+	// like undefines(), but only looks at slots created since the last call to undefines() or newUndefines()
+	void				newUndefines(std::vector<std::string_view>& undefines);
 	void				tentativeDefs(std::vector<std::string_view>& undefines);
 	void				mustPreserveForBitcode(std::unordered_set<const char*>& syms);
 	void				removeDeadAtoms();
@@ -173,6 +175,8 @@ private:
 	ReferencesToSlot				_pointerToCStringTable;
 	std::vector<const ld::Atom*>&	_indirectBindingTable;
 	bool							_hasTentativeDefinitions;
+	size_t							_undefinesScanned		= 0;	// slots below this were already reported by undefines()
+	std::vector<IndirectBindingSlot>	_tentativeSlots;			// slots that were bound to a tentative definition
 	
     DuplicateSymbols                _duplicateSymbolErrors;
     DuplicateSymbols                _duplicateSymbolWarnings;
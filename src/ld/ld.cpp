@@ -69,6 +69,7 @@ extern "C" double log2 ( double );
 #include "Resolver.h"
 #include "OutputFile.h"
 #include "Snapshot.h"
+#include "SuffixStringTable.h"
 
 #include "passes/stubs/make_stubs.h"
 #include "passes/dtrace_dof.h"
@@ -87,6 +88,7 @@ extern "C" double log2 ( double );
 #include "passes/bitcode_bundle.h"
 #include "passes/code_dedup.h"
 #include "passes/objc_stubs.h"
+#include "passes/references.h"
 
 #include "parsers/archive_file.h"
 #include "parsers/macho_relocatable_file.h"
@@ -122,8 +124,11 @@ public:
 	void									setSectionSizesAndAlignments();
 	void									sortSections();
 	void									markAtomsOrdered() { _atomsOrderedInSections = true; }
+	void									tailMergeCStrings();
 
 	virtual									~InternalState() {}
+
+	uint64_t								tailMergedCStringBytes = 0;
 private:
 	bool									inMoveRWChain(const ld::Atom& atom, const char* filePath, bool followedBackBranch, const char*& dstSeg, bool& wildCardMatch);
 	bool									inMoveROChain(const ld::Atom& atom, const char* filePath, const char*& dstSeg, bool& wildCardMatch);
@@ -158,19 +163,15 @@ private:
 	uint64_t pageAlign(uint64_t addr);
 	uint64_t pageAlign(uint64_t addr, uint64_t pageSize);
 	
-	struct SectionHash {
-		size_t operator()(const ld::Section*) const;
-	};
-	struct SectionEquals {
-		bool operator()(const ld::Section* left, const ld::Section* right) const;
-	};
-	typedef std::unordered_map<const ld::Section*, FinalSection*, SectionHash, SectionEquals> SectionInToOut;
-	
+	FinalSection*			finalSectionFor(const ld::Section& sect) const;
+	void					mapSection(const ld::Section& sect, FinalSection* finalSect);
 
-	SectionInToOut			_sectionInToFinalMap;
+	std::vector<FinalSection*>	_sectionIdToFinal;			// ld::Section::id() -> FinalSection, or NULL
+	uint32_t					_sectionIdsMapped = 0;
 	const Options&			_options;
 	bool					_atomsOrderedInSections;
 	std::unordered_map<const ld::Atom*, const char*> _pendingSegMove;
+	std::unordered_map<const ld::Atom*, std::pair<const ld::Atom*, uint64_t>> _tailMergedCStrings;	// atom -> (container, offset in container)
 };
 
 ld::Section	InternalState::FinalSection::_s_DATA_data( "__DATA", "__data",  ld::Section::typeUnclassified);
@@ -186,18 +187,20 @@ ld::Section	InternalState::FinalSection::_s_DATA_CONST_const( "__DATA_CONST", "_
 std::vector<const char*> InternalState::FinalSection::_s_segmentsSeen;
 
 
-size_t InternalState::SectionHash::operator()(const ld::Section* sect) const
+InternalState::FinalSection* InternalState::finalSectionFor(const ld::Section& sect) const
 {
-	size_t hash = 0;
-	ld::container_details::CStringHash temp;
-	hash += temp.operator()(sect->segmentName());
-	hash += temp.operator()(sect->sectionName());
-	return hash;
+	if ( sect.id() < _sectionIdToFinal.size() )
+		return _sectionIdToFinal[sect.id()];
+	return NULL;
 }
 
-bool InternalState::SectionEquals::operator()(const ld::Section* left, const ld::Section* right) const
+void InternalState::mapSection(const ld::Section& sect, FinalSection* finalSect)
 {
-	return (*left == *right);
+	if ( sect.id() >= _sectionIdToFinal.size() )
+		_sectionIdToFinal.resize(sect.id()+1, NULL);
+	if ( _sectionIdToFinal[sect.id()] == NULL )
+		++_sectionIdsMapped;
+	_sectionIdToFinal[sect.id()] = finalSect;
 }
 
 
@@ -923,10 +926,8 @@ ld::Internal::FinalSection* InternalState::getFinalSection(const ld::Section& in
 	const ld::Section* baseForFinalSection = &inputSection;
 	
 	// see if input section already has a FinalSection
-	SectionInToOut::iterator pos = _sectionInToFinalMap.find(&inputSection);
-	if ( pos != _sectionInToFinalMap.end() ) {
-		return pos->second;
-	}
+	if ( FinalSection* fs = finalSectionFor(inputSection) )
+		return fs;
 
 	// otherwise, create a new final section
 	switch ( _options.outputKind() ) {
@@ -942,20 +943,17 @@ ld::Internal::FinalSection* InternalState::getFinalSection(const ld::Section& in
 				const ld::Section& outSect = FinalSection::outputSection(inputSection, _options.mergeZeroFill());
 				if ( _options.mergeZeroFill() && (inputSection.type() == ld::Section::typeZeroFill) && (strcmp(inputSection.segmentName(), "__DATA") != 0) ) {
 					// have custom segment with zero-fill, so need custom section, see if we already have one
-					for (const auto& entry : _sectionInToFinalMap) {
-						ld::Internal::FinalSection* anOut = entry.second;
-						if ( (strcmp(anOut->segmentName(), inputSection.segmentName()) == 0) && (strcmp(anOut->sectionName(), "__zerofill") == 0) )
-							return anOut;
-					}
+					uint32_t zeroFillId = ld::internSectionName(inputSection.segmentName(), "__zerofill", false);
+					if ( (zeroFillId < _sectionIdToFinal.size()) && (_sectionIdToFinal[zeroFillId] != NULL) )
+						return _sectionIdToFinal[zeroFillId];
 					// need to create custom section
 					baseForFinalSection = new ld::Section(inputSection.segmentName(), "__zerofill", ld::Section::typeZeroFill);
 					break;
 				}
-				pos = _sectionInToFinalMap.find(&outSect);
-				if ( pos != _sectionInToFinalMap.end() ) {
-					_sectionInToFinalMap[&inputSection] = pos->second;
-					//fprintf(stderr, "_sectionInToFinalMap[%p] = %p\n", &inputSection, pos->second);
-					return pos->second;
+				if ( FinalSection* fs = finalSectionFor(outSect) ) {
+					mapSection(inputSection, fs);
+					//fprintf(stderr, "_sectionIdToFinal[%u] = %p\n", inputSection.id(), fs);
+					return fs;
 				}
 				else if ( outSect != inputSection ) {
 					// new output section created, but not in map
@@ -965,19 +963,18 @@ ld::Internal::FinalSection* InternalState::getFinalSection(const ld::Section& in
 			break;
 		case Options::kObjectFile:
 			baseForFinalSection = &FinalSection::objectOutputSection(inputSection, _options);
-			pos = _sectionInToFinalMap.find(baseForFinalSection);
-			if ( pos != _sectionInToFinalMap.end() ) {
-				_sectionInToFinalMap[&inputSection] = pos->second;
-				//fprintf(stderr, "_sectionInToFinalMap[%p] = %p\n", &inputSection, pos->second);
-				return pos->second;
+			if ( FinalSection* fs = finalSectionFor(*baseForFinalSection) ) {
+				mapSection(inputSection, fs);
+				//fprintf(stderr, "_sectionIdToFinal[%u] = %p\n", inputSection.id(), fs);
+				return fs;
 			}
 			break;
 	}
 
 	InternalState::FinalSection* result = new InternalState::FinalSection(*baseForFinalSection, 
-																	_sectionInToFinalMap.size(), _options);
-	_sectionInToFinalMap[baseForFinalSection] = result;
-	//fprintf(stderr, "_sectionInToFinalMap[%p(%s)] = %p\n", baseForFinalSection, baseForFinalSection->sectionName(), result);
+																	_sectionIdsMapped, _options);
+	mapSection(*baseForFinalSection, result);
+	//fprintf(stderr, "_sectionIdToFinal[%u(%s)] = %p\n", baseForFinalSection->id(), baseForFinalSection->sectionName(), result);
 	sections.push_back(result);
 	return result;
 }
@@ -1037,6 +1034,67 @@ uint64_t InternalState::pageAlign(uint64_t addr, uint64_t pageSize)
 	return ((addr+pageSize-1) & (-pageSize)); 
 }
 
+//
+// With -tail_merge_strings, a C string that is the tail of another string in the
+// same section is not laid out on its own but placed inside the longer string.
+// Runs as its own step after the order pass and before any layout, and moves each
+// merged string right after the string that holds it.  setSectionSizesAndAlignments()
+// then only places the merged strings at their offset in the container.
+//
+void InternalState::tailMergeCStrings()
+{
+	if ( _options.outputKind() == Options::kObjectFile )
+		return;
+	for (ld::Internal::FinalSection* sect : sections) {
+		bool isCStringSection = (sect->type() == ld::Section::typeCString);
+		if ( (sect->type() == ld::Section::typeNonStdCString) && (strcmp(sect->sectionName(), "__objc_methname") == 0) )
+			isCStringSection = true;
+		if ( !isCStringSection )
+			continue;
+		ld::SuffixStringTable table;
+		std::vector<const ld::Atom*> candidates;
+		for (const ld::Atom* atom : sect->atoms) {
+			if ( (atom->contentType() != ld::Atom::typeCString) || (atom->alignment().powerOf2 != 0) )
+				continue;
+			if ( (atom->size() == 0) || (atom->rawContentPointer() == NULL) )
+				continue;
+			table.add((const char*)atom->rawContentPointer(), atom->size()-1);
+			candidates.push_back(atom);
+		}
+		if ( candidates.size() < 2 )
+			continue;
+		table.finalize();
+		std::unordered_map<const ld::Atom*, std::vector<const ld::Atom*>> children;
+		for (size_t i=0; i < candidates.size(); ++i) {
+			size_t container = table.container(i);
+			if ( container == i )
+				continue;
+			const ld::Atom* atom = candidates[i];
+			_tailMergedCStrings[atom] = std::make_pair(candidates[container], table.offset(i) - table.offset(container));
+			children[candidates[container]].push_back(atom);
+			tailMergedCStringBytes += atom->size();
+		}
+		if ( children.empty() )
+			continue;
+		// keep the section in address order: merged strings follow their container
+		std::vector<const ld::Atom*> atoms;
+		atoms.reserve(sect->atoms.size());
+		for (const ld::Atom* atom : sect->atoms) {
+			if ( _tailMergedCStrings.count(atom) )
+				continue;
+			atoms.push_back(atom);
+			auto pos = children.find(atom);
+			if ( pos == children.end() )
+				continue;
+			std::stable_sort(pos->second.begin(), pos->second.end(), [&](const ld::Atom* left, const ld::Atom* right) {
+				return (_tailMergedCStrings[left].second < _tailMergedCStrings[right].second);
+			});
+			atoms.insert(atoms.end(), pos->second.begin(), pos->second.end());
+		}
+		sect->atoms.swap(atoms);
+	}
+}
+
 void InternalState::setSectionSizesAndAlignments()
 {
 	for (std::vector<ld::Internal::FinalSection*>::iterator sit = sections.begin(); sit != sections.end(); ++sit) {
@@ -1091,8 +1149,8 @@ void InternalState::setSectionSizesAndAlignments()
 					else
 						offset += requiredModulus+alignment-currentModulus;
 				}
-				// LINKEDIT atoms are laid out later
-				if ( sect->type() != ld::Section::typeLinkEdit ) {
+				// LINKEDIT atoms are laid out later, tail merged strings are placed in their container below
+				if ( (sect->type() != ld::Section::typeLinkEdit) && (_tailMergedCStrings.count(atom) == 0) ) {
 					(const_cast<ld::Atom*>(atom))->setSectionOffset(offset);
 					offset += atom->size();
 					if ( pagePerAtom ) {
@@ -1122,6 +1180,13 @@ void InternalState::setSectionSizesAndAlignments()
 				}
 			}
 			sect->size = offset;
+			if ( !_tailMergedCStrings.empty() ) {
+				for (const ld::Atom* atom : sect->atoms) {
+					auto pos = _tailMergedCStrings.find(atom);
+					if ( pos != _tailMergedCStrings.end() )
+						(const_cast<ld::Atom*>(atom))->setSectionOffset(pos->second.first->sectionOffset() + pos->second.second);
+				}
+			}
 			// section alignment is that of a contained atom with the greatest alignment
 			sect->alignment = maxAlignment;
 			// unless -sectalign command line option overrides
@@ -1483,6 +1548,17 @@ static void getVMInfo(vm_statistics_data_t& info)
 }
 
 
+// called at each phase and pass boundary, for -print_statistics and -memory_budget
+static void memoryCheckpoint(const Options& options, const char* label)
+{
+	ld::tool::MemoryUsage& usage = options.memoryUsage();
+	if ( options.printStatistics() )
+		usage.sample(label);
+	if ( usage.overBudget(label) )
+		usage.releaseInputPages();
+}
+
+
 
 
 int main(int argc, const char* argv[])
@@ -1504,10 +1580,13 @@ int main(int argc, const char* argv[])
 		// allow libLTO to be overridden by command line -lto_library
 		if (const char *dylib = options.overridePathlibLTO())
 			lto::set_library(dylib);
+		if ( options.concurrentParseLTO() )
+			lto::set_concurrent_parse(true);
 		
 		// gather vm stats
 		if ( options.printStatistics() )
 			getVMInfo(statistics.vmStart);
+		memoryCheckpoint(options, "option parsing");
 
 		// update strings for error messages
 		showArch = options.printArchPrefix();
@@ -1516,11 +1595,13 @@ int main(int argc, const char* argv[])
 		// open and parse input files
 		statistics.startInputFileProcessing = mach_absolute_time();
 		ld::tool::InputFiles& inputFiles = *(new ld::tool::InputFiles(options));
+		memoryCheckpoint(options, "object file processing");
 		
 		// load and resolve all references
 		statistics.startResolver = mach_absolute_time();
 		ld::tool::Resolver& resolver = *(new ld::tool::Resolver(options, inputFiles, state));
 		resolver.resolve();
+		memoryCheckpoint(options, "resolve symbols");
         
 		// add dylibs used
 		statistics.startDylibs = mach_absolute_time();
@@ -1528,30 +1609,53 @@ int main(int argc, const char* argv[])
 	
 		// do initial section sorting so passes have rough idea of the layout
 		state.sortSections();
+		memoryCheckpoint(options, "build atom list");
 
 		// run passes
 		statistics.startPasses = mach_absolute_time();
 		ld::passes::objc_stubs::doPass(options, state);
+		memoryCheckpoint(options, "objc_stubs pass");
 		ld::passes::objc::doPass(options, state);
+		memoryCheckpoint(options, "objc pass");
+		ld::passes::references::doPass(options, state);	// must be after objc, lists are used by stubs, GOT and TLV passes
+		memoryCheckpoint(options, "references pass");
 		ld::passes::stubs::doPass(options, state);
+		memoryCheckpoint(options, "stubs pass");
 		ld::passes::inits::doPass(options, state);
+		memoryCheckpoint(options, "inits pass");
 		ld::passes::huge::doPass(options, state);
+		memoryCheckpoint(options, "huge pass");
 		ld::passes::got::doPass(options, state);
+		memoryCheckpoint(options, "got pass");
 		//ld::passes::objc_constants::doPass(options, state);
 		ld::passes::tlvp::doPass(options, state);
+		memoryCheckpoint(options, "tlvp pass");
 		ld::passes::dylibs::doPass(options, state);	// must be after stubs and GOT passes
+		memoryCheckpoint(options, "dylibs pass");
 		ld::passes::dedup::doPass(options, state);
+		memoryCheckpoint(options, "dedup pass");
 		ld::passes::order::doPass(options, state); // must run after code dedup, so that deduplicated aliases are sorted
+		memoryCheckpoint(options, "order pass");
 		state.markAtomsOrdered();
+		if ( options.tailMergeStrings() ) {
+			state.tailMergeCStrings();	// must be after order pass, and before branch_island which lays out sections
+			memoryCheckpoint(options, "tail merge strings");
+		}
 		ld::passes::branch_shim::doPass(options, state);	// must be after stubs
+		memoryCheckpoint(options, "branch_shim pass");
 		ld::passes::branch_island::doPass(options, state);	// must be after stubs and order pass
+		memoryCheckpoint(options, "branch_island pass");
 		ld::passes::dtrace::doPass(options, state);
+		memoryCheckpoint(options, "dtrace pass");
 		ld::passes::compact_unwind::doPass(options, state);  // must be after order pass
+		memoryCheckpoint(options, "compact_unwind pass");
 		ld::passes::bitcode_bundle::doPass(options, state);  // must be after dylib
+		memoryCheckpoint(options, "bitcode_bundle pass");
 
 		// Sort again so that we get the segments in order.
 		state.sortSections();
 		ld::passes::thread_starts::doPass(options, state);  // must be after dylib
+		memoryCheckpoint(options, "thread_starts pass");
 		
 		// sort final sections
 		state.sortSections();
@@ -1563,6 +1667,7 @@ int main(int argc, const char* argv[])
 		ld::tool::OutputFile& out = *(new ld::tool::OutputFile(options, state));
 		out.write(state);
 		statistics.startDone = mach_absolute_time();
+		memoryCheckpoint(options, "write output");
 
 		// print statistics
 		//mach_o::relocatable::printCounts();
@@ -1581,11 +1686,66 @@ int main(int argc, const char* argv[])
 								statistics.vmEnd.pageouts-statistics.vmStart.pageouts, 
 								statistics.vmEnd.faults-statistics.vmStart.faults);
 			fprintf(stderr, "memory active: %lu, wired: %lu\n", statistics.vmEnd.active_count * vm_page_size, statistics.vmEnd.wire_count * vm_page_size);
+			// atoms are many subclasses, so only their ld::Atom part is counted
+			uint64_t atomCount = 0;
+			uint64_t fixupCount = 0;
+			uint64_t linkEditSections = 0;
+			uint64_t linkEditSize = 0;
+			for (const ld::Internal::FinalSection* sect : state.sections) {
+				atomCount += sect->atoms.size();
+				for (const ld::Atom* atom : sect->atoms)
+					fixupCount += (atom->fixupsEnd() - atom->fixupsBegin());
+				if ( strcmp(sect->segmentName(), "__LINKEDIT") == 0 ) {
+					++linkEditSections;
+					linkEditSize += sect->size;
+				}
+			}
+			ld::tool::MemoryUsage& memoryUsage = options.memoryUsage();
+			memoryUsage.noteStructure("atoms (ld::Atom part)", atomCount, atomCount * sizeof(ld::Atom));
+			memoryUsage.noteStructure("fixups", fixupCount, fixupCount * sizeof(ld::Fixup));
+			memoryUsage.noteStructure("symbol table slots", state.indirectBindingTable.size(), state.indirectBindingTable.capacity() * sizeof(const ld::Atom*));
+			memoryUsage.noteStructure("LINKEDIT content", linkEditSections, linkEditSize);
+			memoryUsage.noteStructure("output buffer", 1, out.fileSize());
+			memoryUsage.printStatistics();
 			char temp[40];
+			char temp2[40];
 			fprintf(stderr, "processed %3u object files,  totaling %15s bytes\n", inputFiles._totalObjectLoaded, commatize(inputFiles._totalObjectSize, temp));
 			fprintf(stderr, "processed %3u archive files, totaling %15s bytes\n", inputFiles._totalArchivesLoaded, commatize(inputFiles._totalArchiveSize, temp));
 			fprintf(stderr, "processed %3u dylib files\n", inputFiles._totalDylibsLoaded);
 			fprintf(stderr, "wrote output file            totaling %15s bytes\n", commatize(out.fileSize(), temp));
+			if ( options.tailMergeStrings() ) {
+				fprintf(stderr, "tail merged cstrings saved            %15s bytes\n", commatize(state.tailMergedCStringBytes, temp));
+				fprintf(stderr, "tail merged symbol names saved        %15s bytes\n", commatize(out.tailMergedStringBytes(), temp));
+			}
+			uint64_t fdeCount;
+			uint64_t fdeMemoHits;
+			mach_o::relocatable::compactUnwindMemoCounts(fdeCount, fdeMemoHits);
+			if ( fdeCount != 0 ) {
+				fprintf(stderr, "converted %s FDEs to compact unwind, %s (%llu%%) reused an earlier conversion\n",
+						commatize(fdeCount, temp), commatize(fdeMemoHits, temp2), (fdeMemoHits*100)/fdeCount);
+			}
+		}
+		if ( options.printSymbolMoveHits() )
+			options.printSymbolMoveHitCounts();
+		if ( options.traceInputPaging() )
+			inputFiles.mappings().printStatistics();
+		if ( options.traceSearchPathCache() )
+			options.printSearchPathCacheStatistics();
+		if ( options.inputCostReport() )
+			inputFiles.costReport().write(state);
+		// -perf_snapshot and -perf_snapshot_baseline
+		Snapshot& snapshot = options.snapshot();
+		if ( snapshot.recordingTimings() ) {
+			snapshot.recordPhaseTime("option parsing",			statistics.startInputFileProcessing	- statistics.startTool);
+			snapshot.recordPhaseTime("object file processing",	statistics.startResolver			- statistics.startInputFileProcessing);
+			snapshot.recordPhaseTime("resolve symbols",			statistics.startDylibs				- statistics.startResolver);
+			snapshot.recordPhaseTime("build atom list",			statistics.startPasses				- statistics.startDylibs);
+			snapshot.recordPhaseTime("passes",					statistics.startOutput				- statistics.startPasses);
+			snapshot.recordPhaseTime("write output",			statistics.startDone				- statistics.startOutput);
+			snapshot.recordPhaseTime("total",					statistics.startDone				- statistics.startTool);
+			snapshot.writeTimings();
+			if ( options.perfSnapshotBaseline() != NULL )
+				snapshot.compareTimings(options.perfSnapshotBaseline());
 		}
 		// <rdar://problem/6780050> Would like linker warning to be build error.
 		if ( options.errorBecauseOfWarnings() ) {
@@ -35,7 +35,9 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <mutex>
 #include <unordered_set>
+#include <unordered_map>
 
 #include "configure.h"
 #include "PlatformSupport.h"
@@ -471,6 +473,8 @@ public:
 	Ordinal								ordinal() const			{ return _ordinal; }
 	virtual bool						forEachAtom(AtomHandler&) const = 0;
 	virtual bool						justInTimeforEachAtom(const char* name, AtomHandler&) const = 0;
+	// calls handler with every name justInTimeforEachAtom() might find (and maybe more), returns false if not known yet
+	virtual bool						forEachSymbolName(void (^handler)(const char* name)) const { return false; }
 	virtual uint8_t						swiftVersion() const	{ return 0; }		// ABI version, now fixed
 	virtual uint16_t					swiftLanguageVersion() const	{ return 0; }	// language version in 4.4 format
 	virtual uint32_t					cpuSubType() const		{ return 0; }
@@ -655,6 +659,13 @@ namespace archive {
 												: ld::File(pth, modTime, ord, Archive) { }
 		virtual								~File() {}
 		virtual bool						justInTimeDataOnlyforEachAtom(const char* name, AtomHandler&) const = 0;
+		// parses, on worker threads, the members that justInTimeforEachAtom() would load for these names,
+		// so that loading them later is quick.  Members that end up not being loaded are dropped.
+		virtual void						parseMembersAhead(const std::vector<const char*>& names) const { }
+		// frees the members parsed ahead that were never loaded, called once symbol resolution is done
+		virtual void						dropMembersParsedAhead() const { }
+		// calls handler for each member that was loaded, with its size and the mach_absolute_time() spent parsing it
+		virtual void						forEachLoadedMember(void (^handler)(const ld::File& member, uint64_t size, uint64_t parseTime)) const { }
 	};
 } // namespace archive 
 
@@ -662,6 +673,28 @@ namespace archive {
 //
 // ld::Section
 //
+//
+// Every distinct (segment name, section name, hidden) used by any Section is given a small id when the
+// Section is constructed, so the linker can map input sections to output sections by array index.
+// Parsers construct Sections on many threads, so the table is locked.
+//
+inline uint32_t internSectionName(const char* segName, const char* sectName, bool hidden)
+{
+	static std::mutex									sLock;
+	static std::unordered_map<std::string, uint32_t>	sIds;
+	std::string key(segName);
+	key.push_back('\0');
+	key.append(sectName);
+	key.push_back(hidden ? 'h' : '\0');
+	std::lock_guard<std::mutex> guard(sLock);
+	auto pos = sIds.find(key);
+	if ( pos != sIds.end() )
+		return pos->second;
+	uint32_t id = (uint32_t)sIds.size();
+	sIds[key] = id;
+	return id;
+}
+
 class Section
 {
 public:
@@ -679,25 +712,26 @@ public:
 					Section(const char* sgName, const char* sctName,
 								Type t, bool hidden=false)
 								: _segmentName(sgName), _sectionName(sctName),
-								_type(t), _hidden(hidden)  {}
+								_type(t), _hidden(hidden), _id(internSectionName(sgName, sctName, hidden))  {}
 					Section(const Section& sect)
 								: _segmentName(sect.segmentName()), _sectionName(sect.sectionName()),
-								_type(sect.type()), _hidden(sect.isSectionHidden())  {}
+								_type(sect.type()), _hidden(sect.isSectionHidden()), _id(sect.id())  {}
 								
-	bool			operator==(const Section& rhs) const { return ( (_hidden==rhs._hidden) &&
-														(strcmp(_segmentName, rhs._segmentName)==0) &&
-														(strcmp(_sectionName, rhs._sectionName)==0) ); }
+	bool			operator==(const Section& rhs) const { return (_id == rhs._id); }
 	bool			operator!=(const Section& rhs) const { return ! (*this == rhs); }
 	const char*			segmentName() const			{ return _segmentName; }
 	const char*			sectionName() const			{ return _sectionName; }
 	Type				type() const				{ return _type; }
 	bool				isSectionHidden() const		{ return _hidden; }
+	// same id means same segment name, section name, and hiddenness
+	uint32_t			id() const					{ return _id; }
 	
 private:
 	const char*			_segmentName;
 	const char*			_sectionName;
 	Type				_type;
 	bool				_hidden;
+	uint32_t			_id;
 };
 
 
@@ -1423,6 +1457,16 @@ public:
 		bool							hasExternalRelocs;
 	};
 
+	// atoms whose fixups the stubs, GOT and TLV passes may rewrite, found by one scan over all fixups
+	struct ReferenceLists {
+		bool							valid = false;
+		uint64_t						totalAtomSize = 0;
+		std::vector<const Atom*>		stubReferencers;
+		std::vector<const Atom*>		gotReferencers;
+		std::vector<const Atom*>		tlvReferencers;
+		std::vector<const Atom*>		resolvers;
+	};
+
 	virtual uint64_t					assignFileOffsets() = 0;
 	virtual void						setSectionSizesAndAlignments() = 0;
 	virtual ld::Internal::FinalSection*	addAtom(const Atom&) = 0;
@@ -1464,6 +1508,7 @@ public:
 	std::vector<const ld::relocatable::File*>	filesFromCompilerRT;
 	std::vector<const ld::relocatable::File*>	filesForLTO;
 	std::vector<const ld::Atom*>				deadAtoms;
+	ReferenceLists								referenceLists;
 	std::unordered_set<const char*>				allUndefProxies;
 	std::unordered_set<uint64_t>				toolsVersions;
 	const ld::dylib::File*						bundleLoader;
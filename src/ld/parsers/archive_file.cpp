@@ -28,8 +28,13 @@
 #include <sys/param.h>
 #include <mach-o/ranlib.h>
 #include <ar.h>
+#include <dispatch/dispatch.h>
+#include <mach/mach_time.h>
 
 #include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "MachOFileAbstraction.hpp"
 #include "Architectures.hpp"
@@ -39,6 +44,9 @@
 #include "archive_file.h"
 #include "Containers.h"
 
+extern void warning(const char* format, ...) __attribute__((format(printf, 1, 2)));
+extern void deferWarnings(std::vector<std::string>* warnings);
+
 namespace archive {
 
 
@@ -78,10 +86,14 @@ public:
 	// overrides of ld::File
 	virtual bool										forEachAtom(ld::File::AtomHandler&) const;
 	virtual bool										justInTimeforEachAtom(const char* name, ld::File::AtomHandler&) const;
+	virtual bool										forEachSymbolName(void (^handler)(const char* name)) const;
 	virtual uint32_t									subFileCount() const  { return _archiveFilelength/sizeof(ar_hdr); }
 	
 	// overrides of ld::archive::File
 	virtual bool										justInTimeDataOnlyforEachAtom(const char* name, ld::File::AtomHandler& handler) const;
+	virtual void										parseMembersAhead(const std::vector<const char*>& names) const;
+	virtual void										dropMembersParsedAhead() const;
+	virtual void										forEachLoadedMember(void (^handler)(const ld::File& member, uint64_t size, uint64_t parseTime)) const;
 
 private:
 	friend bool isArchiveFile(const uint8_t* fileContent, uint64_t fileLength, ld::Platform* platform, const char** archiveArchName);
@@ -106,7 +118,7 @@ private:
 
 	};
 
-	struct MemberState { ld::relocatable::File* file; const Entry *entry; bool logged; bool loaded; uint32_t index;};
+	struct MemberState { ld::relocatable::File* file; const Entry *entry; bool logged; bool loaded; uint32_t index; uint64_t parseTime; };
 	bool											loadMember(MemberState& state, ld::File::AtomHandler& handler, const char *format, ...) const;
 
 	using NameToOffsetMap = ld::StringViewMap<uint64_t>;
@@ -116,7 +128,14 @@ private:
 
 	typedef std::map<const class Entry*, MemberState> MemberToStateMap;
 
+	// a member parsed by parseMembersAhead() that has not been loaded yet
+	struct ParsedAhead { ld::relocatable::File* file; std::vector<std::string> warnings; uint64_t parseTime; };
+	typedef std::unordered_map<const class Entry*, ParsedAhead> MemberToParsedAheadMap;
+
+	MemberState*									memberState(const Entry* member) const;
 	MemberState&									makeObjectFileForMember(const Entry* member) const;
+	std::string										memberPath(const Entry* member) const;
+	ld::relocatable::File*							parseMember(const Entry* member, uint32_t memberIndex, bool allowBitcode) const;
 	bool											memberHasObjCCategories(const Entry* member) const;
 	void											dumpTableOfContents();
 	void											buildHashTable();
@@ -132,11 +151,13 @@ private:
 	uint32_t										_tableOfContentCount;
 	const char*										_tableOfContentStrings;
 	mutable MemberToStateMap						_instantiatedEntries;
+	mutable MemberToParsedAheadMap					_parsedAhead;
 	NameToOffsetMap									_hashTable;
 	const LibraryOptions::ArchiveLoadMode			_loadMode;
 	const bool										_objc2ABI;
 	const bool										_verboseLoad;
 	const bool										_logAllFiles;
+	const bool										_timeMembers;
 	mutable bool									_alreadyLoadedAll;
 	const mach_o::relocatable::ParserOptions		_objOpts;
 };
@@ -289,7 +310,7 @@ File<A>::File(const uint8_t fileContent[], uint64_t fileLength, const char* pth,
 #endif
 	_tableOfContentCount(0), _tableOfContentStrings(NULL),
 	_loadMode(opts.loadMode), _objc2ABI(opts.objcABI2), _verboseLoad(opts.verboseLoad), 
-	_logAllFiles(opts.logAllFiles), _alreadyLoadedAll(false), _objOpts(opts.objOpts)
+	_logAllFiles(opts.logAllFiles), _timeMembers(opts.timeMembers), _alreadyLoadedAll(false), _objOpts(opts.objOpts)
 {
 	if ( strncmp((const char*)fileContent, "!<arch>\n", 8) != 0 )
 		throw "not an archive";
@@ -371,80 +392,111 @@ bool File<A>::memberHasObjCCategories(const Entry* member) const
 
 
 template <typename A>
-typename File<A>::MemberState& File<A>::makeObjectFileForMember(const Entry* member) const
+typename File<A>::MemberState* File<A>::memberState(const Entry* member) const
 {
-	uint32_t memberIndex = 0;
 	// in case member was instantiated earlier but not needed yet
 	typename MemberToStateMap::iterator pos = _instantiatedEntries.find(member);
-	if ( pos == _instantiatedEntries.end() ) {
-		// Have to find the index of this member
-		const Entry* start;
-		uint32_t index;
-		if (_instantiatedEntries.size() == 0) {
-			start = (Entry*)&_archiveFileContent[8];
-			index = 1;
-		} else {
-			MemberState &lastKnown = _instantiatedEntries.rbegin()->second;
-			start = lastKnown.entry->next();
-			index = lastKnown.index+1;
-		}
-		for (const Entry* p=start; p <= member; p = p->next(), index++) {
-			MemberState state = {NULL, p, false, false, index};
-			_instantiatedEntries[p] = state;
-			if (member == p) {
-				memberIndex = index;
-			}
-		}
+	if ( pos != _instantiatedEntries.end() )
+		return &pos->second;
+
+	// Have to find the index of this member
+	const Entry* start;
+	uint32_t index;
+	if (_instantiatedEntries.size() == 0) {
+		start = (Entry*)&_archiveFileContent[8];
+		index = 1;
 	} else {
-		MemberState& state = pos->second;
-		if (state.file)
-			return state;
-		memberIndex = state.index;
+		MemberState &lastKnown = _instantiatedEntries.rbegin()->second;
+		start = lastKnown.entry->next();
+		index = lastKnown.index+1;
 	}
-	assert(memberIndex != 0);
-	char memberName[256];
-	member->getName(memberName, sizeof(memberName));
-	char memberPath[strlen(this->path()) + strlen(memberName)+4];
-	strcpy(memberPath, this->path());
-	strcat(memberPath, "(");
-	strcat(memberPath, memberName);
-	strcat(memberPath, ")");
-	//fprintf(stderr, "using %s from %s\n", memberName, this->path());
+	MemberState* result = NULL;
+	for (const Entry* p=start; p <= member; p = p->next(), index++) {
+		MemberState state = {NULL, p, false, false, index, 0};
+		_instantiatedEntries[p] = state;
+		if (member == p) {
+			result = &_instantiatedEntries[p];
+		}
+	}
+	// NULL if member is not at an entry boundary
+	return result;
+}
+
+
+template <typename A>
+typename File<A>::MemberState& File<A>::makeObjectFileForMember(const Entry* member) const
+{
+	MemberState* existing = this->memberState(member);
+	assert(existing != NULL);
+	if ( existing->file )
+		return *existing;
+	uint32_t memberIndex = existing->index;
+
+	// use the member parsed ahead of time, reporting its warnings now as if it was parsed here
+	typename MemberToParsedAheadMap::iterator ahead = _parsedAhead.find(member);
+	if ( ahead != _parsedAhead.end() ) {
+		for (const std::string& msg : ahead->second.warnings)
+			warning("%s", msg.c_str());
+		existing->file = ahead->second.file;
+		existing->parseTime = ahead->second.parseTime;
+		_parsedAhead.erase(ahead);
+		return *existing;
+	}
+
 	try {
 		// range check
 		if ( member > (Entry*)(_archiveFileContent+_archiveFilelength) )
 			throwf("corrupt archive, member starts past end of file");										
 		if ( (member->content() + member->contentSize()) > (_archiveFileContent+_archiveFilelength) )
 			throwf("corrupt archive, member contents extends past end of file");										
-		const char* mPath = strdup(memberPath);
-		// see if member is mach-o file
-		ld::File::Ordinal ordinal = this->ordinal().archiveOrdinalWithMemberIndex(memberIndex);
-		ld::relocatable::File* result = mach_o::relocatable::parse(member->content(), member->contentSize(), 
-																	mPath, member->modificationTime(), 
-																	ordinal, _objOpts);
-		if ( result != NULL ) {
-			MemberState state = {result, member, false, false, memberIndex};
-			_instantiatedEntries[member] = state;
-			return _instantiatedEntries[member];
-		}
-		// see if member is llvm bitcode file
-		result = lto::parse(member->content(), member->contentSize(), 
-								mPath, member->modificationTime(), ordinal, 
-								_objOpts.architecture, _objOpts.subType, _logAllFiles, _objOpts.verboseOptimizationHints);
+		uint64_t startTime = _timeMembers ? mach_absolute_time() : 0;
+		ld::relocatable::File* result = this->parseMember(member, memberIndex, true);
 		if ( result != NULL ) {
-			MemberState state = {result, member, false, false, memberIndex};
+			MemberState state = {result, member, false, false, memberIndex, _timeMembers ? mach_absolute_time()-startTime : 0};
 			_instantiatedEntries[member] = state;
 			return _instantiatedEntries[member];
 		}
-			
+		char memberName[256];
+		member->getName(memberName, sizeof(memberName));
 		throwf("archive member '%s' with length %d is not mach-o or llvm bitcode", memberName, member->contentSize());
 	}
 	catch (const char* msg) {
-		throwf("in %s, %s", memberPath, msg);
+		throwf("in %s, %s", this->memberPath(member).c_str(), msg);
 	}
 }
 
 
+// path of a member as shown in messages and given to its parsed file: "archive(member)"
+template <typename A>
+std::string File<A>::memberPath(const Entry* member) const
+{
+	char memberName[256];
+	member->getName(memberName, sizeof(memberName));
+	std::string result = this->path();
+	result += "(";
+	result += memberName;
+	result += ")";
+	return result;
+}
+
+
+// parses a member as mach-o, or if allowBitcode as llvm bitcode, returns NULL if it is neither
+template <typename A>
+ld::relocatable::File* File<A>::parseMember(const Entry* member, uint32_t memberIndex, bool allowBitcode) const
+{
+	const char* mPath = strdup(this->memberPath(member).c_str());
+	ld::File::Ordinal ordinal = this->ordinal().archiveOrdinalWithMemberIndex(memberIndex);
+	ld::relocatable::File* result = mach_o::relocatable::parse(member->content(), member->contentSize(), mPath,
+																member->modificationTime(), ordinal, _objOpts);
+	if ( (result == NULL) && allowBitcode ) {
+		result = lto::parse(member->content(), member->contentSize(),
+							mPath, member->modificationTime(), ordinal,
+							_objOpts.architecture, _objOpts.subType, _logAllFiles, _objOpts.verboseOptimizationHints);
+	}
+	return result;
+}
+
+
 template <typename A>
 bool File<A>::loadMember(MemberState& state, ld::File::AtomHandler& handler, const char *format, ...) const
 {
@@ -596,6 +648,90 @@ bool File<A>::justInTimeforEachAtom(const char* name, ld::File::AtomHandler& han
 	return loadMember(state, handler, "%s forced load of %s(%s)\n", name, this->path(), memberName);
 }
 
+template <typename A>
+void File<A>::parseMembersAhead(const std::vector<const char*>& names) const
+{
+	// in force load case, all members already loaded
+	if ( _alreadyLoadedAll )
+		return;
+
+	// members parsed for an earlier round that were not loaded are dropped
+	dropMembersParsedAhead();
+
+	struct Pending { const Entry* member; uint32_t index; ld::relocatable::File* file; std::vector<std::string> warnings; uint64_t parseTime; };
+	__block std::vector<Pending> pending;
+	std::unordered_set<const Entry*> seen;
+	const uint8_t* const end = _archiveFileContent + _archiveFilelength;
+	for (const char* name : names) {
+		const auto& pos = _hashTable.find(name);
+		if ( pos == _hashTable.end() )
+			continue;
+		const Entry* member = (Entry*)&_archiveFileContent[pos->second];
+		if ( !seen.insert(member).second )
+			continue;
+		// corrupt members are left for makeObjectFileForMember() to report
+		if ( ((uint8_t*)member > end) || ((member->content() + member->contentSize()) > end) )
+			continue;
+		// bitcode members register with the LTO code generator as they are parsed, so are never parsed ahead
+		if ( !validMachOFile(member->content(), member->contentSize(), _objOpts) )
+			continue;
+		const MemberState* state = this->memberState(member);
+		if ( (state == NULL) || (state->file != NULL) )
+			continue;
+		pending.push_back({ member, state->index, NULL, {}, 0 });
+	}
+	// the resolver would be waiting on a single member anyway
+	if ( pending.size() < 2 )
+		return;
+
+	dispatch_apply(pending.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
+		Pending& item = pending[index];
+		deferWarnings(&item.warnings);
+		uint64_t startTime = _timeMembers ? mach_absolute_time() : 0;
+		try {
+			item.file = this->parseMember(item.member, item.index, false);
+		}
+		catch (...) {
+			// parsed again if it is loaded, which reports the error then
+			item.file = NULL;
+		}
+		item.parseTime = _timeMembers ? mach_absolute_time() - startTime : 0;
+		deferWarnings(NULL);
+	});
+
+	for (Pending& item : pending) {
+		if ( item.file != NULL )
+			_parsedAhead[item.member] = { item.file, std::move(item.warnings), item.parseTime };
+	}
+}
+
+template <typename A>
+void File<A>::dropMembersParsedAhead() const
+{
+	for (auto& entry : _parsedAhead)
+		delete entry.second.file;
+	_parsedAhead.clear();
+}
+
+template <typename A>
+void File<A>::forEachLoadedMember(void (^handler)(const ld::File& member, uint64_t size, uint64_t parseTime)) const
+{
+	for (const auto& entry : _instantiatedEntries) {
+		const MemberState& state = entry.second;
+		if ( state.loaded && (state.file != NULL) )
+			handler(*state.file, state.entry->contentSize(), state.parseTime);
+	}
+}
+
+template <typename A>
+bool File<A>::forEachSymbolName(void (^handler)(const char* name)) const
+{
+	// table of contents strings are NUL terminated
+	for (const auto& entry : _hashTable)
+		handler(entry.first.data());
+	return true;
+}
+
 class CheckIsDataSymbolHandler : public ld::File::AtomHandler
 {
 public:
@@ -36,6 +36,7 @@ struct ParserOptions {
 	bool								objcABI2;
 	bool								verboseLoad;
 	bool								logAllFiles;
+	bool								timeMembers;		// record member parse times for -input_cost_report
 };
 
 extern ld::archive::File* parse(const uint8_t* fileContent, uint64_t fileLength, 
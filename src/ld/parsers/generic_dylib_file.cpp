@@ -230,6 +230,25 @@ bool File::justInTimeforEachAtom(const char* name, ld::File::AtomHandler& handle
     return false;
 }
 
+bool File::forEachSymbolName(void (^handler)(const char* name)) const
+{
+	// re-exported dylibs are not known until indirect libraries are processed
+	if ( !_indirectDylibsProcessed )
+		return false;
+
+	for (const auto& entry : _atoms)
+		handler(entry.first);
+
+	// names found through containsOrReExports()
+	for (const auto& dep : _dependentDylibs) {
+		if ( dep.reExport ) {
+			if ( (dep.dylib == nullptr) || !dep.dylib->forEachSymbolName(handler) )
+				return false;
+		}
+	}
+	return true;
+}
+
 void File::forEachExportedSymbol(void (^handler)(const char* symbolName, bool weakDef)) const
 {
     for (const auto& entry : _atoms) {
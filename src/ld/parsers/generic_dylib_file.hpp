@@ -107,6 +107,7 @@ public:
 	// overrides of ld::File
 	virtual bool							forEachAtom(ld::File::AtomHandler&) const override final;
 	virtual bool							justInTimeforEachAtom(const char* name, ld::File::AtomHandler&) const override final;
+	virtual bool							forEachSymbolName(void (^handler)(const char* name)) const override final;
 	virtual uint8_t							swiftVersion() const override final { return _swiftVersion; }
 	virtual ld::Bitcode*					getBitcode() const override final { return _bitcode.get(); }
     virtual const ld::VersionSet &          platforms() const override final { return _platforms; }
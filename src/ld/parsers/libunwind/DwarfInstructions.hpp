@@ -35,7 +35,11 @@
 
 #include <algorithm>
 #include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
 #include <unordered_set>
+#include <unordered_map>
 
 #include <libunwind.h>
 #include <mach-o/compact_unwind_encoding.h>
@@ -56,6 +60,42 @@
 
 namespace libunwind {
 
+///
+/// Compact unwind encodings computed from dwarf, keyed on the CIE and FDE instruction bytes.
+/// Most FDEs in C++ code only differ in the address range they cover, so the dwarf
+/// instructions of each distinct prologue only need to be interpreted once.
+/// Shared by all parser threads.
+///
+class CompactEncodingMemo
+{
+public:
+	bool							find(const std::string& key, compact_unwind_encoding_t& encoding) {
+										if ( !enabled() )
+											return false;
+										std::lock_guard<std::mutex> guard(_lock);
+										auto pos = _encodings.find(key);
+										if ( pos == _encodings.end() )
+											return false;
+										encoding = pos->second;
+										return true;
+									}
+	void							add(const std::string& key, compact_unwind_encoding_t encoding) {
+										std::lock_guard<std::mutex> guard(_lock);
+										_encodings.emplace(key, encoding);
+									}
+
+	// LD_NO_COMPACT_UNWIND_MEMO turns the memo off, to check that it changes no encoding
+	static bool						enabled()	{ static const bool result = (getenv("LD_NO_COMPACT_UNWIND_MEMO") == NULL); return result; }
+
+	// counts across all architectures, for -print_statistics
+	static std::atomic<uint64_t>&	lookups()	{ static std::atomic<uint64_t> count(0); return count; }
+	static std::atomic<uint64_t>&	hits()		{ static std::atomic<uint64_t> count(0); return count; }
+
+private:
+	std::mutex												_lock;
+	std::unordered_map<std::string, compact_unwind_encoding_t>	_encodings;
+};
+
 ///
 /// Used by linker when parsing __eh_frame section
 ///  
@@ -111,6 +151,18 @@ public:
 										
 private:
 
+	// one memo per architecture, since the same instructions encode differently on each
+	static CompactEncodingMemo& encodingMemo() { static CompactEncodingMemo memo; return memo; }
+	static void memoKey(A& addressSpace, const typename CFI_Parser<A>::CIE_Info& cieInfo, pint_t fdeInstructions,
+						pint_t fdeEnd, std::string& key);
+	// true if the encoding was derived from the function's instructions, not just its dwarf
+	template <typename REG>
+	static bool encodingUsesFunctionContent(compact_unwind_encoding_t, const REG&) { return false; }
+	static bool encodingUsesFunctionContent(compact_unwind_encoding_t encoding, const Registers_x86&)
+																	{ return ((encoding & UNWIND_X86_MODE_MASK) == UNWIND_X86_MODE_STACK_IND); }
+	static bool encodingUsesFunctionContent(compact_unwind_encoding_t encoding, const Registers_x86_64&)
+																	{ return ((encoding & UNWIND_X86_64_MODE_MASK) == UNWIND_X86_64_MODE_STACK_IND); }
+
 	enum {
 		DW_X86_64_RET_ADDR = 16
 	};
@@ -299,13 +351,28 @@ const char* DwarfInstructions<A,R>::parseCFIs(A& addressSpace, pint_t ehSectionS
 					fdeInfo.lsda = entry->u.fdeInfo.lsda.targetAddress;
 					typename CFI_Parser<A>::PrologInfo prolog;
 					R dummy; // for proper selection of architecture specific functions
-					if ( CFI_Parser<A>::parseFDEInstructions(addressSpace, fdeInfo, cieInfo, CFI_INVALID_ADDRESS, &prolog) ) {
+					std::string key;
+					memoKey(addressSpace, cieInfo, fdeInfo.fdeInstructions, nextCFI, key);
+					compact_unwind_encoding_t encoding;
+					++CompactEncodingMemo::lookups();
+					if ( encodingMemo().find(key, encoding) ) {
+						++CompactEncodingMemo::hits();
+						entry->u.fdeInfo.compactUnwindInfo = encoding;
+						if ( fdeInfo.lsda != CFI_INVALID_ADDRESS ) 
+							entry->u.fdeInfo.compactUnwindInfo |= UNWIND_HAS_LSDA;
+					}
+					else if ( CFI_Parser<A>::parseFDEInstructions(addressSpace, fdeInfo, cieInfo, CFI_INVALID_ADDRESS, &prolog) ) {
 						char warningBuffer[1024];
-						entry->u.fdeInfo.compactUnwindInfo = createCompactEncodingFromProlog(addressSpace, fdeInfo.pcStart, dummy, prolog, warningBuffer);
+						encoding = createCompactEncodingFromProlog(addressSpace, fdeInfo.pcStart, dummy, prolog, warningBuffer);
+						entry->u.fdeInfo.compactUnwindInfo = encoding;
 						if ( fdeInfo.lsda != CFI_INVALID_ADDRESS ) 
 							entry->u.fdeInfo.compactUnwindInfo |= UNWIND_HAS_LSDA;
 						if ( warningBuffer[0] != '\0' )
 							warn(ref, fdeInfo.pcStart, warningBuffer);
+						// only remember encodings that other functions with the same dwarf would get too,
+						// and let functions that fall back to dwarf each produce their own warning
+						else if ( (encoding != encodeToUseDwarf(dummy)) && !encodingUsesFunctionContent(encoding, dummy) )
+							encodingMemo().add(key, encoding);
 					}
 					else {
 						warn(ref, CFI_INVALID_ADDRESS, "dwarf unwind instructions could not be parsed");
@@ -326,6 +393,25 @@ const char* DwarfInstructions<A,R>::parseCFIs(A& addressSpace, pint_t ehSectionS
 }
 
 
+template <typename A, typename R>
+void DwarfInstructions<A,R>::memoKey(A& addressSpace, const typename CFI_Parser<A>::CIE_Info& cieInfo, pint_t fdeInstructions,
+									pint_t fdeEnd, std::string& key)
+{
+	// the CIE fields the instructions are interpreted with
+	key.append((char*)&cieInfo.codeAlignFactor, sizeof(cieInfo.codeAlignFactor));
+	key.append((char*)&cieInfo.dataAlignFactor, sizeof(cieInfo.dataAlignFactor));
+	key.push_back(cieInfo.pointerEncoding);
+	// CIE initial instructions, then FDE instructions
+	const pint_t cieEnd = cieInfo.cieStart + cieInfo.cieLength;
+	uint32_t cieInstructionsLength = (uint32_t)(cieEnd - cieInfo.cieInstructions);
+	key.append((char*)&cieInstructionsLength, sizeof(cieInstructionsLength));
+	for (pint_t p=cieInfo.cieInstructions; p < cieEnd; ++p)
+		key.push_back(addressSpace.get8(p));
+	for (pint_t p=fdeInstructions; p < fdeEnd; ++p)
+		key.push_back(addressSpace.get8(p));
+}
+
+
 
 
 template <typename A, typename R>
@@ -32,9 +32,11 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <pthread.h>
+#include <dispatch/dispatch.h>
 #include <mach-o/dyld.h>
 #include <dlfcn.h>
 #include <atomic>
+#include <mutex>
 #include <algorithm>
 #include <vector>
 #include <map>
@@ -76,10 +78,10 @@ public:
 	ld::Fixup::iterator					fixupsBegin() const override	{ return _undefs.data(); }
 	ld::Fixup::iterator					fixupsEnd()	const override 	{ return _undefs.data() + _undefs.size(); }
 
-	// for adding references to symbols outside bitcode file
+	// for adding references to symbols outside bitcode file, name must outlive the atom
 	void										addReference(const char* nm)
 																	{ _undefs.push_back(ld::Fixup(0, ld::Fixup::k1of1, 
-																				ld::Fixup::kindNone, false, strdup(nm))); }
+																				ld::Fixup::kindNone, false, nm)); }
 private:
 
 	ld::File&									_file;
@@ -117,6 +119,7 @@ public:
 	void												setIsThinLTO(bool ThinLTO) 	{ _isThinLTO = ThinLTO; }
 	// fixme rdar://24734472 objCConstraint() and objcHasCategoryClassProperties()
 	void												release();
+	void												makeAtoms();
 	lto_module_t										module()					{ return _module; }
 	class InternalAtom&									internalAtom()				{ return _internalAtom; }
 	void												setDebugInfo(ld::relocatable::File::DebugInfoKind k,
@@ -141,9 +144,24 @@ private:
 
 	bool									_isThinLTO;
 	cpu_type_t								_architecture;
+	// Symbols are only recorded while parsing, in this compact form, and the Atoms for
+	// them are made when the resolver loads the file.  Names point into _symbolNames.
+	// Internal definitions are recorded too, for forEachLtoSymbol(), but get no Atom.
+	struct SymbolInfo {
+		uint32_t							nameOffset;
+		uint8_t								definition;		// ld::Atom::Definition
+		uint8_t								combine;		// ld::Atom::Combine
+		uint8_t								scope;			// ld::Atom::Scope
+		uint8_t								alignment;
+		bool								autoHide;
+	};
+
 	class InternalAtom						_internalAtom;
 	class Atom*								_atomArray;
 	uint32_t								_atomArrayCount;
+	std::vector<char>						_symbolNames;
+	std::vector<SymbolInfo>					_symbols;
+	std::once_flag							_atomsMade;
 	lto_module_t							_module;
 	const char*                             _path;
 	const uint8_t*                          _content;
@@ -312,13 +330,60 @@ private:
 #endif
 
 	static std::vector<File*>		_s_files;
+	static pthread_mutex_t			_s_filesLock;
 	static bool						_s_llvmOptionsProcessed;
 };
 
 std::vector<File*> Parser::_s_files;
+pthread_mutex_t Parser::_s_filesLock = PTHREAD_MUTEX_INITIALIZER;
 bool Parser::_s_llvmOptionsProcessed = false;
 
 
+// lto_lock is held exclusively for every use of libLTO, except concurrent bitcode parses which
+// share it.  So a parse that holds it exclusively sees no other libLTO call until it is done.
+static pthread_rwlock_t lto_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+class Mutex {
+public:
+	Mutex() { pthread_rwlock_wrlock(&lto_lock); }
+	~Mutex() { pthread_rwlock_unlock(&lto_lock); }
+};
+
+class SharedMutex {
+public:
+	SharedMutex() { pthread_rwlock_rdlock(&lto_lock); }
+	~SharedMutex() { pthread_rwlock_unlock(&lto_lock); }
+};
+bool File::sSupportsLocalContext = false;
+bool File::sHasTriedLocalContext = false;
+
+//
+// lto.h documents lto_module_create_in_local_context() as thread safe since it was added in
+// LTO_API_VERSION 11: each module gets its own LLVMContext.  But libLTO initializes its targets
+// on the first module it creates without any lock, and keeps the last error message in a global
+// that a failing parse writes.  So parsing bitcode on all input file worker threads at once is
+// opt-in (-concurrent_parse_lto), and only starts once a first module was created under lto_lock.
+// Concurrent parses share lto_lock, and a file that fails is parsed again holding it exclusively,
+// so the error message reported is the one for that file.
+//
+#define LTO_API_VERSION_THREAD_SAFE_LOCAL_CONTEXT	11
+
+static bool					sConcurrentParseRequested = false;
+static std::atomic<bool>	sLibLTOInitialized(false);
+
+static bool parseConcurrently()
+{
+#if LTO_API_VERSION >= 11
+	if ( !sConcurrentParseRequested || !sLibLTOInitialized.load(std::memory_order_acquire) )
+		return false;
+	// sSupportsLocalContext was set under lto_lock by the first parse, before sLibLTOInitialized
+	return File::sSupportsLocalContext && (::lto_api_version() >= LTO_API_VERSION_THREAD_SAFE_LOCAL_CONTEXT);
+#else
+	return false;
+#endif
+}
+
+
 bool Parser::validFile(const uint8_t* fileContent, uint64_t fileLength, cpu_type_t architecture, cpu_subtype_t subarch)
 {
 	for (const ArchInfo* t=archInfoArray; t->archName != NULL; ++t) {
@@ -355,7 +420,10 @@ File* Parser::parse(const uint8_t* fileContent, uint64_t fileLength, const char*
 													cpu_type_t architecture, cpu_subtype_t subarch, bool logAllFiles, bool verboseOptimizationHints) 
 {
 	File* f = new File(path, modTime, ordinal, fileContent, fileLength, architecture);
+	// files are sorted into command line order before optimizing, so append order does not matter
+	pthread_mutex_lock(&_s_filesLock);
 	_s_files.push_back(f);
+	pthread_mutex_unlock(&_s_filesLock);
 	if ( logAllFiles ) 
 		printf("%s\n", path);
 	return f;
@@ -431,6 +499,9 @@ File::File(const char* pth, time_t mTime, ld::File::Ordinal ordinal, const uint8
 	if ( _module == NULL && !sSupportsLocalContext )
 #endif
 	_module = ::lto_module_create_from_memory(content, contentLength);
+	// libLTO has set itself up now, unless this parse is already running concurrently
+	if ( !sLibLTOInitialized.load(std::memory_order_relaxed) )
+		sLibLTOInitialized.store(true, std::memory_order_release);
     if ( _module == NULL )
 		throwf("could not parse object file %s: '%s', using libLTO version '%s'", pth, ::lto_get_error_message(), ::lto_get_version());
 
@@ -440,9 +511,13 @@ File::File(const char* pth, time_t mTime, ld::File::Ordinal ordinal, const uint8
 	_isThinLTO = ::lto_module_is_thinlto(_module);
 #endif
 
-	// create atom for each global symbol in module
+	// record each global symbol in module, atoms are made by makeAtoms()
 	uint32_t count = ::lto_module_get_num_symbols(_module);
-	_atomArray = (Atom*)malloc(sizeof(Atom)*count);
+	_symbols.reserve(count);
+	auto addSymbol = [&](const char* name, ld::Atom::Definition def, ld::Atom::Combine combine, ld::Atom::Scope scope, uint8_t alignment, bool autohide) {
+		_symbols.push_back({ (uint32_t)_symbolNames.size(), (uint8_t)def, (uint8_t)combine, (uint8_t)scope, alignment, autohide });
+		_symbolNames.insert(_symbolNames.end(), name, name + strlen(name) + 1);
+	};
 	for (uint32_t i=0; i < count; ++i) {
 		const char* name = ::lto_module_get_symbol_name(_module, i);
 		lto_symbol_attributes attr = lto_module_get_symbol_attribute(_module, i);
@@ -497,22 +572,17 @@ File::File(const char* pth, time_t mTime, ld::File::Ordinal ordinal, const uint8
 				default:
 					throwf("unknown scope for symbol %s in bitcode file %s", name, pth);
 			}
-			// only make atoms for non-internal symbols
-			if ( scope == ld::Atom::scopeTranslationUnit )
-				continue;
 			uint8_t alignment = (attr & LTO_SYMBOL_ALIGNMENT_MASK);
-			// make Atom using placement new operator
-			new (&_atomArray[_atomArrayCount++]) Atom(*this, name, scope, def, combine, alignment, autohide);
-			if ( scope != ld::Atom::scopeTranslationUnit )
-				_internalAtom.addReference(name);
+			addSymbol(name, def, combine, scope, alignment, autohide);
 			if ( log ) fprintf(stderr, "\t0x%08X %s\n", attr, name);
 		}
 		else {
 			// add to list of external references
-			_internalAtom.addReference(name);
+			addSymbol(name, def, combine, ld::Atom::scopeGlobal, 0, false);
 			if ( log ) fprintf(stderr, "\t%s (undefined)\n", name);
 		}
 	}
+	_symbolNames.shrink_to_fit();
 
 #if LTO_API_VERSION >= 11
 	if ( sSupportsLocalContext )
@@ -528,24 +598,11 @@ File::~File()
 // this is only called when generating a text map file, to better detail where code came from
 void File::forEachLtoSymbol(void (^handler)(const char*)) const
 {
-#if LTO_API_VERSION >= 11
-	if ( lto_module_t module = ::lto_module_create_in_local_context(_content, _contentLength, _path) ) {
-		uint32_t count = ::lto_module_get_num_symbols(module);
-		for (uint32_t i=0; i < count; ++i) {
-			lto_symbol_attributes attr = lto_module_get_symbol_attribute(module, i);
-			switch ( attr & LTO_SYMBOL_DEFINITION_MASK ) {
-				case LTO_SYMBOL_DEFINITION_REGULAR:
-				case LTO_SYMBOL_DEFINITION_TENTATIVE:
-				case LTO_SYMBOL_DEFINITION_WEAK:
-					handler(::lto_module_get_symbol_name(module, i));
-					break;
-				default:
-					break;
-			}
-		}
-		::lto_module_dispose(module);
+	// use the symbols recorded by the parse instead of creating the module again
+	for (const SymbolInfo& symbol : _symbols) {
+		if ( symbol.definition != ld::Atom::definitionProxy )
+			handler(&_symbolNames[symbol.nameOffset]);
 	}
-#endif
 }
 
 bool File::mergeIntoGenerator(lto_code_gen_t generator, bool useSetModule) {
@@ -592,8 +649,31 @@ void File::release()
 	_module = NULL;
 }
 
+// make Atoms for the symbols recorded when the file was parsed
+// forEachAtom() may be called for the same file from more than one thread, so only the first call builds them
+void File::makeAtoms()
+{
+	std::call_once(_atomsMade, [this]() {
+		_atomArray = (Atom*)malloc(sizeof(Atom)*_symbols.size());
+		for (const SymbolInfo& symbol : _symbols) {
+			// only make atoms for non-internal symbols
+			if ( symbol.scope == ld::Atom::scopeTranslationUnit )
+				continue;
+			const char* name = &_symbolNames[symbol.nameOffset];
+			if ( symbol.definition != ld::Atom::definitionProxy ) {
+				// make Atom using placement new operator
+				new (&_atomArray[_atomArrayCount++]) Atom(*this, name, (ld::Atom::Scope)symbol.scope, (ld::Atom::Definition)symbol.definition,
+															(ld::Atom::Combine)symbol.combine, symbol.alignment, symbol.autoHide);
+			}
+			// internal atom references every non-internal symbol and every external one
+			_internalAtom.addReference(name);
+		}
+	});
+}
+
 bool File::forEachAtom(ld::File::AtomHandler& handler) const
 {
+	const_cast<File*>(this)->makeAtoms();
 	handler.doAtom(_internalAtom);
 	for(uint32_t i=0; i < _atomArrayCount; ++i) {
 		handler.doAtom(_atomArray[i]);
@@ -612,7 +692,7 @@ Atom::Atom(File& f, const char* nm, ld::Atom::Scope s, ld::Atom::Definition d, l
 			ld::Atom::Alignment a, bool ah)
 	: ld::Atom(f._section, d, c, s, ld::Atom::typeLTOtemporary, 
 				ld::Atom::symbolTableIn, false, false, false, a),
-		_file(f), _name(strdup(nm)), _compiledAtom(NULL)
+		_file(f), _name(nm), _compiledAtom(NULL)
 {
 	if ( ah )
 		this->setAutoHide();
@@ -735,6 +815,7 @@ void Parser::setPreservedSymbols(	const std::vector<const ld::Atom*>&	allAtoms,
 	}
 	for (std::vector<File*>::iterator it=_s_files.begin(); it != _s_files.end(); ++it) {
 		File* file = *it;
+		file->makeAtoms();
 		for(uint32_t i=0; i < file->_atomArrayCount; ++i) {
 			Atom* llvmAtom = &file->_atomArray[i];
 			if ( llvmAtom->coalescedAway()  ) {
@@ -1209,6 +1290,7 @@ thinlto_code_gen_t Parser::init_thinlto_codegen(const std::vector<File*>&
 			nonLLVMRefs.insert(state.entryPoint->name());
 	}
 	for (auto file : files) {
+		file->makeAtoms();
 		for(uint32_t i=0; i < file->_atomArrayCount; ++i) {
 			Atom* llvmAtom = &file->_atomArray[i];
 			if ( llvmAtom->coalescedAway()  ) {
@@ -1398,22 +1480,39 @@ bool Parser::optimizeThinLTO(const std::vector<File*>&              files,
 		return thinlto_module_get_object(thingenerator, ID);
 	};
 
-	// if requested, save off objects files
+	// fetch all generated objects up front, each non-empty one gets the next ordinal
+	struct GeneratedObject {
+		LTOObjectBuffer				buffer;
+		std::string					path;
+		ld::File::Ordinal			ordinal;
+		ld::relocatable::File*		file = nullptr;
+		const char*					errorMessage = nullptr;
+	};
+	__block std::vector<GeneratedObject> objects(numObjects);
+	for (unsigned bufID = 0; bufID < numObjects; ++bufID)
+		objects[bufID].buffer = get_thinlto_buffer_or_load_file(bufID);
+
+	// if requested, save off objects files in the background while the objects are parsed
+	dispatch_group_t saveTempsGroup = dispatch_group_create();
 	if ( options.saveTemps ) {
 		for (unsigned bufID = 0; bufID < numObjects; ++bufID) {
-			auto machOFile = get_thinlto_buffer_or_load_file(bufID);
+			LTOObjectBuffer machOFile = objects[bufID].buffer;
 			std::string tempMachoPath = options.outputFilePath;
 			tempMachoPath += ".";
 			tempMachoPath += std::to_string(bufID);
 			tempMachoPath += ".thinlto.o";
-			int fd = ::open(tempMachoPath.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0666);
-			if ( fd != -1 ) {
-				ld::utils::write64(fd, machOFile.Buffer, machOFile.Size);
-				::close(fd);
-			}
-			else {
-				warning("unable to write temporary ThinLTO output: %s", tempMachoPath.c_str());
-			}
+			const char* savePath = strdup(tempMachoPath.c_str());
+			dispatch_group_async(saveTempsGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+				int fd = ::open(savePath, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+				if ( fd != -1 ) {
+					ld::utils::write64(fd, machOFile.Buffer, machOFile.Size);
+					::close(fd);
+				}
+				else {
+					warning("unable to write temporary ThinLTO output: %s", savePath);
+				}
+				free((void*)savePath);
+			});
 		}
 	}
 
@@ -1432,39 +1531,64 @@ bool Parser::optimizeThinLTO(const std::vector<File*>&              files,
 
 	auto ordinal = ld::File::Ordinal::LTOOrdinal().nextFileListOrdinal();
 	for (unsigned bufID = 0; bufID < numObjects; ++bufID) {
-		auto machOFile = get_thinlto_buffer_or_load_file(bufID);
-		if (!machOFile.Size) {
+		GeneratedObject& object = objects[bufID];
+		if (!object.buffer.Size) {
 			warning("Ignoring empty buffer generated by ThinLTO");
 			continue;
 		}
+		object.ordinal = ordinal;
+		ordinal = ordinal.nextFileListOrdinal();
 
 		// mach-o parsing is done in-memory, but need path for debug notes
-		std::string tmp_path;
 #if LTO_API_VERSION >= 21
 		if ( useFileBasedAPI ) {
-			tmp_path = thinlto_module_get_object_file(thingenerator, bufID);
+			object.path = thinlto_module_get_object_file(thingenerator, bufID);
 		}
 		else
 #endif
 		if ( options.tmpObjectFilePath != NULL) {
-			tmp_path = macho_dirpath + "/" + std::to_string(bufID) + ".o";
-			// if needed, save temp mach-o file to specific location
-			int fd = ::open(tmp_path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0666);
-			if ( fd != -1) {
-				ld::utils::write64(fd, (const uint8_t *)machOFile.Buffer, machOFile.Size);
-				::close(fd);
-			}
-			else {
-				warning("could not write ThinLTO temp file '%s', errno=%d", tmp_path.c_str(), errno);
+			object.path = macho_dirpath + "/" + std::to_string(bufID) + ".o";
+		}
+	}
+
+	// write temp mach-o files and parse generated mach-o files into MachOReaders, all in parallel
+	bool writeTempFiles = (options.tmpObjectFilePath != NULL);
+#if LTO_API_VERSION >= 21
+	if ( useFileBasedAPI )
+		writeTempFiles = false;
+#endif
+	dispatch_apply(numObjects, DISPATCH_APPLY_AUTO, ^(size_t bufID) {
+		GeneratedObject& object = objects[bufID];
+		if ( !object.buffer.Size )
+			return;
+		try {
+			if ( writeTempFiles ) {
+				// if needed, save temp mach-o file to specific location, before parsing stats it
+				int fd = ::open(object.path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0666);
+				if ( fd != -1) {
+					ld::utils::write64(fd, (const uint8_t *)object.buffer.Buffer, object.buffer.Size);
+					::close(fd);
+				}
+				else {
+					warning("could not write ThinLTO temp file '%s', errno=%d", object.path.c_str(), errno);
+				}
 			}
+			object.file = parseMachOFile((const uint8_t *)object.buffer.Buffer, object.buffer.Size, object.path, options, object.ordinal);
 		}
+		catch (const char* msg) {
+			object.errorMessage = strdup(msg);
+		}
+	});
 
-		// parse generated mach-o file into a MachOReader
-		ld::relocatable::File* machoFile = parseMachOFile((const uint8_t *)machOFile.Buffer, machOFile.Size, tmp_path, options, ordinal);
-		ordinal = ordinal.nextFileListOrdinal();
+	dispatch_group_wait(saveTempsGroup, DISPATCH_TIME_FOREVER);
+	dispatch_release(saveTempsGroup);
 
-		// Load the generated MachO file
-		loadMachO(machoFile, options, handler, newAtoms, additionalUndefines, llvmAtoms, deadllvmAtoms);
+	// Load the generated MachO files in ordinal order, report the first failure in that order
+	for (GeneratedObject& object : objects) {
+		if ( object.errorMessage != nullptr )
+			throw object.errorMessage;
+		if ( object.file != nullptr )
+			loadMachO(object.file, options, handler, newAtoms, additionalUndefines, llvmAtoms, deadllvmAtoms);
 	}
 
 	// Remove Atoms from ld if code generator optimized them away
@@ -1686,21 +1810,15 @@ void Parser::AtomSyncer::doAtom(const ld::Atom& machoAtom)
 
 }
 
-class Mutex {
-	static pthread_mutex_t lto_lock;
-public:
-	Mutex() { pthread_mutex_lock(&lto_lock); }
-	~Mutex() { pthread_mutex_unlock(&lto_lock); }
-};
-pthread_mutex_t Mutex::lto_lock = PTHREAD_MUTEX_INITIALIZER;
-bool File::sSupportsLocalContext = false;
-bool File::sHasTriedLocalContext = false;
-
 //
 // Used by archive reader to see if member is an llvm bitcode file
 //
 bool isObjectFile(const uint8_t* fileContent, uint64_t fileLength, cpu_type_t architecture, cpu_subtype_t subarch)
 {
+	if ( parseConcurrently() ) {
+		SharedMutex lock;
+		return Parser::validFile(fileContent, fileLength, architecture, subarch);
+	}
 	Mutex lock;
 	return Parser::validFile(fileContent, fileLength, architecture, subarch);
 }
@@ -1713,6 +1831,7 @@ bool hasObjCCategory(const uint8_t* fileContent, uint64_t fileLength)
 #if LTO_API_VERSION >= 20
 	// note: if run with older libLTO.dylib that does not implement
 	// lto_module_has_objc_category, the call will return 0 which is "false"
+	SharedMutex lock;
 	return lto_module_has_objc_category(fileContent, fileLength);
 #else
 	return false;
@@ -1746,8 +1865,20 @@ ld::relocatable::File* parse(const uint8_t* fileContent, uint64_t fileLength,
 	if ( (fileContent[0] != 0xDE) || (fileContent[1] != 0xC0) || (fileContent[2] != 0x17) || (fileContent[3] != 0x0B) )
 		return NULL;
 
-	// Note: Once lto_module_create_in_local_context() and friends are thread safe
-	// this lock can be removed.
+	// each file gets its own LLVM context, so recent libLTO only needs to keep out exclusive users
+	if ( parseConcurrently() ) {
+		try {
+			SharedMutex lock;
+			return parseImpl(fileContent, fileLength, path, modTime, ordinal,
+							architecture, subarch, logAllFiles,
+							verboseOptimizationHints);
+		}
+		catch (const char*) {
+			// libLTO's error message may be another thread's, so parse again alone below to report it
+		}
+	}
+
+	// Note: older libLTO shares state between lto_module_create_in_local_context() calls
 	Mutex lock;
 	return parseImpl(fileContent, fileLength, path, modTime, ordinal,
 					architecture, subarch, logAllFiles,
@@ -1876,6 +2007,10 @@ void set_library(const char *dylib) {
   assert(!sLTOIsLoaded);
   sLTODylib = dylib;
 }
+
+void set_concurrent_parse(bool enable) {
+  sConcurrentParseRequested = enable;
+}
 } // end namespace lto
 
 namespace {
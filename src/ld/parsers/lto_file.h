@@ -37,6 +37,9 @@ extern unsigned int static_api_version();
 
 void set_library(const char *dylib);
 
+// lets bitcode files be parsed on several threads at once, for -concurrent_parse_lto
+void set_concurrent_parse(bool enable);
+
 extern bool libLTOisLoaded();
 
 extern const char* archName(const uint8_t* fileContent, uint64_t fileLength);
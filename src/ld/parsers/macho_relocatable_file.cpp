@@ -9390,6 +9390,15 @@ bool hasObjC1Categories(const uint8_t* fileContent)
 	return false;
 }
 
+//
+// used by -print_statistics
+//
+void compactUnwindMemoCounts(uint64_t& lookups, uint64_t& hits)
+{
+	lookups = libunwind::CompactEncodingMemo::lookups();
+	hits    = libunwind::CompactEncodingMemo::hits();
+}
+
 //
 // Used by bitcode obfuscator to get a list of non local symbols from object file
 //
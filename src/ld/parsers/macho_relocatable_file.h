@@ -72,6 +72,9 @@ extern const char* archName(const uint8_t* fileContent);
 
 bool getNonLocalSymbols(const uint8_t* fileContent, std::vector<const char*> &syms);
 
+// FDEs converted to compact unwind so far, and how many of them reused an earlier conversion
+extern void compactUnwindMemoCounts(uint64_t& lookups, uint64_t& hits);
+
 } // namespace relocatable
 } // namespace mach_o
 
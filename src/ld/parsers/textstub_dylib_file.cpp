@@ -34,6 +34,7 @@
 #include "MachOTrie.hpp"
 #include "generic_dylib_file.hpp"
 #include "textstub_dylib_file.hpp"
+#include "InterfaceCache.h"
 
 
 namespace textstub {
@@ -72,11 +73,14 @@ public:
 	virtual void	processIndirectLibraries(ld::dylib::File::DylibHandler*, bool addImplicitDylibs) override final;
 
 private:
-	void				init(tapi::LinkerInterfaceFile* file, const Options *opts, bool buildingForSimulator,
+	using Interface = ld::tool::InterfaceCache::Interface;
+
+	void				init(const Interface& interface, const Options *opts, bool buildingForSimulator,
 									 bool indirectDylib, bool linkingFlatNamespace, bool linkingMainExecutable,
 									 const char *path, const ld::VersionSet& platforms, const char *targetInstallPath,
 									 bool usingBitcode, bool internalSDK, bool fromSDK, bool platformMismatchesAreWarning);
-	void				buildExportHashTable(const tapi::LinkerInterfaceFile* file);
+	void				buildExportHashTable(const Interface& interface);
+	static void			describe(const tapi::LinkerInterfaceFile* file, Interface& interface);
 	static bool useSimulatorVariant();
 	
 	const Options* _opts;
@@ -124,12 +128,25 @@ File<A>::File(const char* path, const uint8_t* fileContent, uint64_t fileLength,
 	if (!allowWeakImports)
 		flags |= tapi::ParsingFlags::DisallowWeakImports;
 
-	_interface = tapi::LinkerInterfaceFile::create(
-		path, cpuType, cpuSubType, flags,
-		tapi::PackedVersion32(linkMinOSVersion), errorMessage);
+	// with -interface_cache_dir, another linker process may already have parsed this file
+	Interface interface;
+	std::string cacheKey;
+	bool cached = false;
+	if ( opts->interfaceCacheDir() != nullptr ) {
+		cacheKey = ld::tool::InterfaceCache::makeKey(path, fileLength, mTime, cpuType, cpuSubType, (uint32_t)flags, linkMinOSVersion);
+		cached = ld::tool::InterfaceCache::lookup(opts->interfaceCacheDir(), cacheKey, interface);
+	}
+
+	_interface = nullptr;
+	if ( !cached ) {
+		_interface = tapi::LinkerInterfaceFile::create(
+			path, cpuType, cpuSubType, flags,
+			tapi::PackedVersion32(linkMinOSVersion), errorMessage);
 
-	if (!_interface)
-		throw strdup(errorMessage.c_str());
+		if (!_interface)
+			throw strdup(errorMessage.c_str());
+		describe(_interface, interface);
+	}
 
 	// unmap file - it is no longer needed.
 	munmap((caddr_t)fileContent, fileLength);
@@ -138,8 +155,16 @@ File<A>::File(const char* path, const uint8_t* fileContent, uint64_t fileLength,
 	if ( logAllFiles )
 		printf("%s\n", path);
 
-	init(_interface, opts, buildingForSimulator, indirectDylib, linkingFlatNamespace,
+	init(interface, opts, buildingForSimulator, indirectDylib, linkingFlatNamespace,
 		 linkingMainExecutable, path, platforms, targetInstallPath, usingBitcode, internalSDK, fromSDK, platformMismatchesAreWarning);
+
+	// files with inlined frameworks need the tapi interface later, so are not cached
+	if ( !cached && (opts->interfaceCacheDir() != nullptr) ) {
+#if ((TAPI_API_VERSION_MAJOR == 1 &&  TAPI_API_VERSION_MINOR >= 6) || (TAPI_API_VERSION_MAJOR > 1))
+		if ( _interface->inlinedFrameworkNames().empty() )
+#endif
+			ld::tool::InterfaceCache::store(opts->interfaceCacheDir(), cacheKey, interface);
+	}
 }
 
 	template<typename A>
@@ -154,26 +179,75 @@ File<A>::File(const char* path, const uint8_t* fileContent, uint64_t fileLength,
 	: Base(strdup(path), mTime, ordinal, platforms, allowWeakImports, linkingFlatNamespace,
 		   hoistImplicitPublicDylibs, allowSimToMacOSX, addVers), _interface(file)
 {
-	init(_interface, opts, buildingForSimulator, indirectDylib, linkingFlatNamespace,
+	Interface interface;
+	describe(_interface, interface);
+	init(interface, opts, buildingForSimulator, indirectDylib, linkingFlatNamespace,
 		 linkingMainExecutable, path, platforms, installPath, usingBitcode, internalSDK, fromSDK, platformMismatchesAreWarning);
 }
 	
+// collects what init() needs from a parsed .tbd file, the strings stay owned by file
 template<typename A>
-void File<A>::init(tapi::LinkerInterfaceFile* file, const Options *opts, bool buildingForSimulator,
+void File<A>::describe(const tapi::LinkerInterfaceFile* file, Interface& interface) {
+	interface.installName = file->getInstallName().c_str();
+	interface.parentUmbrella = file->getParentFrameworkName().empty() ? nullptr : file->getParentFrameworkName().c_str();
+	interface.currentVersion = file->getCurrentVersion();
+	interface.compatibilityVersion = file->getCompatibilityVersion();
+	interface.swiftVersion = file->getSwiftVersion();
+	interface.installNameVersionSpecific = file->isInstallNameVersionSpecific();
+	interface.applicationExtensionSafe = file->isApplicationExtensionSafe();
+	interface.twoLevelNamespace = file->hasTwoLevelNamespace();
+	interface.hasWeakDefinedExports = file->hasWeakDefinedExports();
+
+	for (const auto &client : file->allowableClients())
+		interface.allowableClients.push_back(client.c_str());
+
+#if (TAPI_API_VERSION_MAJOR == 2 && TAPI_API_VERSION_MINOR >= 2)
+	if (tapi::APIVersion::isAtLeast(2, 2)) {
+		for (const auto &rpath : file->rPaths())
+			interface.rpaths.push_back(rpath.c_str());
+		
+		for (const auto &[platform, minOS] : file->getPlatformsAndMinDeployment())
+			interface.platforms.emplace_back((ld::Platform)platform, minOS);
+	} else
+#endif
+	{
+		for (const auto &platform : file->getPlatformSet())
+			interface.platforms.emplace_back((ld::Platform)platform);
+	}
+
+	for (const auto& reexport : file->reexportedLibraries())
+		interface.reexportedLibraries.push_back(reexport.c_str());
+
+	for (const auto& symbol : file->ignoreExports())
+		interface.ignoreExports.push_back(symbol.c_str());
+
+	if ( !interface.twoLevelNamespace ) {
+		interface.undefineds.reserve(file->undefineds().size());
+		for (const auto &sym : file->undefineds())
+			interface.undefineds.push_back(sym.getName().c_str());
+	}
+
+	interface.exports.reserve(file->exports().size());
+	for (const auto &sym : file->exports())
+		interface.exports.push_back({ sym.getName().c_str(), sym.isWeakDefined(), sym.isThreadLocalValue() });
+}
+
+template<typename A>
+void File<A>::init(const Interface& interface, const Options *opts, bool buildingForSimulator,
 				   bool indirectDylib, bool linkingFlatNamespace, bool linkingMainExecutable,
 				   const char *path, const ld::VersionSet& cmdLinePlatforms, const char *targetInstallPath,
 				   bool usingBitcode, bool internalSDK, bool fromSDK, bool platformMismatchesAreWarning) {
 	_opts = opts;
 	this->_bitcode = std::unique_ptr<ld::Bitcode>(new ld::Bitcode(nullptr, 0));
-	this->_noRexports = !file->hasReexportedLibraries();
-	this->_hasWeakExports = file->hasWeakDefinedExports();
-	this->_dylibInstallPath = strdup(file->getInstallName().c_str());
-	this->_installPathOverride = file->isInstallNameVersionSpecific();
-	this->_dylibCurrentVersion = file->getCurrentVersion();
-	this->_dylibCompatibilityVersion = file->getCompatibilityVersion();
-	this->_swiftVersion = file->getSwiftVersion();
-	this->_parentUmbrella = file->getParentFrameworkName().empty() ? nullptr : strdup(file->getParentFrameworkName().c_str());
-	this->_appExtensionSafe = file->isApplicationExtensionSafe();
+	this->_noRexports = interface.reexportedLibraries.empty();
+	this->_hasWeakExports = interface.hasWeakDefinedExports;
+	this->_dylibInstallPath = strdup(interface.installName);
+	this->_installPathOverride = interface.installNameVersionSpecific;
+	this->_dylibCurrentVersion = interface.currentVersion;
+	this->_dylibCompatibilityVersion = interface.compatibilityVersion;
+	this->_swiftVersion = interface.swiftVersion;
+	this->_parentUmbrella = (interface.parentUmbrella == nullptr) ? nullptr : strdup(interface.parentUmbrella);
+	this->_appExtensionSafe = interface.applicationExtensionSafe;
 
 	// if framework, capture framework name
 	const char* lastSlash = strrchr(this->_dylibInstallPath, '/');
@@ -187,70 +261,53 @@ void File<A>::init(tapi::LinkerInterfaceFile* file, const Options *opts, bool bu
 			this->_frameworkName = leafName;
 	}
 	
-	for (auto &client : file->allowableClients())
-		this->_allowableClients.push_back(strdup(client.c_str()));
+	for (const char* client : interface.allowableClients)
+		this->_allowableClients.push_back(strdup(client));
 	
 	// <rdar://problem/20659505> [TAPI] Don't hoist "public" (in /usr/lib/) dylibs that should not be directly linked
-	this->_hasPublicInstallName = file->hasAllowableClients() ? false : this->isPublicLocation(file->getInstallName().c_str());
+	this->_hasPublicInstallName = !interface.allowableClients.empty() ? false : this->isPublicLocation(interface.installName);
 	
-	for (const auto &client : file->allowableClients())
-		this->_allowableClients.emplace_back(strdup(client.c_str()));
+	for (const char* client : interface.allowableClients)
+		this->_allowableClients.emplace_back(strdup(client));
+
+	for (const char* rpath : interface.rpaths)
+		this->_rpaths.emplace_back(rpath);
 
 	ld::VersionSet lcPlatforms;
-#if (TAPI_API_VERSION_MAJOR == 2 && TAPI_API_VERSION_MINOR >= 2)
-	if (tapi::APIVersion::isAtLeast(2, 2)) {
-		for (const auto &rpath : file->rPaths())
-			this->_rpaths.emplace_back(rpath.c_str());
-		
-		for (const auto &[platform, minOS] : file->getPlatformsAndMinDeployment()) {
-			ld::PlatformVersion pv((ld::Platform)platform, minOS);
-			lcPlatforms.insert(pv);
-		}
-	} else
-#endif
-	{
-		for (const auto &platform : file->getPlatformSet())
-			lcPlatforms.insert((ld::Platform)platform);
-	}
+	for (const ld::PlatformVersion& platform : interface.platforms)
+		lcPlatforms.insert(platform);
 
 	// check cross-linking
 	cmdLinePlatforms.checkDylibCrosslink(lcPlatforms, path, ".tbd", internalSDK, indirectDylib, usingBitcode, _isUnzipperedTwin, _dylibInstallPath, fromSDK, platformMismatchesAreWarning);
 
-	for (const auto& reexport : file->reexportedLibraries()) {
-		const char *path = strdup(reexport.c_str());
+	for (const char* reexport : interface.reexportedLibraries) {
+		const char *path = strdup(reexport);
 		if ( (targetInstallPath == nullptr) || (strcmp(targetInstallPath, path) != 0) )
 			this->_dependentDylibs.emplace_back(path, true);
 	}
 	
-	for (const auto& symbol : file->ignoreExports())
-		this->_ignoreExports.insert(strdup(symbol.c_str()));
+	for (const char* symbol : interface.ignoreExports)
+		this->_ignoreExports.insert(strdup(symbol));
 	
 	// if linking flat and this is a flat dylib, create one atom that references all imported symbols.
-	if ( linkingFlatNamespace && linkingMainExecutable && (file->hasTwoLevelNamespace() == false) ) {
-		std::vector<const char*> importNames;
-		importNames.reserve(file->undefineds().size());
-		// We do not need to strdup the name, because that will be done by the
+	if ( linkingFlatNamespace && linkingMainExecutable && (interface.twoLevelNamespace == false) ) {
+		// We do not need to strdup the names, because that will be done by the
 		// ImportAtom constructor.
-		for (const auto &sym : file->undefineds())
-			importNames.emplace_back(sym.getName().c_str());
+		std::vector<const char*> importNames(interface.undefineds);
 		this->_importAtom = new generic::dylib::ImportAtom(*this, importNames);
 	}
 	
 	// build hash table
-	buildExportHashTable(file);
+	buildExportHashTable(interface);
 }
 
 template <typename A>
-void File<A>::buildExportHashTable(const tapi::LinkerInterfaceFile* file) {
+void File<A>::buildExportHashTable(const Interface& interface) {
 	if (this->_s_logHashtable )
 		fprintf(stderr, "ld: building hashtable from text-stub info in %s\n", this->path());
 
-	for (const auto &sym : file->exports()) {
-		const char* name = sym.getName().c_str();
-		bool weakDef = sym.isWeakDefined();
-		bool tlv = sym.isThreadLocalValue();
-		addExportedSymbol(name, weakDef, tlv, 0);
-	}
+	for (const auto &sym : interface.exports)
+		addExportedSymbol(sym.name, sym.weakDef, sym.tlv, 0);
 }
 
 template <typename A>
@@ -35,6 +35,7 @@
 #include "MachOFileAbstraction.hpp"
 #include "ld.hpp"
 #include "got.h"
+#include "references.h"
 #include "configure.h"
 
 namespace ld {
@@ -298,133 +299,129 @@ void doPass(const Options& opts, ld::Internal& internal)
 		}
 	}
 
-	// walk all atoms and fixups looking for GOT-able references
+	// walk atoms with GOT loads looking for GOT-able references
 	// don't create GOT atoms during this loop because that could invalidate the sections iterator
 	std::vector<const ld::Atom*> atomsReferencingGOT;
 	std::map<const ld::Atom*,bool>		weakImportMap;
 	atomsReferencingGOT.reserve(128);
-	for (std::vector<ld::Internal::FinalSection*>::iterator sit=internal.sections.begin(); sit != internal.sections.end(); ++sit) {
-		ld::Internal::FinalSection* sect = *sit;
-		for (std::vector<const ld::Atom*>::iterator ait=sect->atoms.begin();  ait != sect->atoms.end(); ++ait) {
-			const ld::Atom* atom = *ait;
-			bool atomUsesGOT = false;
-			const ld::Atom* targetOfGOT = NULL;
-			bool targetIsWeakImport = false;
-			for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
-				if ( fit->firstInCluster() ) 
-					targetOfGOT = NULL;
-				switch ( fit->binding ) {
-					case ld::Fixup::bindingsIndirectlyBound:
-						targetOfGOT = internal.indirectBindingTable[fit->u.bindingIndex];
-						targetIsWeakImport = fit->weakImport;
-						break;
-					case ld::Fixup::bindingDirectlyBound:
-						targetOfGOT = fit->u.target;
-						targetIsWeakImport = fit->weakImport;
-						break;
+	ld::passes::references::forEachAtom(internal, &ld::Internal::ReferenceLists::gotReferencers, [&](const ld::Atom* atom) {
+		bool atomUsesGOT = false;
+		const ld::Atom* targetOfGOT = NULL;
+		bool targetIsWeakImport = false;
+		for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+			if ( fit->firstInCluster() ) 
+				targetOfGOT = NULL;
+			switch ( fit->binding ) {
+				case ld::Fixup::bindingsIndirectlyBound:
+					targetOfGOT = internal.indirectBindingTable[fit->u.bindingIndex];
+					targetIsWeakImport = fit->weakImport;
+					break;
+				case ld::Fixup::bindingDirectlyBound:
+					targetOfGOT = fit->u.target;
+					targetIsWeakImport = fit->weakImport;
+					break;
                     default:
                         break;   
-				}
-				bool optimizable;
-				bool targetIsPersonalityFn;
-				if ( !gotFixup(opts, internal, targetOfGOT, atom, fit, &optimizable, &targetIsPersonalityFn) )
-					continue;
-				if ( optimizable ) {
-					// change from load of GOT entry to lea of target
-					if ( log ) fprintf(stderr, "optimized GOT usage in %s to %s\n", atom->name(), targetOfGOT->name());
-					if ( fit->clusterSize == ld::Fixup::k2of2 ) {
-						switch (fit->kind ) {
+			}
+			bool optimizable;
+			bool targetIsPersonalityFn;
+			if ( !gotFixup(opts, internal, targetOfGOT, atom, fit, &optimizable, &targetIsPersonalityFn) )
+				continue;
+			if ( optimizable ) {
+				// change from load of GOT entry to lea of target
+				if ( log ) fprintf(stderr, "optimized GOT usage in %s to %s\n", atom->name(), targetOfGOT->name());
+				if ( fit->clusterSize == ld::Fixup::k2of2 ) {
+					switch (fit->kind ) {
 #if SUPPORT_ARCH_riscv32
-							case ld::Fixup::kindStoreRISCVlo12PCRelGOT:
-								fit->kind = ld::Fixup::kindStoreRISCVlo12PCRelwasGOT;
-								fit[-1].binding = ld::Fixup::bindingDirectlyBound;
-								fit[-1].u.target = targetOfGOT;
-								break;
-							case ld::Fixup::kindStoreRISCVlo12GOT:
-								fit->kind = ld::Fixup::kindStoreRISCVlo12wasGOT;
-								fit[-1].binding = ld::Fixup::bindingDirectlyBound;
-								fit[-1].u.target = targetOfGOT;
-								break;
-							case ld::Fixup::kindStoreRISCVhi20PCRelGOT:
-								fit->kind = ld::Fixup::kindStoreRISCVhi20PCRel;
-								fit[-1].binding = ld::Fixup::bindingDirectlyBound;
-								fit[-1].u.target = targetOfGOT;
-								break;
-							case ld::Fixup::kindStoreRISCVhi20GOT:
-								fit->kind = ld::Fixup::kindStoreRISCVhi20;
-								fit[-1].binding = ld::Fixup::bindingDirectlyBound;
-								fit[-1].u.target = targetOfGOT;
-								break;
-#endif
-							default:
-								break;
-						}
-					}
-					else {
-						switch ( fit->binding ) {
-							case ld::Fixup::bindingsIndirectlyBound:
-							case ld::Fixup::bindingDirectlyBound:
-								fit->binding = ld::Fixup::bindingDirectlyBound;
-								fit->u.target = targetOfGOT;
-								switch ( fit->kind ) {
-									case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoad:
-										fit->kind = ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoadNowLEA;
-										break;
-#if SUPPORT_ARCH_arm64
-									case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPage21:
-										fit->kind = ld::Fixup::kindStoreTargetAddressARM64GOTLeaPage21;
-										break;
-									case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPageOff12:
-										fit->kind = ld::Fixup::kindStoreTargetAddressARM64GOTLeaPageOff12;
-										break;
+						case ld::Fixup::kindStoreRISCVlo12PCRelGOT:
+							fit->kind = ld::Fixup::kindStoreRISCVlo12PCRelwasGOT;
+							fit[-1].binding = ld::Fixup::bindingDirectlyBound;
+							fit[-1].u.target = targetOfGOT;
+							break;
+						case ld::Fixup::kindStoreRISCVlo12GOT:
+							fit->kind = ld::Fixup::kindStoreRISCVlo12wasGOT;
+							fit[-1].binding = ld::Fixup::bindingDirectlyBound;
+							fit[-1].u.target = targetOfGOT;
+							break;
+						case ld::Fixup::kindStoreRISCVhi20PCRelGOT:
+							fit->kind = ld::Fixup::kindStoreRISCVhi20PCRel;
+							fit[-1].binding = ld::Fixup::bindingDirectlyBound;
+							fit[-1].u.target = targetOfGOT;
+							break;
+						case ld::Fixup::kindStoreRISCVhi20GOT:
+							fit->kind = ld::Fixup::kindStoreRISCVhi20;
+							fit[-1].binding = ld::Fixup::bindingDirectlyBound;
+							fit[-1].u.target = targetOfGOT;
+							break;
 #endif
-									default:
-										assert(0 && "unsupported GOT reference kind");
-										break;
-								}
-								break;
-							default:
-								assert(0 && "unsupported GOT reference");
-								break;
-						}
+						default:
+							break;
 					}
 				}
 				else {
-					// remember that we need to use GOT in this function
-					if ( log ) fprintf(stderr, "found GOT use in %s\n", atom->name());
-					if ( !atomUsesGOT ) {
-						atomsReferencingGOT.push_back(atom);
-						atomUsesGOT = true;
-					}
-					if ( gotMap.count({ targetOfGOT, targetIsPersonalityFn }) == 0 )
-						gotMap[{ targetOfGOT, targetIsPersonalityFn }] = NULL;
-					// record weak_import attribute
-					std::map<const ld::Atom*,bool>::iterator pos = weakImportMap.find(targetOfGOT);
-					if ( pos == weakImportMap.end() ) {
-						// target not in weakImportMap, so add
-						if ( log ) fprintf(stderr, "weakImportMap[%s] = %d\n", targetOfGOT->name(), targetIsWeakImport);
-						weakImportMap[targetOfGOT] = targetIsWeakImport; 
-					}
-					else {
-						// target in weakImportMap, check for weakness mismatch
-						if ( pos->second != targetIsWeakImport ) {
-							// found mismatch
-							switch ( opts.weakReferenceMismatchTreatment() ) {
-								case Options::kWeakReferenceMismatchError:
-									throwf("mismatching weak references for symbol: %s", targetOfGOT->name());
-								case Options::kWeakReferenceMismatchWeak:
-									pos->second = true;
+					switch ( fit->binding ) {
+						case ld::Fixup::bindingsIndirectlyBound:
+						case ld::Fixup::bindingDirectlyBound:
+							fit->binding = ld::Fixup::bindingDirectlyBound;
+							fit->u.target = targetOfGOT;
+							switch ( fit->kind ) {
+								case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoad:
+									fit->kind = ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoadNowLEA;
+									break;
+#if SUPPORT_ARCH_arm64
+								case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPage21:
+									fit->kind = ld::Fixup::kindStoreTargetAddressARM64GOTLeaPage21;
+									break;
+								case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPageOff12:
+									fit->kind = ld::Fixup::kindStoreTargetAddressARM64GOTLeaPageOff12;
 									break;
-								case Options::kWeakReferenceMismatchNonWeak:
-									pos->second = false;
+#endif
+								default:
+									assert(0 && "unsupported GOT reference kind");
 									break;
 							}
+							break;
+						default:
+							assert(0 && "unsupported GOT reference");
+							break;
+					}
+				}
+			}
+			else {
+				// remember that we need to use GOT in this function
+				if ( log ) fprintf(stderr, "found GOT use in %s\n", atom->name());
+				if ( !atomUsesGOT ) {
+					atomsReferencingGOT.push_back(atom);
+					atomUsesGOT = true;
+				}
+				if ( gotMap.count({ targetOfGOT, targetIsPersonalityFn }) == 0 )
+					gotMap[{ targetOfGOT, targetIsPersonalityFn }] = NULL;
+				// record weak_import attribute
+				std::map<const ld::Atom*,bool>::iterator pos = weakImportMap.find(targetOfGOT);
+				if ( pos == weakImportMap.end() ) {
+					// target not in weakImportMap, so add
+					if ( log ) fprintf(stderr, "weakImportMap[%s] = %d\n", targetOfGOT->name(), targetIsWeakImport);
+					weakImportMap[targetOfGOT] = targetIsWeakImport; 
+				}
+				else {
+					// target in weakImportMap, check for weakness mismatch
+					if ( pos->second != targetIsWeakImport ) {
+						// found mismatch
+						switch ( opts.weakReferenceMismatchTreatment() ) {
+							case Options::kWeakReferenceMismatchError:
+								throwf("mismatching weak references for symbol: %s", targetOfGOT->name());
+							case Options::kWeakReferenceMismatchWeak:
+								pos->second = true;
+								break;
+							case Options::kWeakReferenceMismatchNonWeak:
+								pos->second = false;
+								break;
 						}
 					}
 				}
 			}
 		}
-	}
+	});
 	
 	bool is64 = false;
 	switch ( opts.architecture() ) {
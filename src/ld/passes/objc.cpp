@@ -28,11 +28,13 @@
 #include <unistd.h>
 #include <dlfcn.h>
 #include <mach/machine.h>
+#include <dispatch/dispatch.h>
 
 #include <algorithm>
 #include <vector>
-#include <map>
-#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "Architectures.hpp"
 #include "MachOFileAbstraction.hpp"
@@ -47,6 +49,8 @@ namespace objc {
 
 
 using NameToAtom = CStringMap<const ld::Atom*>;
+using AtomSet    = std::unordered_set<const ld::Atom*>;
+using AtomToAtom = std::unordered_map<const ld::Atom*, const ld::Atom*>;
 
 struct objc_image_info  {
 	uint32_t	version;	// initially 0
@@ -229,6 +233,19 @@ struct MethodEntryInfo
 	const ld::Atom* selectorRefAtom;
 };
 
+//
+// What a merged method list is built from.  Gathering it only reads existing atoms, so the
+// lists of many classes can be gathered in parallel and the atoms made afterwards in order.
+//
+struct MethodListContent
+{
+	const ld::File*					file = nullptr;
+	const char*						name = nullptr;
+	std::vector<const ld::Atom*>	sourceLists;		// lists merged, which become dead
+	std::vector<MethodEntryInfo>	methods;			// in final order
+	std::vector<std::string>		warnings;
+};
+
 //
 // This class is for a new Atom which is an ObjC method list created by merging method lists from categories
 //
@@ -240,7 +257,12 @@ public:
 
 											MethodListAtom(ld::Internal& state, const ld::Atom* baseMethodList, ListFormat kind, ListUse use, const char* className,
 														   bool meta, const std::vector<const ld::Atom*>* categories, NameToAtom& selectorNameToSlot,
-														   std::set<const ld::Atom*>& deadAtoms);
+														   AtomSet& deadAtoms);
+											MethodListAtom(ld::Internal& state, const MethodListContent& content, ListFormat kind, ListUse use,
+														   NameToAtom& selectorNameToSlot, AtomSet& deadAtoms);
+
+	static MethodListContent				gatherContent(ld::Internal& state, const ld::Atom* baseMethodList, ListUse use, const char* className,
+														  bool meta, const std::vector<const ld::Atom*>* categories);
 
 	virtual const ld::File*					file() const					{ return _file; }
 	virtual const char*						name() const					{ return _name; }
@@ -284,7 +306,7 @@ class ProtocolListAtom : public ld::Atom {
 public:
 											ProtocolListAtom(ld::Internal& state, const ld::Atom* baseProtocolList,
 															const char* className, const std::vector<const ld::Atom*>* categories,
-															std::set<const ld::Atom*>& deadAtoms);
+															AtomSet& deadAtoms);
 
 	virtual const ld::File*					file() const					{ return _file; }
 	virtual const char*						name() const					{ return _name.c_str(); }
@@ -322,7 +344,7 @@ public:
 
 											PropertyListAtom(ld::Internal& state, const ld::Atom* basePropertyList,
 															 const std::vector<const ld::Atom*>* categories,
-															 std::set<const ld::Atom*>& deadAtoms,
+															 AtomSet& deadAtoms,
 															 PropertyKind kind);
 
 	virtual const ld::File*					file() const					{ return _file; }
@@ -538,18 +560,18 @@ public:
 	static bool				usesRelMethodLists(ld::Internal& state, const ld::Atom* contentAtom);
 	// Setters
 	static const ld::Atom*	setName(ld::Internal& state, const ld::Atom* categoryAtom,
-									const ld::Atom* categoryNameAtom, std::set<const ld::Atom*>& deadAtoms);
+									const ld::Atom* categoryNameAtom, AtomSet& deadAtoms);
 	static void				setInstanceMethods(ld::Internal& state, const ld::Atom*& categoryAtom, const ld::Atom* methodListAtom,
-												bool usesAuthPtrs, bool& categoryIsNowOverlay, std::set<const ld::Atom*>& deadAtoms);
+												bool usesAuthPtrs, bool& categoryIsNowOverlay, AtomSet& deadAtoms);
 	static void				setClassMethods(ld::Internal& state, const ld::Atom*& categoryAtom, const ld::Atom* methodListAtom,
-												bool usesAuthPtrs, bool& categoryIsNowOverlay, std::set<const ld::Atom*>& deadAtoms);
+												bool usesAuthPtrs, bool& categoryIsNowOverlay, AtomSet& deadAtoms);
 	static void 			setInstanceProperties(ld::Internal& state, const ld::Atom*& categoryAtom, const ld::Atom* propertyListAtom,
-												  bool& categoryIsNowOverlay, std::set<const ld::Atom*>& deadAtoms);
+												  bool& categoryIsNowOverlay, AtomSet& deadAtoms);
 	static void				setClassProperties(ld::Internal& state, const ld::Atom*& categoryAtom, const ld::Atom* propertyListAtom,
-											   bool& categoryIsNowOverlay, std::set<const ld::Atom*>& deadAtoms);
+											   bool& categoryIsNowOverlay, AtomSet& deadAtoms);
 	static void				setProtocols(ld::Internal& state, const ld::Atom*& categoryAtom,
 										 const ld::Atom* protocolListAtom, bool& categoryIsNowOverlay,
-										 std::set<const ld::Atom*>& deadAtoms);
+										 AtomSet& deadAtoms);
 	static uint32_t         size() { return 6*sizeof(pint_t); }
 
 	static bool				hasCategoryClassPropertiesField(const ld::Atom* categoryAtom);
@@ -662,7 +684,7 @@ bool Category<A>::hasCategoryClassPropertiesField(const ld::Atom* contentAtom)
 
 
 template <typename A>
-void Category<A>::setInstanceMethods(ld::Internal& state, const ld::Atom*& categoryAtom, const ld::Atom* methodListAtom, bool useAuthPtrs, bool& categoryIsNowOverlay, std::set<const ld::Atom*>& deadAtoms)
+void Category<A>::setInstanceMethods(ld::Internal& state, const ld::Atom*& categoryAtom, const ld::Atom* methodListAtom, bool useAuthPtrs, bool& categoryIsNowOverlay, AtomSet& deadAtoms)
 {
 	// if the base class does not already have a method list, we need to create an overlay
 	bool needAuthPtrToMethodList = useAuthPtrs && (strcmp(methodListAtom->section().sectionName(), "__objc_methlist") == 0);
@@ -680,7 +702,7 @@ void Category<A>::setInstanceMethods(ld::Internal& state, const ld::Atom*& categ
 }
 
 template <typename A>
-void Category<A>::setClassMethods(ld::Internal& state, const ld::Atom*& categoryAtom, const ld::Atom* methodListAtom, bool useAuthPtrs, bool& categoryIsNowOverlay, std::set<const ld::Atom*>& deadAtoms)
+void Category<A>::setClassMethods(ld::Internal& state, const ld::Atom*& categoryAtom, const ld::Atom* methodListAtom, bool useAuthPtrs, bool& categoryIsNowOverlay, AtomSet& deadAtoms)
 {
 	// if the base class does not already have a method list, we need to create an overlay
 	bool needAuthPtrToMethodList = useAuthPtrs && (strcmp(methodListAtom->section().sectionName(), "__objc_methlist") == 0);
@@ -705,7 +727,7 @@ void Category<A>::setClassMethods(ld::Internal& state, const ld::Atom*& category
 template <typename A>
 void Category<A>::setProtocols(ld::Internal& state, const ld::Atom*& categoryAtom,
 							   const ld::Atom* protocolListAtom, bool& categoryIsNowOverlay,
-							   std::set<const ld::Atom*>& deadAtoms)
+							   AtomSet& deadAtoms)
 {
 	// if the base category does not already have a protocol list, we need to create an overlay
 	if ( getProtocols(state, categoryAtom) == NULL ) {
@@ -727,7 +749,7 @@ void Category<A>::setProtocols(ld::Internal& state, const ld::Atom*& categoryAto
 
 template <typename A>
 void Category<A>::setInstanceProperties(ld::Internal& state, const ld::Atom*& categoryAtom, const ld::Atom* methodListAtom,
-										bool& categoryIsNowOverlay, std::set<const ld::Atom*>& deadAtoms)
+										bool& categoryIsNowOverlay, AtomSet& deadAtoms)
 {
 	// if the base category does not already have a property list, we need to create an overlay
 	if ( getInstanceProperties(state, categoryAtom) == NULL ) {
@@ -749,7 +771,7 @@ void Category<A>::setInstanceProperties(ld::Internal& state, const ld::Atom*& ca
 
 template <typename A>
 void Category<A>::setClassProperties(ld::Internal& state, const ld::Atom*& categoryAtom, const ld::Atom* methodListAtom,
-									 bool& categoryIsNowOverlay, std::set<const ld::Atom*>& deadAtoms)
+									 bool& categoryIsNowOverlay, AtomSet& deadAtoms)
 {
 	// if the base category does not already have a property list, we need to create an overlay
 	if ( getClassProperties(state, categoryAtom) == NULL ) {
@@ -810,17 +832,17 @@ public:
 	static const ld::Atom*	getClassPropertyList(ld::Internal& state, const ld::Atom* classAtom);
 	static bool				usesRelMethodLists(ld::Internal& state, const ld::Atom* classAtom);
 	static void				setInstanceMethodList(ld::Internal& state, const ld::Atom* classAtom,
-												const ld::Atom* methodListAtom, bool useAuthPtrs, std::set<const ld::Atom*>& deadAtoms);
+												const ld::Atom* methodListAtom, bool useAuthPtrs, AtomSet& deadAtoms);
 	static void				setInstanceProtocolList(ld::Internal& state, const ld::Atom* classAtom,
-												const ld::Atom* protocolListAtom, std::set<const ld::Atom*>& deadAtoms);
+												const ld::Atom* protocolListAtom, AtomSet& deadAtoms);
 	static void        		setInstancePropertyList(ld::Internal& state, const ld::Atom* classAtom,
-												const ld::Atom* propertyListAtom, std::set<const ld::Atom*>& deadAtoms);
+												const ld::Atom* propertyListAtom, AtomSet& deadAtoms);
 	static void  			setClassMethodList(ld::Internal& state, const ld::Atom* classAtom,
-												const ld::Atom* methodListAtom, bool useAuthPtrs, std::set<const ld::Atom*>& deadAtoms);
+												const ld::Atom* methodListAtom, bool useAuthPtrs, AtomSet& deadAtoms);
 	static void				setClassProtocolList(ld::Internal& state, const ld::Atom* classAtom,
-												const ld::Atom* protocolListAtom, std::set<const ld::Atom*>& deadAtoms);
+												const ld::Atom* protocolListAtom, AtomSet& deadAtoms);
 	static void				setClassPropertyList(ld::Internal& state, const ld::Atom* classAtom,
-												const ld::Atom* propertyListAtom, std::set<const ld::Atom*>& deadAtoms);
+												const ld::Atom* propertyListAtom, AtomSet& deadAtoms);
 	static uint32_t         size() { return sizeof(Content); }
 
 private:
@@ -933,7 +955,7 @@ const ld::Atom*	Class<A>::getClassPropertyList(ld::Internal& state, const ld::At
 
 template <typename A>
 void Class<A>::setInstanceMethodList(ld::Internal& state, const ld::Atom* classAtom,
-									 const ld::Atom* methodListAtom, bool useAuthPtrs, std::set<const ld::Atom*>& deadAtoms)
+									 const ld::Atom* methodListAtom, bool useAuthPtrs, AtomSet& deadAtoms)
 {
 	// if the base class does not already have a method list, we need to create an overlay
 	bool needAuthPtrToMethodList = useAuthPtrs && (strcmp(methodListAtom->section().sectionName(), "__objc_methlist") == 0);
@@ -953,7 +975,7 @@ void Class<A>::setInstanceMethodList(ld::Internal& state, const ld::Atom* classA
 
 template <typename A>
 void Class<A>::setInstanceProtocolList(ld::Internal& state, const ld::Atom* classAtom,
-									const ld::Atom* protocolListAtom, std::set<const ld::Atom*>& deadAtoms)
+									const ld::Atom* protocolListAtom, AtomSet& deadAtoms)
 {
 	// if the base class does not already have a protocol list, we need to create an overlay
 	if ( getInstanceProtocolList(state, classAtom) == NULL ) {
@@ -971,7 +993,7 @@ void Class<A>::setInstanceProtocolList(ld::Internal& state, const ld::Atom* clas
 
 template <typename A>
 void Class<A>::setClassProtocolList(ld::Internal& state, const ld::Atom* classAtom,
-									const ld::Atom* protocolListAtom, std::set<const ld::Atom*>& deadAtoms)
+									const ld::Atom* protocolListAtom, AtomSet& deadAtoms)
 {
 	// meta class also points to same protocol list as class
 	const ld::Atom* metaClassAtom = getMetaClass(state, classAtom);
@@ -983,7 +1005,7 @@ void Class<A>::setClassProtocolList(ld::Internal& state, const ld::Atom* classAt
 
 template <typename A>
 void Class<A>::setInstancePropertyList(ld::Internal& state, const ld::Atom* classAtom,
-										const ld::Atom* propertyListAtom, std::set<const ld::Atom*>& deadAtoms)
+										const ld::Atom* propertyListAtom, AtomSet& deadAtoms)
 {
 	// if the base class does not already have a property list, we need to create an overlay
 	if ( getInstancePropertyList(state, classAtom) == NULL ) {
@@ -1001,7 +1023,7 @@ void Class<A>::setInstancePropertyList(ld::Internal& state, const ld::Atom* clas
 
 template <typename A>
 void Class<A>::setClassMethodList(ld::Internal& state, const ld::Atom* classAtom,
-											const ld::Atom* methodListAtom, bool useAuthPtrs, std::set<const ld::Atom*>& deadAtoms)
+											const ld::Atom* methodListAtom, bool useAuthPtrs, AtomSet& deadAtoms)
 {
 	// class methods is just instance methods of metaClass
 	setInstanceMethodList(state, getMetaClass(state, classAtom), methodListAtom, useAuthPtrs, deadAtoms);
@@ -1009,7 +1031,7 @@ void Class<A>::setClassMethodList(ld::Internal& state, const ld::Atom* classAtom
 
 template <typename A>
 void Class<A>::setClassPropertyList(ld::Internal& state, const ld::Atom* classAtom,
-											const ld::Atom* propertyListAtom, std::set<const ld::Atom*>& deadAtoms)
+											const ld::Atom* propertyListAtom, AtomSet& deadAtoms)
 {
 	// class properties is just instance properties of metaClass
 	setInstancePropertyList(state, getMetaClass(state, classAtom), propertyListAtom, deadAtoms);
@@ -1278,12 +1300,12 @@ static const ld::Atom* fixClassAliases(const ld::Internal& state, const ld::Atom
 //
 class OptimizedAway {
 public:
-	OptimizedAway(const std::set<const ld::Atom*>& oa) : _dead(oa) {}
+	OptimizedAway(const AtomSet& oa) : _dead(oa) {}
 	bool operator()(const ld::Atom* atom) const {
 		return ( _dead.count(atom) != 0 );
 	}
 private:
-	const std::set<const ld::Atom*>& _dead;
+	const AtomSet& _dead;
 };
 
 struct AtomSorter
@@ -1334,9 +1356,9 @@ static void optimizeCategories(const std::vector<const ld::Atom*>& categories,
 							   const char* onClassName,
 							   const typename MethodListAtom<A>::ListFormat methodListFormat,
 							   NameToAtom& selectorNameToSlot,
-							   std::set<const ld::Atom*>& deadAtoms,
-							   std::map<const ld::Atom*, const ld::Atom*>& categoryToListElement,
-							   std::map<const ld::Atom*, const ld::Atom*>& categoryToNlListElement,
+							   AtomSet& deadAtoms,
+							   AtomToAtom& categoryToListElement,
+							   AtomToAtom& categoryToNlListElement,
 							   bool usesAuthPtrs,
 							   bool log) {
 
@@ -1533,7 +1555,7 @@ static void removeIneligiblePatching(ld::Internal& state,
 // Finally, for a given class, and any aliases, the class can only be interposed if all references to the class/aliases are
 // via pointers.  We can't patch direct references in code such as adrp/add in arm64
 template <typename A>
-void optimizeClassPatching(const Options& opts, ld::Internal& state, const std::set<const ld::Atom*>& classDefAtoms)
+void optimizeClassPatching(const Options& opts, ld::Internal& state, const AtomSet& classDefAtoms)
 {
 	// To support more efficient objc patching in the shared cache, objc classes should be -interposable
 	if ( classDefAtoms.empty() )
@@ -1800,7 +1822,7 @@ static const std::string_view selectorRefName(const ld::Atom* selRefAtom, const
 template <typename A>
 void OptimizeCategories<A>::doit(const Options& opts, ld::Internal& state, bool haveCategoriesWithoutClassPropertyStorage)
 {
-	std::set<const ld::Atom*> deadAtoms;
+	AtomSet deadAtoms;
 	static const bool log = false;
 #if SUPPORT_ARCH_arm64e
 	const bool usesAuthPtrs = opts.supportsAuthenticatedPointers();
@@ -1812,9 +1834,9 @@ void OptimizeCategories<A>::doit(const Options& opts, ld::Internal& state, bool
 																    : (usesAuthPtrs ? MethodListAtom<A>::threePointersAuthImpl : MethodListAtom<A>::threePointers);
 
 	// find all category atoms and the class they apply to
-	std::map<const ld::Atom*, const ld::Atom*> categoryToClassAtoms;
-	std::map<const ld::Atom*, const ld::Atom*> categoryToListElement;
-	std::map<const ld::Atom*, const ld::Atom*> categoryToNlListElement;
+	AtomToAtom categoryToClassAtoms;
+	AtomToAtom categoryToListElement;
+	AtomToAtom categoryToNlListElement;
 	for (ld::Internal::FinalSection* sect : state.sections) {
 		if ( sect->type() == ld::Section::typeObjC2CategoryList ) {
 			bool isNonLazyCategory = (strcmp(sect->sectionName(), "__objc_nlcatlist") == 0);
@@ -1856,9 +1878,9 @@ void OptimizeCategories<A>::doit(const Options& opts, ld::Internal& state, bool
 	}
 
 	// find all class definition atoms
-	std::set<const ld::Atom*> classDefAtoms;
-	std::set<const ld::Atom*> nlClassDefAtoms;
-	std::map<const ld::Atom*, unsigned> classDefToPlusLoadCount;
+	AtomSet classDefAtoms;
+	AtomSet nlClassDefAtoms;
+	std::unordered_map<const ld::Atom*, unsigned> classDefToPlusLoadCount;
 	for (ld::Internal::FinalSection* sect : state.sections) {
 		if ( strncmp(sect->segmentName(), "__DATA", 6) != 0 )
 			continue;
@@ -1885,11 +1907,11 @@ void OptimizeCategories<A>::doit(const Options& opts, ld::Internal& state, bool
 	}
 
 	// build map of all categories on each class
-	typedef std::map<const ld::Atom*, std::vector<const ld::Atom*>> ClassToCategories;
+	typedef std::unordered_map<const ld::Atom*, std::vector<const ld::Atom*>> ClassToCategories;
 	ClassToCategories classDefsToCategories;
 	ClassToCategories externalClassToLazyCategories;
 	ClassToCategories externalClassToNonLazyCategories;
-	std::set<const ld::Atom*> externalClassAtoms;
+	AtomSet externalClassAtoms;
 	for (const auto& mapEntry : categoryToClassAtoms) {
 		const ld::Atom* categoryAtom = mapEntry.first;
 		const ld::Atom* onClassAtom  = mapEntry.second;
@@ -1970,41 +1992,81 @@ void OptimizeCategories<A>::doit(const Options& opts, ld::Internal& state, bool
 			orderedClasses.push_back(atom);
 		std::sort(orderedClasses.begin(), orderedClasses.end(), AtomSorter());
 
-		// now walk class in order and optimize method lists
-		for (const ld::Atom* classAtom : orderedClasses) {
-			const ld::Atom* classNameAtom = Class<A>::getName(state, classAtom);
-			const char* className = "";
-			if ( classNameAtom != nullptr )
-				className = (char*)classNameAtom->rawContentPointer();
-			if (log) fprintf(stderr,"updating method lists in class %s\n", className);
-			std::vector<const ld::Atom*>* categories = nullptr;
-			if ( classDefsToCategories.count(classAtom) && opts.objcCategoryMerging() ) {
-				categories = &classDefsToCategories[classAtom];
-				std::sort(categories->begin(), categories->end(), AtomSorter());
-			}
-			bool classUsesRelMethodList = Class<A>::usesRelMethodLists(state, classAtom);
-			bool needToRewriteMethodList = ( classUsesRelMethodList != opts.useObjCRelativeMethodLists() );
-			
-			// if any category adds instance methods, generate new merged method list, and replace
-			bool categoriesHaveInstanceMethods = OptimizeCategories<A>::hasInstanceMethods(state, categories);
-			if ( needToRewriteMethodList || categoriesHaveInstanceMethods ) {
-				const ld::Atom* baseInstanceMethodListAtom = Class<A>::getInstanceMethodList(state, classAtom);
-				if ( (baseInstanceMethodListAtom != nullptr) || categoriesHaveInstanceMethods ) {
-					const ld::Atom* newInstanceMethodListAtom = new MethodListAtom<A>(state, baseInstanceMethodListAtom, methodListFormat, MethodListAtom<A>::classMethodList,
-																				  className, false, categories, selectorNameToSlot, deadAtoms);
-					Class<A>::setInstanceMethodList(state, classAtom, newInstanceMethodListAtom, usesAuthPtrs, deadAtoms);
+		// gather the merged method lists of all classes in parallel, which only reads existing atoms,
+		// then make the new atoms in class order so the output does not depend on threading
+		struct ClassPlan {
+			const char*						className = "";
+			std::vector<const ld::Atom*>*	categories = nullptr;
+			bool							newInstanceMethodList = false;
+			bool							newClassMethodList = false;
+			MethodListContent				instanceMethods;
+			MethodListContent				classMethods;
+			const char*						exception = nullptr;
+		};
+		__block std::vector<ClassPlan> plans(orderedClasses.size());
+		for (size_t index=0; index < orderedClasses.size(); ++index) {
+			auto pos = classDefsToCategories.find(orderedClasses[index]);
+			if ( (pos != classDefsToCategories.end()) && opts.objcCategoryMerging() )
+				plans[index].categories = &pos->second;
+		}
+		const ld::Atom* const* classAtoms = orderedClasses.data();
+		const bool useRelMethodLists = opts.useObjCRelativeMethodLists();
+		dispatch_apply(plans.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
+			ClassPlan& plan = plans[index];
+			const ld::Atom* classAtom = classAtoms[index];
+			try {
+				if ( const ld::Atom* classNameAtom = Class<A>::getName(state, classAtom) )
+					plan.className = (char*)classNameAtom->rawContentPointer();
+				if ( plan.categories != nullptr )
+					std::sort(plan.categories->begin(), plan.categories->end(), AtomSorter());
+				bool classUsesRelMethodList = Class<A>::usesRelMethodLists(state, classAtom);
+				bool needToRewriteMethodList = ( classUsesRelMethodList != useRelMethodLists );
+
+				// if any category adds instance methods, generate new merged method list
+				bool categoriesHaveInstanceMethods = OptimizeCategories<A>::hasInstanceMethods(state, plan.categories);
+				if ( needToRewriteMethodList || categoriesHaveInstanceMethods ) {
+					const ld::Atom* baseInstanceMethodListAtom = Class<A>::getInstanceMethodList(state, classAtom);
+					if ( (baseInstanceMethodListAtom != nullptr) || categoriesHaveInstanceMethods ) {
+						plan.instanceMethods = MethodListAtom<A>::gatherContent(state, baseInstanceMethodListAtom, MethodListAtom<A>::classMethodList,
+																				plan.className, false, plan.categories);
+						plan.newInstanceMethodList = true;
+					}
 				}
-			}
-			// if any category adds class methods, generate new merged method list, and replace
-			bool categoriesHaveClassMethods = OptimizeCategories<A>::hasClassMethods(state, categories);
-			if ( needToRewriteMethodList || categoriesHaveClassMethods ) {
-				const ld::Atom* baseClassMethodListAtom = Class<A>::getClassMethodList(state, classAtom);
-				if ( (baseClassMethodListAtom != nullptr) || categoriesHaveClassMethods ) {
-					const ld::Atom* newClassMethodListAtom = new MethodListAtom<A>(state, baseClassMethodListAtom, methodListFormat, MethodListAtom<A>::classMethodList,
-																				className, true, categories, selectorNameToSlot, deadAtoms);
-					Class<A>::setClassMethodList(state, classAtom, newClassMethodListAtom, usesAuthPtrs, deadAtoms);
+				// if any category adds class methods, generate new merged method list
+				bool categoriesHaveClassMethods = OptimizeCategories<A>::hasClassMethods(state, plan.categories);
+				if ( needToRewriteMethodList || categoriesHaveClassMethods ) {
+					const ld::Atom* baseClassMethodListAtom = Class<A>::getClassMethodList(state, classAtom);
+					if ( (baseClassMethodListAtom != nullptr) || categoriesHaveClassMethods ) {
+						plan.classMethods = MethodListAtom<A>::gatherContent(state, baseClassMethodListAtom, MethodListAtom<A>::classMethodList,
+																			 plan.className, true, plan.categories);
+						plan.newClassMethodList = true;
+					}
 				}
 			}
+			catch (const char* msg) {
+				plan.exception = msg;
+			}
+		});
+
+		// now walk class in order and replace method lists
+		for (size_t index=0; index < plans.size(); ++index) {
+			const ClassPlan& plan = plans[index];
+			if ( plan.exception != nullptr )
+				throw plan.exception;
+			const ld::Atom* classAtom = orderedClasses[index];
+			const char* className = plan.className;
+			if (log) fprintf(stderr,"updating method lists in class %s\n", className);
+			std::vector<const ld::Atom*>* categories = plan.categories;
+			if ( plan.newInstanceMethodList ) {
+				const ld::Atom* newInstanceMethodListAtom = new MethodListAtom<A>(state, plan.instanceMethods, methodListFormat, MethodListAtom<A>::classMethodList,
+																				  selectorNameToSlot, deadAtoms);
+				Class<A>::setInstanceMethodList(state, classAtom, newInstanceMethodListAtom, usesAuthPtrs, deadAtoms);
+			}
+			if ( plan.newClassMethodList ) {
+				const ld::Atom* newClassMethodListAtom = new MethodListAtom<A>(state, plan.classMethods, methodListFormat, MethodListAtom<A>::classMethodList,
+																			   selectorNameToSlot, deadAtoms);
+				Class<A>::setClassMethodList(state, classAtom, newClassMethodListAtom, usesAuthPtrs, deadAtoms);
+			}
 			if ( categories == nullptr )
 				continue;
 			// if any category adds protocols, generate new merged protocol list, and replace
@@ -2192,8 +2254,8 @@ static void forEachMethod(ld::Internal& state, const ld::Atom* categoryMethodLis
 	const uint32_t ptrSize 			= sizeof(typename A::P::uint_t);
 	const bool     isProtocolList 	= (entrySize == 2*ptrSize);
 	const bool     relMethodList 	= MethodList<A>::usesRelativeMethodList(state, categoryMethodListAtom);
-	MethodEntryInfo methods[count];
-	bzero(methods, sizeof(methods));
+	// not a stack array, lists can be large and this may run on a worker thread
+	std::vector<MethodEntryInfo> methods(count);
 	if ( entrySize == 1)
 		MethodList<A>::elementSize(state, categoryMethodListAtom);
 
@@ -2298,26 +2360,53 @@ static void forEachMethod(ld::Internal& state, const ld::Atom* categoryMethodLis
 template <typename A> 
 MethodListAtom<A>::MethodListAtom(ld::Internal& state, const ld::Atom* baseMethodList, MethodListAtom<A>::ListFormat kind, MethodListAtom<A>::ListUse use,
 								  const char* className, bool meta, const std::vector<const ld::Atom*>* categories, NameToAtom& selectorNameToSlot,
-								  std::set<const ld::Atom*>& deadAtoms)
+								  AtomSet& deadAtoms)
+  : MethodListAtom(state, gatherContent(state, baseMethodList, use, className, meta, categories), kind, use, selectorNameToSlot, deadAtoms)
+{
+}
+
+template <typename A> 
+MethodListAtom<A>::MethodListAtom(ld::Internal& state, const MethodListContent& content, MethodListAtom<A>::ListFormat kind, MethodListAtom<A>::ListUse use,
+								  NameToAtom& selectorNameToSlot, AtomSet& deadAtoms)
   : ld::Atom((kind == threeDeltas) ? _s_section_rel : _s_section_ptrs,
 			ld::Atom::definitionRegular, ld::Atom::combineNever,
 			ld::Atom::scopeTranslationUnit, ld::Atom::typeUnclassified,
-			symbolTableIn, false, false, false, ld::Atom::Alignment(3)), _file(NULL), _methodCount(0), _listFormat(kind), _listUse(use)
+			symbolTableIn, false, false, false, ld::Atom::Alignment(3)), _file(content.file), _name(content.name),
+			_methodCount((unsigned int)content.methods.size()), _listFormat(kind), _listUse(use)
+{
+	for (const std::string& message : content.warnings)
+		warning("%s", message.c_str());
+	for (const ld::Atom* methodList : content.sourceLists)
+		deadAtoms.insert(methodList);
+
+	// build fixups for merged method list
+	for (uint32_t methodIndex=0; methodIndex < _methodCount; ++methodIndex)
+		appendMethod(methodIndex, content.methods[methodIndex], state, selectorNameToSlot);
+	
+	// add new method list to final sections
+	state.addAtom(*this);
+}
+
+template <typename A> 
+MethodListContent MethodListAtom<A>::gatherContent(ld::Internal& state, const ld::Atom* baseMethodList, MethodListAtom<A>::ListUse use, const char* className,
+												   bool meta, const std::vector<const ld::Atom*>* categories)
 {
 	static const bool log = false;
+	__block MethodListContent content;
 	__block CStringSet baseMethodListMethodNames;
 	__block CStringSet categoryMethodNames;
-	__block std::vector<const ld::Atom*> reverseMethodLists;
+	std::vector<std::vector<MethodEntryInfo>> listMethods;
 	if ( baseMethodList != NULL ) {
 		// if base class has method list, then associate new method list with file defining class
-		_file = baseMethodList->file();
-		reverseMethodLists.push_back(baseMethodList);
-		deadAtoms.insert(baseMethodList);
+		content.file = baseMethodList->file();
+		content.sourceLists.push_back(baseMethodList);
+		__block std::vector<MethodEntryInfo> methods;
 		forEachMethod<A>(state, baseMethodList,^(const MethodEntryInfo& method) {
 			baseMethodListMethodNames.insert(method.methodName);
-			++_methodCount;
+			methods.push_back(method);
 			if (log) fprintf(stderr, "base:     '%s'\n", method.methodName);
 		});
+		listMethods.push_back(std::move(methods));
 	}
 	std::string name;
 	if ( className == NULL )
@@ -2336,7 +2425,7 @@ MethodListAtom<A>::MethodListAtom(ld::Internal& state, const ld::Atom* baseMetho
 		}
 		suffix += ")";
 	}
-	switch ( _listUse ) {
+	switch ( use ) {
 		case classMethodList:
 		case categoryMethodList:
 			if ( meta )
@@ -2351,7 +2440,7 @@ MethodListAtom<A>::MethodListAtom(ld::Internal& state, const ld::Atom* baseMetho
 				name = std::string("__OBJC_$_PROP_LIST_") + className + suffix;
 			break;
 	}
-	_name = strdup(name.c_str());
+	content.name = strdup(name.c_str());
 
 	if ( categories != nullptr ) {
 		for (const ld::Atom* aCategory : *categories) {
@@ -2377,44 +2466,42 @@ MethodListAtom<A>::MethodListAtom(ld::Internal& state, const ld::Atom* baseMetho
 					break;
 			}
 			if ( methodListAtom != nullptr ) {
+				__block std::vector<MethodEntryInfo> methods;
 				forEachMethod<A>(state, methodListAtom,^(const MethodEntryInfo& method) {
-					++_methodCount;
+					char* message;
 					if ( baseMethodListMethodNames.count(method.methodName) != 0 ) {
-						warning("method '%s%s' in category from %s overrides method from class in %s",
+						asprintf(&message, "method '%s%s' in category from %s overrides method from class in %s",
 							(meta ? "+" : "-"), method.methodName,
 							methodListAtom->safeFilePath(), baseMethodList->safeFilePath() );
+						content.warnings.push_back(message);
+						free(message);
 					}
 					if ( categoryMethodNames.count(method.methodName) != 0 ) {
-						warning("method '%s%s' in category from %s conflicts with same method from another category",
+						asprintf(&message, "method '%s%s' in category from %s conflicts with same method from another category",
 							(meta ? "+" : "-"), method.methodName,
 							methodListAtom->safeFilePath());
+						content.warnings.push_back(message);
+						free(message);
 					}
 					categoryMethodNames.insert(method.methodName);
+					methods.push_back(method);
 					if (log) fprintf(stderr, "category: '%s'\n", method.methodName);
 				});
-				reverseMethodLists.push_back(methodListAtom);
-				deadAtoms.insert(methodListAtom);
+				listMethods.push_back(std::move(methods));
+				content.sourceLists.push_back(methodListAtom);
 				// if base class did not have method list, associate new method list with file the defined category
-				if ( _file == NULL )
-					_file = methodListAtom->file();
+				if ( content.file == NULL )
+					content.file = methodListAtom->file();
 			}
 		}
 	}
-	if (log) fprintf(stderr, "total method count in merged list %u\n\n", _methodCount);
-	
-	// build fixups for merged method list (in reverse order to match what objc runtime would do)
-	__block uint32_t methodIndex = 0;
-	while ( !reverseMethodLists.empty() ) {
-		const ld::Atom* methodList = reverseMethodLists.back();
-		forEachMethod<A>(state, methodList,^(const MethodEntryInfo& method) {
-			appendMethod(methodIndex, method, state, selectorNameToSlot);
-			++methodIndex;
-		});
-		reverseMethodLists.pop_back();
-	}
-	
-	// add new method list to final sections
-	state.addAtom(*this);
+
+	// merged method list is in reverse order to match what objc runtime would do
+	for (auto it = listMethods.rbegin(); it != listMethods.rend(); ++it)
+		content.methods.insert(content.methods.end(), it->begin(), it->end());
+	if (log) fprintf(stderr, "total method count in merged list %lu\n\n", content.methods.size());
+
+	return content;
 }
 
 
@@ -2530,7 +2617,7 @@ void MethodListAtom<A>::copyRawContent(uint8_t buffer[]) const
 
 template <typename A>
 ProtocolListAtom<A>::ProtocolListAtom(ld::Internal& state, const ld::Atom* baseProtocolList, const char* className,
-									const std::vector<const ld::Atom*>* categories, std::set<const ld::Atom*>& deadAtoms)
+									const std::vector<const ld::Atom*>* categories, AtomSet& deadAtoms)
   : ld::Atom(_s_section, ld::Atom::definitionRegular, ld::Atom::combineNever,
 			ld::Atom::scopeLinkageUnit, ld::Atom::typeUnclassified,
 			symbolTableIn, false, false, false, ld::Atom::Alignment(3)), _file(NULL), _protocolCount(0)
@@ -2605,7 +2692,7 @@ ProtocolListAtom<A>::ProtocolListAtom(ld::Internal& state, const ld::Atom* baseP
 
 template <typename A>
 PropertyListAtom<A>::PropertyListAtom(ld::Internal& state, const ld::Atom* basePropertyList,
-				      const std::vector<const ld::Atom*>* categories, std::set<const ld::Atom*>& deadAtoms, PropertyKind kind)
+				      const std::vector<const ld::Atom*>* categories, AtomSet& deadAtoms, PropertyKind kind)
   : ld::Atom(_s_section, ld::Atom::definitionRegular, ld::Atom::combineNever,
 			ld::Atom::scopeLinkageUnit, ld::Atom::typeUnclassified,
 			symbolTableNotIn, false, false, false, ld::Atom::Alignment(3)), _file(NULL), _propertyCount(0)
@@ -0,0 +1,164 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+
+#include <stdint.h>
+#include <dispatch/dispatch.h>
+
+#include <vector>
+
+#include "ld.hpp"
+#include "references.h"
+#include "configure.h"
+
+namespace ld {
+namespace passes {
+namespace references {
+
+// direct branches which the stubs pass may route through a stub
+static bool isBranch(ld::Fixup::Kind kind)
+{
+	switch ( kind ) {
+		case ld::Fixup::kindStoreTargetAddressX86BranchPCRel32:
+		case ld::Fixup::kindStoreTargetAddressARMBranch24:
+		case ld::Fixup::kindStoreTargetAddressThumbBranch22:
+#if SUPPORT_ARCH_arm64
+		case ld::Fixup::kindStoreTargetAddressARM64Branch26:
+#endif
+			return true;
+		default:
+			return false;
+	}
+}
+
+// loads through a GOT slot, or uses of the GOT slot of a personality function
+static bool isGOTUse(ld::Fixup::Kind kind)
+{
+	switch ( kind ) {
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoad:
+		case ld::Fixup::kindStoreX86PCRel32GOT:
+		case ld::Fixup::kindNoneGroupSubordinatePersonality:
+#if SUPPORT_ARCH_arm64
+		case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPage21:
+		case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPageOff12:
+		case ld::Fixup::kindStoreARM64PCRelToGOT:
+#endif
+#if SUPPORT_ARCH_riscv32
+		case ld::Fixup::kindStoreRISCVhi20PCRelGOT:
+		case ld::Fixup::kindStoreRISCVlo12PCRelGOT:
+		case ld::Fixup::kindStoreRISCVhi20GOT:
+		case ld::Fixup::kindStoreRISCVlo12GOT:
+#endif
+			return true;
+		default:
+			return false;
+	}
+}
+
+// loads of a thread local variable through its TLV pointer
+static bool isTLVLoad(ld::Fixup::Kind kind)
+{
+	switch ( kind ) {
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoad:
+		case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoad:
+		case ld::Fixup::kindStoreX86PCRel32TLVLoad:
+		case ld::Fixup::kindStoreX86Abs32TLVLoad:
+#if SUPPORT_ARCH_arm64
+		case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPage21:
+		case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPageOff12:
+#endif
+			return true;
+		default:
+			return false;
+	}
+}
+
+void doPass(const Options& opts, ld::Internal& internal)
+{
+	ld::Internal::ReferenceLists& lists = internal.referenceLists;
+	lists = ld::Internal::ReferenceLists();
+
+	// stubs, GOT and TLV passes do nothing in -r mode
+	if ( opts.outputKind() == Options::kObjectFile )
+		return;
+
+	// atoms made later by the stubs, inits and huge passes have no branches to stub, GOT loads
+	// or TLV loads, so lists made here stay complete until the TLV pass is done
+	// classify each section on its own thread, then concatenate the results in section
+	// order so the passes see atoms in the same order as when they walked all sections
+	const size_t sectionCount = internal.sections.size();
+	__block std::vector<ld::Internal::ReferenceLists> perSection(sectionCount);
+	dispatch_apply(sectionCount, DISPATCH_APPLY_AUTO, ^(size_t index) {
+		ld::Internal::ReferenceLists& result = perSection[index];
+		for (const ld::Atom* atom : internal.sections[index]->atoms) {
+			result.totalAtomSize += atom->size();
+			if ( atom->contentType() == ld::Atom::typeResolver )
+				result.resolvers.push_back(atom);
+			bool usesStub = false;
+			bool usesGOT  = false;
+			bool usesTLV  = false;
+			for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+				if ( isBranch(fit->kind) ) {
+					usesStub = true;
+				}
+				else if ( fit->binding == ld::Fixup::bindingsIndirectlyBound ) {
+					// any pointer to a resolver needs to change to pointer to stub
+					const ld::Atom* target = internal.indirectBindingTable[fit->u.bindingIndex];
+					if ( (target != NULL) && (target->contentType() == ld::Atom::typeResolver) )
+						usesStub = true;
+				}
+				if ( isGOTUse(fit->kind) )
+					usesGOT = true;
+				else if ( isTLVLoad(fit->kind) )
+					usesTLV = true;
+			}
+			if ( usesStub )
+				result.stubReferencers.push_back(atom);
+			if ( usesGOT )
+				result.gotReferencers.push_back(atom);
+			if ( usesTLV )
+				result.tlvReferencers.push_back(atom);
+		}
+	});
+
+	for (const ld::Internal::ReferenceLists& result : perSection) {
+		lists.totalAtomSize += result.totalAtomSize;
+		lists.stubReferencers.insert(lists.stubReferencers.end(), result.stubReferencers.begin(), result.stubReferencers.end());
+		lists.gotReferencers.insert(lists.gotReferencers.end(), result.gotReferencers.begin(), result.gotReferencers.end());
+		lists.tlvReferencers.insert(lists.tlvReferencers.end(), result.tlvReferencers.begin(), result.tlvReferencers.end());
+		lists.resolvers.insert(lists.resolvers.end(), result.resolvers.begin(), result.resolvers.end());
+	}
+	lists.valid = true;
+}
+
+void releaseLists(ld::Internal& internal)
+{
+	internal.referenceLists = ld::Internal::ReferenceLists();
+}
+
+
+} // namespace references
+} // namespace passes 
+} // namespace ld 
@@ -0,0 +1,65 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2022 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifndef __REFERENCES_H__
+#define __REFERENCES_H__
+
+#include "Options.h"
+#include "ld.hpp"
+
+
+namespace ld {
+namespace passes {
+namespace references {
+
+// called by linker before the stubs pass to find, in one scan over all fixups, which atoms
+// the stubs, GOT and TLV passes need to look at
+extern void doPass(const Options& opts, ld::Internal& internal);
+
+// called by the last pass using the lists
+extern void releaseLists(ld::Internal& internal);
+
+// calls handler on each atom in a list made by doPass(), or on every atom if the lists were not made
+template <typename H>
+void forEachAtom(const ld::Internal& internal, std::vector<const ld::Atom*> ld::Internal::ReferenceLists::* list, H handler)
+{
+	if ( internal.referenceLists.valid ) {
+		for (const ld::Atom* atom : internal.referenceLists.*list)
+			handler(atom);
+	}
+	else {
+		for (const ld::Internal::FinalSection* sect : internal.sections) {
+			for (const ld::Atom* atom : sect->atoms)
+				handler(atom);
+		}
+	}
+}
+
+
+} // namespace references
+} // namespace passes 
+} // namespace ld 
+
+#endif // __REFERENCES_H__
@@ -39,6 +39,7 @@
 #include "ld.hpp"
 
 #include "make_stubs.h"
+#include "../references.h"
 
 
 namespace ld {
@@ -325,14 +326,10 @@ ld::Atom* Pass::makeStub(const ld::Atom& target, bool weakImport)
 
 void Pass::verifyNoResolverFunctions(ld::Internal& state)
 {
-	for (std::vector<ld::Internal::FinalSection*>::iterator sit=state.sections.begin(); sit != state.sections.end(); ++sit) {
-		ld::Internal::FinalSection* sect = *sit;
-		for (std::vector<const ld::Atom*>::iterator ait=sect->atoms.begin();  ait != sect->atoms.end(); ++ait) {
-			const ld::Atom* atom = *ait;
-			if ( atom->contentType() == ld::Atom::typeResolver ) 
-				throwf("resolver function '%s' not supported in type of output", atom->name());
-		}
-	}
+	ld::passes::references::forEachAtom(state, &ld::Internal::ReferenceLists::resolvers, [&](const ld::Atom* atom) {
+		if ( atom->contentType() == ld::Atom::typeResolver ) 
+			throwf("resolver function '%s' not supported in type of output", atom->name());
+	});
 }
 
 struct StubTargetInfo {
@@ -369,51 +366,49 @@ void Pass::process(ld::Internal& state)
 			break;
 	}
 	
-	// walk all atoms and fixups looking for stubable references
+	// walk atoms with branches or pointers to resolvers looking for stubable references
 	// don't create stubs inline because that could invalidate the sections iterator
 	Map<const ld::Atom*, StubTargetInfo> infoForAtom;
-	uint64_t codeSize = 0;
-	for (const ld::Internal::FinalSection* sect : state.sections) {
-		for (const ld::Atom* atom: sect->atoms) {
-			codeSize += atom->size();
-			for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
-				const ld::Atom* stubableTargetOfFixup = stubableFixup(fit, state);
-				if ( stubableTargetOfFixup != NULL ) {
-					const auto& [pos, inserted] = infoForAtom.try_emplace(stubableTargetOfFixup);
-					pos->second.references.push_back(fit);
-
-					if ( inserted ) {
-						// new entry, set weak import
-						pos->second.weakImport = fit->weakImport;
-					} else if ( pos->second.weakImport != fit->weakImport ) {
-						// handle weak import mismatch
-						switch ( _options.weakReferenceMismatchTreatment() ) {
-							case Options::kWeakReferenceMismatchError:
-								throwf("mismatching weak references for symbol: %s", stubableTargetOfFixup->name());
-							case Options::kWeakReferenceMismatchWeak:
-								pos->second.weakImport = true;
-								break;
-							case Options::kWeakReferenceMismatchNonWeak:
-								pos->second.weakImport = false;
-								break;
-						}
+	ld::passes::references::forEachAtom(state, &ld::Internal::ReferenceLists::stubReferencers, [&](const ld::Atom* atom) {
+		for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+			const ld::Atom* stubableTargetOfFixup = stubableFixup(fit, state);
+			if ( stubableTargetOfFixup != NULL ) {
+				const auto& [pos, inserted] = infoForAtom.try_emplace(stubableTargetOfFixup);
+				pos->second.references.push_back(fit);
+
+				if ( inserted ) {
+					// new entry, set weak import
+					pos->second.weakImport = fit->weakImport;
+				} else if ( pos->second.weakImport != fit->weakImport ) {
+					// handle weak import mismatch
+					switch ( _options.weakReferenceMismatchTreatment() ) {
+						case Options::kWeakReferenceMismatchError:
+							throwf("mismatching weak references for symbol: %s", stubableTargetOfFixup->name());
+						case Options::kWeakReferenceMismatchWeak:
+							pos->second.weakImport = true;
+							break;
+						case Options::kWeakReferenceMismatchNonWeak:
+							pos->second.weakImport = false;
+							break;
 					}
 				}
 			}
-			// all resolver functions must have a corresponding stub
-			if ( atom->contentType() == ld::Atom::typeResolver ) {
-				if ( _options.outputKind() != Options::kDynamicLibrary ) 
-					throwf("resolver functions (%s) can only be used in dylibs", atom->name());
-				if ( !_options.makeCompressedDyldInfo() && !_options.makeChainedFixups() ) {
-					if ( _options.architecture() == CPU_TYPE_ARM )
-						throwf("resolver functions (%s) can only be used when targeting iOS 4.2 or later", atom->name());
-					else
-						throwf("resolver functions (%s) can only be used when targeting Mac OS X 10.6 or later", atom->name());
-				}
-				infoForAtom.try_emplace(atom);
+		}
+	});
+	// all resolver functions must have a corresponding stub
+	ld::passes::references::forEachAtom(state, &ld::Internal::ReferenceLists::resolvers, [&](const ld::Atom* atom) {
+		if ( atom->contentType() == ld::Atom::typeResolver ) {
+			if ( _options.outputKind() != Options::kDynamicLibrary ) 
+				throwf("resolver functions (%s) can only be used in dylibs", atom->name());
+			if ( !_options.makeCompressedDyldInfo() && !_options.makeChainedFixups() ) {
+				if ( _options.architecture() == CPU_TYPE_ARM )
+					throwf("resolver functions (%s) can only be used when targeting iOS 4.2 or later", atom->name());
+				else
+					throwf("resolver functions (%s) can only be used when targeting Mac OS X 10.6 or later", atom->name());
 			}
+			infoForAtom.try_emplace(atom);
 		}
-	}
+	});
 
 	const bool needStubForMain = _options.needsEntryPointLoadCommand() 
 								&& (state.entryPoint != NULL) 
@@ -436,6 +431,13 @@ void Pass::process(ld::Internal& state)
 
 	// disable arm close stubs in some cases
 	if ( _architecture == CPU_TYPE_ARM ) {
+		uint64_t codeSize = state.referenceLists.totalAtomSize;
+		if ( !state.referenceLists.valid ) {
+			for (const ld::Internal::FinalSection* sect : state.sections) {
+				for (const ld::Atom* atom : sect->atoms)
+					codeSize += atom->size();
+			}
+		}
         if ( codeSize > 4*1024*1024 )
             _largeText = true;
         else {
@@ -34,6 +34,7 @@
 
 #include "ld.hpp"
 #include "tlvp.h"
+#include "references.h"
 
 namespace ld {
 namespace passes {
@@ -117,57 +118,55 @@ void doPass(const Options& opts, ld::Internal& internal)
 
 	const unsigned ptrSize = (opts.architecture() == CPU_TYPE_ARM64_32) ? 4 : 8;
 
-	// walk all atoms and fixups looking for TLV references and add them to list
+	// walk atoms with TLV loads looking for TLV references and add them to list
 	std::vector<TlVReferenceCluster>	references;
-	for (std::vector<ld::Internal::FinalSection*>::iterator sit=internal.sections.begin(); sit != internal.sections.end(); ++sit) {
-		ld::Internal::FinalSection* sect = *sit;
-		for (std::vector<const ld::Atom*>::iterator ait=sect->atoms.begin(); ait != sect->atoms.end(); ++ait) {
-			const ld::Atom* atom = *ait;
-			TlVReferenceCluster ref;
-			for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
-				if ( fit->firstInCluster() ) {
-					ref.targetOfTLV = NULL;
-					ref.fixupWithTarget = NULL;
-					ref.fixupWithTLVStore = NULL;
-				}
-				switch ( fit->binding ) {
-					case ld::Fixup::bindingsIndirectlyBound:
-						ref.targetOfTLV = internal.indirectBindingTable[fit->u.bindingIndex];
-						ref.fixupWithTarget = fit;
-						break;
-					case ld::Fixup::bindingDirectlyBound:
-						ref.targetOfTLV = fit->u.target;
-						ref.fixupWithTarget = fit;
-						break;
+	ld::passes::references::forEachAtom(internal, &ld::Internal::ReferenceLists::tlvReferencers, [&](const ld::Atom* atom) {
+		TlVReferenceCluster ref;
+		for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+			if ( fit->firstInCluster() ) {
+				ref.targetOfTLV = NULL;
+				ref.fixupWithTarget = NULL;
+				ref.fixupWithTLVStore = NULL;
+			}
+			switch ( fit->binding ) {
+				case ld::Fixup::bindingsIndirectlyBound:
+					ref.targetOfTLV = internal.indirectBindingTable[fit->u.bindingIndex];
+					ref.fixupWithTarget = fit;
+					break;
+				case ld::Fixup::bindingDirectlyBound:
+					ref.targetOfTLV = fit->u.target;
+					ref.fixupWithTarget = fit;
+					break;
                     default:
                         break;    
-				}
-				switch ( fit->kind ) {
-					case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoad:
-					case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoad:
-					case ld::Fixup::kindStoreX86PCRel32TLVLoad:
-					case ld::Fixup::kindStoreX86Abs32TLVLoad:
+			}
+			switch ( fit->kind ) {
+				case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoad:
+				case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoad:
+				case ld::Fixup::kindStoreX86PCRel32TLVLoad:
+				case ld::Fixup::kindStoreX86Abs32TLVLoad:
 #if SUPPORT_ARCH_arm64
-					case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPage21:
-					case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPageOff12:
+				case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPage21:
+				case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPageOff12:
 #endif
-						ref.fixupWithTLVStore = fit;
-						break;
-					default:
-						break;
-				}
-				if ( fit->lastInCluster() && (ref.fixupWithTLVStore != NULL) ) {
-					ref.optimizable = optimizable(opts, ref.targetOfTLV);
-					if (log) fprintf(stderr, "found reference to TLV at %s+0x%X to %s\n", 
-									atom->name(), ref.fixupWithTLVStore->offsetInAtom, ref.targetOfTLV->name());
-					if ( ! opts.canUseThreadLocalVariables() ) {
-						throwf("targeted OS version does not support use of thread local variables in %s", atom->name());
-					}
-					references.push_back(ref);
+					ref.fixupWithTLVStore = fit;
+					break;
+				default:
+					break;
+			}
+			if ( fit->lastInCluster() && (ref.fixupWithTLVStore != NULL) ) {
+				ref.optimizable = optimizable(opts, ref.targetOfTLV);
+				if (log) fprintf(stderr, "found reference to TLV at %s+0x%X to %s\n", 
+								atom->name(), ref.fixupWithTLVStore->offsetInAtom, ref.targetOfTLV->name());
+				if ( ! opts.canUseThreadLocalVariables() ) {
+					throwf("targeted OS version does not support use of thread local variables in %s", atom->name());
 				}
+				references.push_back(ref);
 			}
 		}
-	}
+	});
+	// this is the last pass using the reference lists
+	ld::passes::references::releaseLists(internal);
 	
 	// compute which TLV references will be weak_imports
 	std::map<const ld::Atom*,bool>		weakImportMap;
@@ -26,6 +26,7 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <dispatch/dispatch.h>
 #include <mach-o/nlist.h>
 #include <mach-o/stab.h>
 #include <mach-o/fat.h>
@@ -50,6 +51,7 @@ static bool			sShowLineInfo			= true;
 static cpu_type_t		sPreferredArch = 0xFFFFFFFF;
 static cpu_subtype_t	sPreferredSubArch = 0xFFFFFFFF;
 static const char* sMatchName = NULL;
+static bool			sJSON		= false;
 static int sPrintRestrict;
 static int sPrintAlign;
 static int sPrintName;
@@ -1254,7 +1256,11 @@ static void dumpFile(ld::relocatable::File* file)
 }
 
 
-static ld::relocatable::File* createReader(const char* path)
+// preferredArch and preferredSubArch are updated to the arch that was picked, so that
+// later files on the command line are dumped for the same arch.  If mapping is not NULL, it is
+// set to the file's mapping as soon as it is made, even if parsing then fails, so the caller can unmap it.
+static ld::relocatable::File* createReader(const char* path, cpu_type_t& preferredArch, cpu_subtype_t& preferredSubArch,
+										   uint8_t** mapping=NULL, uint64_t* mappingLength=NULL)
 {
 	struct stat stat_buf;
 	
@@ -1266,27 +1272,31 @@ static ld::relocatable::File* createReader(const char* path)
 	::close(fd);
 	if ( p == (uint8_t*)(-1) )
 		throwf("cannot mmap file: %s", path);
+	if ( mapping != NULL ) {
+		*mapping = p;
+		*mappingLength = stat_buf.st_size;
+	}
 	const mach_header* mh = (mach_header*)p;
 	uint64_t fileLen = stat_buf.st_size;
 	bool foundFatSlice = false;
 	if ( mh->magic == OSSwapBigToHostInt32(FAT_MAGIC) ) {
 		const struct fat_header* fh = (struct fat_header*)p;
 		const struct fat_arch* archs = (struct fat_arch*)(p + sizeof(struct fat_header));
-		if ( (uint32_t)sPreferredArch ==  0xFFFFFFFF ) {
+		if ( (uint32_t)preferredArch ==  0xFFFFFFFF ) {
 			// just dump first slice of fat .o file
 			if ( OSSwapBigToHostInt32(fh->nfat_arch) > 0 )  {
 				p = p + OSSwapBigToHostInt32(archs[0].offset);
 				mh = (struct mach_header*)p;
 				fileLen = OSSwapBigToHostInt32(archs[0].size);
-				sPreferredArch = OSSwapBigToHostInt32(archs[0].cputype);
-				sPreferredSubArch = OSSwapBigToHostInt32(archs[0].cpusubtype);
+				preferredArch = OSSwapBigToHostInt32(archs[0].cputype);
+				preferredSubArch = OSSwapBigToHostInt32(archs[0].cpusubtype);
 				foundFatSlice = true;
 			}
 		}
 		else {
 			for (unsigned long i=0; i < OSSwapBigToHostInt32(fh->nfat_arch); ++i) {
-				if ( OSSwapBigToHostInt32(archs[i].cputype) == (uint32_t)sPreferredArch ) {
-					if ( ((uint32_t)sPreferredSubArch == 0xFFFFFFFF) || ((uint32_t)sPreferredSubArch == OSSwapBigToHostInt32(archs[i].cpusubtype)) ) {
+				if ( OSSwapBigToHostInt32(archs[i].cputype) == (uint32_t)preferredArch ) {
+					if ( ((uint32_t)preferredSubArch == 0xFFFFFFFF) || ((uint32_t)preferredSubArch == OSSwapBigToHostInt32(archs[i].cpusubtype)) ) {
 						p = p + OSSwapBigToHostInt32(archs[i].offset);
 						mh = (struct mach_header*)p;
 						fileLen = OSSwapBigToHostInt32(archs[i].size);
@@ -1298,11 +1308,11 @@ static ld::relocatable::File* createReader(const char* path)
 		}
 	}
 	else if ( (mh->magic == MH_MAGIC) || (mh->magic == MH_MAGIC_64) ) {
-		sPreferredArch = mh->cputype;
+		preferredArch = mh->cputype;
 	}
 
 	mach_o::relocatable::ParserOptions objOpts;
-	objOpts.architecture		= sPreferredArch;
+	objOpts.architecture		= preferredArch;
 	objOpts.objSubtypeMustMatch = false;
 	objOpts.logAllFiles			= false;
 	objOpts.warnUnwindConversionProblems	= true;
@@ -1313,7 +1323,7 @@ static ld::relocatable::File* createReader(const char* path)
 #if SUPPORT_ARCH_arm64e
 	objOpts.supportsAuthenticatedPointers = true;
 #endif
-	objOpts.subType				= sPreferredSubArch;
+	objOpts.subType				= preferredSubArch;
 	objOpts.treateBitcodeAsData = false;
 	objOpts.usingBitcode		= true;
 	objOpts.forceHidden			= false;
@@ -1335,7 +1345,7 @@ static ld::relocatable::File* createReader(const char* path)
 
 #if 0
 	// see if it is an llvm object file
-	objResult = lto::parse(p, fileLen, path, stat_buf.st_mtime, ld::File::Ordinal::NullOrdinal(), sPreferredArch, sPreferredSubArch, false, true);
+	objResult = lto::parse(p, fileLen, path, stat_buf.st_mtime, ld::File::Ordinal::NullOrdinal(), preferredArch, preferredSubArch, false, true);
 	if ( objResult != NULL ) 
 		return objResult;
 #endif
@@ -1351,6 +1361,117 @@ static ld::relocatable::File* createReader(const char* path)
 #endif
 }
 
+static void appendJSONString(std::string& out, const char* str)
+{
+	out += '"';
+	for (const char* s=str; *s != '\0'; ++s) {
+		unsigned char c = *s;
+		if ( (c == '"') || (c == '\\') ) {
+			out += '\\';
+			out += c;
+		}
+		else if ( c < 0x20 ) {
+			char temp[8];
+			snprintf(temp, sizeof(temp), "\\u%04X", c);
+			out += temp;
+		}
+		else {
+			out += c;
+		}
+	}
+	out += '"';
+}
+
+//
+// Collects the atoms of one file and renders them as JSON, one object per line.
+// Does not touch any global state other than the read-only options, so several
+// files can be rendered at once.
+//
+class jsonDumper : public ld::File::AtomHandler
+{
+public:
+	virtual void doAtom(const ld::Atom& atom) {
+		if ( (sMatchName != NULL) && (strcmp(sMatchName, atom.name()) != 0) )
+			return;
+		_atoms.push_back(&atom);
+	}
+	virtual void doFile(const ld::File&) {}
+	void render(const char* path, std::string& out);
+private:
+	std::vector<const ld::Atom*> _atoms;
+};
+
+void jsonDumper::render(const char* path, std::string& out)
+{
+	if ( sSort )
+		std::sort(_atoms.begin(), _atoms.end(), AtomSorter());
+
+	char temp[128];
+	for (const ld::Atom* atom : _atoms) {
+		out += "{\"file\":";
+		appendJSONString(out, path);
+		out += ",\"name\":";
+		appendJSONString(out, atom->name());
+		out += ",\"segment\":";
+		appendJSONString(out, atom->section().segmentName());
+		out += ",\"section\":";
+		appendJSONString(out, atom->section().sectionName());
+		snprintf(temp, sizeof(temp), ",\"size\":%llu,\"fixups\":%lu,\"align\":%u,\"alignModulus\":%u}\n",
+				atom->size(), (unsigned long)(atom->fixupsEnd() - atom->fixupsBegin()),
+				1U << atom->alignment().powerOf2, atom->alignment().modulus);
+		out += temp;
+	}
+}
+
+//
+// -json mode: parses all files concurrently, then prints the JSON for each file in
+// command line order, so the output is the same no matter how the parsing was scheduled.
+// A file that fails to parse gets an "error" line in its place.
+//
+static bool dumpFilesAsJSON(const std::vector<const char*>& paths)
+{
+	__block std::vector<std::string> results(paths.size());
+	// one byte each, a bit packed vector<bool> would have workers write the same word
+	__block std::vector<uint8_t> failed(paths.size(), false);
+	dispatch_apply(paths.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
+		const char* path = paths[index];
+		// each file picks its own slice, instead of following the first file's arch
+		cpu_type_t arch = sPreferredArch;
+		cpu_subtype_t subArch = sPreferredSubArch;
+		// every file is released once rendered, so a large run does not hold all mappings and atoms
+		uint8_t* mapping = NULL;
+		uint64_t mappingLength = 0;
+		try {
+			ld::relocatable::File* reader = createReader(path, arch, subArch, &mapping, &mappingLength);
+			{
+				jsonDumper d;
+				reader->forEachAtom(d);
+				d.render(path, results[index]);
+			}
+			delete reader;
+		}
+		catch (const char* msg) {
+			std::string& out = results[index];
+			out = "{\"file\":";
+			appendJSONString(out, path);
+			out += ",\"error\":";
+			appendJSONString(out, msg);
+			out += "}\n";
+			failed[index] = true;
+		}
+		if ( mapping != NULL )
+			::munmap(mapping, mappingLength);
+	});
+
+	bool allParsed = true;
+	for (size_t i=0; i < paths.size(); ++i) {
+		fputs(results[i].c_str(), stdout);
+		if ( failed[i] )
+			allParsed = false;
+	}
+	return allParsed;
+}
+
 static
 void
 usage()
@@ -1365,6 +1486,7 @@ usage()
 			"\t-only sym\tonly dump info about sym\n"
 			"\t-align\t\tonly print alignment info\n"
 			"\t-name\t\tonly print symbol names\n"
+			"\t-json\t\tparse all files in parallel and print one JSON object per atom\n"
 		);
 }
 
@@ -1376,6 +1498,7 @@ int main(int argc, const char* argv[])
 	}
 
 	try {
+		std::vector<const char*> paths;
 		for(int i=1; i < argc; ++i) {
 			const char* arg = argv[i];
 			if ( arg[0] == '-' ) {
@@ -1429,16 +1552,26 @@ int main(int argc, const char* argv[])
 					sPrintRestrict = true;
 					sPrintName = true;
 				}
+				else if ( strcmp(arg, "-json") == 0 ) {
+					sJSON = true;
+				}
 				else {
 					usage();
 					throwf("unknown option: %s\n", arg);
 				}
 			}
 			else {
-				ld::relocatable::File* reader = createReader(arg);
-				dumpFile(reader);
+				paths.push_back(arg);
 			}
 		}
+
+		if ( sJSON )
+			return dumpFilesAsJSON(paths) ? 0 : 1;
+
+		for (const char* path : paths) {
+			ld::relocatable::File* reader = createReader(path, sPreferredArch, sPreferredSubArch);
+			dumpFile(reader);
+		}
 	}
 	catch (const char* msg) {
 		fprintf(stderr, "ObjDump failed: %s\n", msg);
@@ -30,14 +30,18 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <dispatch/dispatch.h>
 
 #include <vector>
 #include <set>
 #include <unordered_set>
+#include <string>
+#include <algorithm>
 
 #include "configure.h"
 #include "MachOFileAbstraction.hpp"
 #include "Architectures.hpp"
+#include "parsers/libunwind/DwarfInstructions.hpp"
 
 
  __attribute__((noreturn, format(printf, 1, 2)))
@@ -53,6 +57,154 @@ void throwf(const char* format, ...)
 	throw t;
 }
 
+static bool sVerifyFailed = false;
+
+
+///
+/// ImageAddressSpace is used as a template parameter to libunwind for parsing the
+/// dwarf CFI information of a linked image, by mapping vm addresses to file content.
+///
+template <typename A>
+class ImageAddressSpace
+{
+public:
+		typedef typename A::P::uint_t	pint_t;
+		typedef typename A::P			P;
+		typedef typename A::P::E		E;
+		typedef typename A::P::uint_t	sint_t;
+
+						ImageAddressSpace(const macho_header<P>* header);
+
+		uint8_t			get8(pint_t addr)	{ return *((uint8_t*)mappedAddress(addr)); }
+		uint16_t		get16(pint_t addr)	{ return E::get16(*((uint16_t*)mappedAddress(addr))); }
+		uint32_t		get32(pint_t addr)	{ return E::get32(*((uint32_t*)mappedAddress(addr))); }
+		uint64_t		get64(pint_t addr)	{ return E::get64(*((uint64_t*)mappedAddress(addr))); }
+		pint_t			getP(pint_t addr)	{ return P::getP(*((pint_t*)mappedAddress(addr))); }
+		uint64_t		getULEB128(pint_t& addr, pint_t end);
+		int64_t			getSLEB128(pint_t& addr, pint_t end);
+		pint_t			getEncodedP(pint_t& addr, pint_t end, uint8_t encoding);
+private:
+	struct Segment {
+		pint_t		vmAddr;
+		pint_t		fileSize;
+		uint64_t	fileOffset;
+	};
+
+	const void*			mappedAddress(pint_t addr);
+
+	const uint8_t*				fContent;
+	std::vector<Segment>		fSegments;
+};
+
+template <typename A>
+ImageAddressSpace<A>::ImageAddressSpace(const macho_header<P>* header)
+ : fContent((const uint8_t*)header)
+{
+	const uint32_t cmd_count = header->ncmds();
+	const macho_load_command<P>* cmd = (macho_load_command<P>*)((uint8_t*)header + sizeof(macho_header<P>));
+	for (uint32_t i = 0; i < cmd_count; ++i) {
+		if ( cmd->cmd() == macho_segment_command<P>::CMD ) {
+			const macho_segment_command<P>* segCmd = (const macho_segment_command<P>*)cmd;
+			fSegments.push_back({ (pint_t)segCmd->vmaddr(), (pint_t)segCmd->filesize(), segCmd->fileoff() });
+		}
+		cmd = (const macho_load_command<P>*)(((uint8_t*)cmd)+cmd->cmdsize());
+	}
+}
+
+template <typename A>
+const void* ImageAddressSpace<A>::mappedAddress(pint_t addr)
+{
+	for (const Segment& seg : fSegments) {
+		if ( (seg.vmAddr <= addr) && (addr < seg.vmAddr+seg.fileSize) )
+			return &fContent[seg.fileOffset + addr - seg.vmAddr];
+	}
+	throwf("address 0x%08llX is not in the file", (uint64_t)addr);
+}
+
+template <typename A>
+uint64_t ImageAddressSpace<A>::getULEB128(pint_t& logicalAddr, pint_t end)
+{
+	uintptr_t size = (end - logicalAddr);
+	libunwind::LocalAddressSpace::pint_t laddr = (libunwind::LocalAddressSpace::pint_t)mappedAddress(logicalAddr);
+	libunwind::LocalAddressSpace::pint_t sladdr = laddr;
+	uint64_t result = libunwind::LocalAddressSpace::getULEB128(laddr, laddr+size);
+	logicalAddr += (laddr-sladdr);
+	return result;
+}
+
+template <typename A>
+int64_t ImageAddressSpace<A>::getSLEB128(pint_t& logicalAddr, pint_t end)
+{
+	uintptr_t size = (end - logicalAddr);
+	libunwind::LocalAddressSpace::pint_t laddr = (libunwind::LocalAddressSpace::pint_t)mappedAddress(logicalAddr);
+	libunwind::LocalAddressSpace::pint_t sladdr = laddr;
+	int64_t result = libunwind::LocalAddressSpace::getSLEB128(laddr, laddr+size);
+	logicalAddr += (laddr-sladdr);
+	return result;
+}
+
+template <typename A>
+typename A::P::uint_t ImageAddressSpace<A>::getEncodedP(pint_t& addr, pint_t end, uint8_t encoding)
+{
+	pint_t startAddr = addr;
+	pint_t result;
+
+	// first get value
+	switch (encoding & 0x0F) {
+		case DW_EH_PE_ptr:
+			result = getP(addr);
+			addr += sizeof(pint_t);
+			break;
+		case DW_EH_PE_uleb128:
+			result = getULEB128(addr, end);
+			break;
+		case DW_EH_PE_udata2:
+			result = get16(addr);
+			addr += 2;
+			break;
+		case DW_EH_PE_udata4:
+			result = get32(addr);
+			addr += 4;
+			break;
+		case DW_EH_PE_udata8:
+			result = get64(addr);
+			addr += 8;
+			break;
+		case DW_EH_PE_sleb128:
+			result = getSLEB128(addr, end);
+			break;
+		case DW_EH_PE_sdata2:
+			result = (int16_t)get16(addr);
+			addr += 2;
+			break;
+		case DW_EH_PE_sdata4:
+			result = (int32_t)get32(addr);
+			addr += 4;
+			break;
+		case DW_EH_PE_sdata8:
+			result = get64(addr);
+			addr += 8;
+			break;
+		default:
+			throwf("ImageAddressSpace<A>::getEncodedP() encoding 0x%08X not supported", encoding);
+	}
+
+	// then add relative offset
+	switch ( encoding & 0x70 ) {
+		case DW_EH_PE_absptr:
+			break;
+		case DW_EH_PE_pcrel:
+			result += startAddr;
+			break;
+		default:
+			throwf("ImageAddressSpace<A>::getEncodedP() encoding 0x%08X not supported", encoding);
+	}
+
+	// Note: DW_EH_PE_indirect is only used for the personality pointer, which points to
+	// a GOT slot that is not bound in the file, so return the address of the slot.
+	return result;
+}
+
 
 template <typename A>
 class UnwindPrinter
@@ -60,9 +212,9 @@ class UnwindPrinter
 public:
 	static bool									validFile(const uint8_t* fileContent);
 	static UnwindPrinter<A>*						make(const uint8_t* fileContent, uint32_t fileLength, 
-															const char* path, bool showFunctionNames) 
+															const char* path, bool showFunctionNames, bool verify) 
 														{ return new UnwindPrinter<A>(fileContent, fileLength, 
-																						path, showFunctionNames); }
+																						path, showFunctionNames, verify); }
 	virtual										~UnwindPrinter() {}
 
 
@@ -72,9 +224,23 @@ private:
 	typedef typename A::P::uint_t			pint_t;
 	
 												UnwindPrinter(const uint8_t* fileContent, uint32_t fileLength, 
-																const char* path, bool showFunctionNames);
+																const char* path, bool showFunctionNames, bool verify);
+	struct PageResults {
+		std::vector<std::string>	mismatches;
+		uint32_t					functionCount		= 0;
+		uint32_t					noUnwindCount		= 0;
+		uint32_t					dwarfCount			= 0;
+		uint32_t					dwarfEncodableCount	= 0;
+		uint32_t					checkedCount		= 0;
+	};
+	using FDEIndex = std::vector<std::pair<pint_t, pint_t>>;
+
 	bool										findUnwindSection();
+	const macho_section<P>*						findEHFrameSection();
 	void										printUnwindSection(bool showFunctionNames);
+	void										verifyUnwindSection();
+	void										verifyFunction(ImageAddressSpace<A>& addressSpace, const FDEIndex& fdes, uint32_t funcOffset,
+																uint32_t encoding, PageResults& results);
 	void										printObjectUnwindSection(bool showFunctionNames);
 	void										getSymbolTableInfo();
 	void										buildSymbolsIndex();
@@ -84,6 +250,9 @@ private:
 
 	static const char*							archName();
 	static void									decode(uint32_t encoding, const uint8_t* funcStart, char* str);
+	static uint32_t								dwarfMode();
+	static uint32_t								encodingFromFDE(ImageAddressSpace<A>& addressSpace, pint_t fde, pint_t* lsda,
+																pint_t* personality, char warning[1024]);
 
 	using SymbolsIndex = std::vector<std::pair<pint_t, const char*>>;
 
@@ -91,6 +260,7 @@ private:
 	const macho_header<P>*						fHeader;
 	uint64_t									fLength;
 	const macho_section<P>*						fUnwindSection;
+	const macho_section<P>*						fEHFrameSection;
 	const char*									fStrings;
 	const char*									fStringsEnd;
 	const macho_nlist<P>*						fSymbols;
@@ -110,6 +280,50 @@ template <>	 const char*	UnwindPrinter<arm64>::archName()	{ return "arm64"; }
 template <>	 const char*	UnwindPrinter<arm64_32>::archName()	{ return "arm64_32"; }
 #endif
 
+template <>	 uint32_t	UnwindPrinter<x86>::dwarfMode()			{ return UNWIND_X86_MODE_DWARF; }
+template <>	 uint32_t	UnwindPrinter<x86_64>::dwarfMode()		{ return UNWIND_X86_64_MODE_DWARF; }
+template <>	 uint32_t	UnwindPrinter<arm>::dwarfMode()			{ return UNWIND_ARM_MODE_DWARF; }
+#if SUPPORT_ARCH_arm64
+template <>	 uint32_t	UnwindPrinter<arm64>::dwarfMode()		{ return UNWIND_ARM64_MODE_DWARF; }
+#endif
+#if SUPPORT_ARCH_arm64_32
+template <>	 uint32_t	UnwindPrinter<arm64_32>::dwarfMode()	{ return UNWIND_ARM64_MODE_DWARF; }
+#endif
+
+template <>
+uint32_t UnwindPrinter<x86>::encodingFromFDE(ImageAddressSpace<x86>& addressSpace, pint_t fde, pint_t* lsda, pint_t* personality, char warning[1024])
+{
+	return libunwind::DwarfInstructions<ImageAddressSpace<x86>, libunwind::Registers_x86>::createCompactEncodingFromFDE(addressSpace, fde, lsda, personality, warning);
+}
+
+template <>
+uint32_t UnwindPrinter<x86_64>::encodingFromFDE(ImageAddressSpace<x86_64>& addressSpace, pint_t fde, pint_t* lsda, pint_t* personality, char warning[1024])
+{
+	return libunwind::DwarfInstructions<ImageAddressSpace<x86_64>, libunwind::Registers_x86_64>::createCompactEncodingFromFDE(addressSpace, fde, lsda, personality, warning);
+}
+
+template <>
+uint32_t UnwindPrinter<arm>::encodingFromFDE(ImageAddressSpace<arm>& addressSpace, pint_t fde, pint_t* lsda, pint_t* personality, char warning[1024])
+{
+	return libunwind::DwarfInstructions<ImageAddressSpace<arm>, libunwind::Registers_arm>::createCompactEncodingFromFDE(addressSpace, fde, lsda, personality, warning);
+}
+
+#if SUPPORT_ARCH_arm64
+template <>
+uint32_t UnwindPrinter<arm64>::encodingFromFDE(ImageAddressSpace<arm64>& addressSpace, pint_t fde, pint_t* lsda, pint_t* personality, char warning[1024])
+{
+	return libunwind::DwarfInstructions<ImageAddressSpace<arm64>, libunwind::Registers_arm64>::createCompactEncodingFromFDE(addressSpace, fde, lsda, personality, warning);
+}
+#endif
+
+#if SUPPORT_ARCH_arm64_32
+template <>
+uint32_t UnwindPrinter<arm64_32>::encodingFromFDE(ImageAddressSpace<arm64_32>& addressSpace, pint_t fde, pint_t* lsda, pint_t* personality, char warning[1024])
+{
+	return libunwind::DwarfInstructions<ImageAddressSpace<arm64_32>, libunwind::Registers_arm64>::createCompactEncodingFromFDE(addressSpace, fde, lsda, personality, warning);
+}
+#endif
+
 template <>
 bool UnwindPrinter<x86>::validFile(const uint8_t* fileContent)
 {	
@@ -211,8 +425,8 @@ bool UnwindPrinter<arm>::validFile(const uint8_t* fileContent)
 }
 
 template <typename A>
-UnwindPrinter<A>::UnwindPrinter(const uint8_t* fileContent, uint32_t fileLength, const char* path, bool showFunctionNames)
- : fHeader(NULL), fLength(fileLength), fUnwindSection(NULL),
+UnwindPrinter<A>::UnwindPrinter(const uint8_t* fileContent, uint32_t fileLength, const char* path, bool showFunctionNames, bool verify)
+ : fHeader(NULL), fLength(fileLength), fUnwindSection(NULL), fEHFrameSection(NULL),
    fStrings(NULL), fStringsEnd(NULL), fSymbols(NULL), fSymbolCount(0), fMachHeaderAddress(0)
 {
 	// sanity check
@@ -226,7 +440,12 @@ UnwindPrinter<A>::UnwindPrinter(const uint8_t* fileContent, uint32_t fileLength,
 	buildSymbolsIndex();
 
 	if ( findUnwindSection() ) {
-		if ( fHeader->filetype() == MH_OBJECT ) 
+		if ( verify ) {
+			if ( fHeader->filetype() == MH_OBJECT )
+				throw "-verify only works on linked images";
+			verifyUnwindSection();
+		}
+		else if ( fHeader->filetype() == MH_OBJECT ) 
 			printObjectUnwindSection(showFunctionNames);
 		else
 			printUnwindSection(showFunctionNames);
@@ -343,6 +562,26 @@ bool UnwindPrinter<A>::findUnwindSection()
 	}
 	return false;
 }
+
+template <typename A>
+const macho_section<typename A::P>* UnwindPrinter<A>::findEHFrameSection()
+{
+	const uint32_t cmd_count = fHeader->ncmds();
+	const macho_load_command<P>* cmd = (macho_load_command<P>*)((uint8_t*)fHeader + sizeof(macho_header<P>));
+	for (uint32_t i = 0; i < cmd_count; ++i) {
+		if ( cmd->cmd() == macho_segment_command<P>::CMD ) {
+			const macho_segment_command<P>* segCmd = (const macho_segment_command<P>*)cmd;
+			const macho_section<P>* const sectionsStart = (macho_section<P>*)((char*)segCmd + sizeof(macho_segment_command<P>));
+			const macho_section<P>* const sectionsEnd = &sectionsStart[segCmd->nsects()];
+			for(const macho_section<P>* sect = sectionsStart; sect < sectionsEnd; ++sect) {
+				if ( (strncmp(sect->sectname(), "__eh_frame", 16) == 0) && (strcmp(sect->segname(), "__TEXT") == 0) )
+					return sect;
+			}
+		}
+		cmd = (const macho_load_command<P>*)(((uint8_t*)cmd)+cmd->cmdsize());
+	}
+	return NULL;
+}
 	
 #define EXTRACT_BITS(value, mask) \
 	( (value >> __builtin_ctz(mask)) & (((1 << __builtin_popcount(mask)))-1) )
@@ -1194,7 +1433,166 @@ void UnwindPrinter<A>::printUnwindSection(bool showFunctionNames)
 
 }
 
-static void dump(const char* path, const std::set<cpu_type_t>& onlyArchs, bool showFunctionNames)
+template <typename A>
+void UnwindPrinter<A>::verifyFunction(ImageAddressSpace<A>& addressSpace, const FDEIndex& fdes, uint32_t funcOffset,
+										uint32_t encoding, PageResults& results)
+{
+	// the bits that describe how to unwind, without personality, LSDA and not-function-start flags
+	const uint32_t frameBits = encoding & 0x0FFFFFFF;
+	const pint_t funcAddr = funcOffset + fMachHeaderAddress;
+	char msg[1200];
+	char warning[1024];
+	pint_t lsda = 0;
+	pint_t personality = 0;
+	++results.functionCount;
+
+	try {
+		if ( encoding == 0 ) {
+			++results.noUnwindCount;
+			return;
+		}
+
+		if ( (encoding & 0x0F000000) == dwarfMode() ) {
+			// compact unwind says use dwarf, the FDE it points to must be for this function
+			++results.dwarfCount;
+			if ( fEHFrameSection == NULL )
+				throw "encoding uses dwarf, but there is no __eh_frame section";
+			const pint_t fdeAddr = fEHFrameSection->addr() + (encoding & 0x00FFFFFF);
+			typename libunwind::CFI_Parser<ImageAddressSpace<A>>::FDE_Info fdeInfo;
+			typename libunwind::CFI_Parser<ImageAddressSpace<A>>::CIE_Info cieInfo;
+			const char* err = libunwind::CFI_Parser<ImageAddressSpace<A>>::decodeFDE(addressSpace, fdeAddr, &fdeInfo, &cieInfo);
+			if ( err != NULL ) {
+				snprintf(msg, sizeof(msg), "funcOffset=0x%08X, encoding=0x%08X, bad FDE at 0x%08llX: %s  %s",
+							funcOffset, encoding, (uint64_t)fdeAddr, err, functionName(funcAddr));
+				results.mismatches.push_back(msg);
+			}
+			else if ( fdeInfo.pcStart != funcAddr ) {
+				snprintf(msg, sizeof(msg), "funcOffset=0x%08X, encoding=0x%08X, FDE at 0x%08llX is for 0x%08llX  %s",
+							funcOffset, encoding, (uint64_t)fdeAddr, (uint64_t)fdeInfo.pcStart, functionName(funcAddr));
+				results.mismatches.push_back(msg);
+			}
+			else {
+				// note functions the linker could have encoded without dwarf
+				warning[0] = '\0';
+				uint32_t fromFDE = encodingFromFDE(addressSpace, fdeAddr, &lsda, &personality, warning);
+				if ( (fromFDE & 0x0F000000) != dwarfMode() )
+					++results.dwarfEncodableCount;
+			}
+			return;
+		}
+
+		// compact encoding, check it against the FDE for the function if one was kept
+		auto it = std::lower_bound(fdes.begin(), fdes.end(), funcAddr, [](const std::pair<pint_t, pint_t>& entry, pint_t addr) {
+			return entry.first < addr;
+		});
+		if ( (it == fdes.end()) || (it->first != funcAddr) )
+			return;
+		++results.checkedCount;
+		warning[0] = '\0';
+		uint32_t fromFDE = encodingFromFDE(addressSpace, it->second, &lsda, &personality, warning);
+		if ( ((fromFDE & 0x0FFFFFFF) != frameBits) || ((fromFDE & UNWIND_HAS_LSDA) != (encoding & UNWIND_HAS_LSDA)) ) {
+			char expected[100];
+			char actual[100];
+			decode(fromFDE, ((const uint8_t*)fHeader)+funcOffset, expected);
+			decode(encoding, ((const uint8_t*)fHeader)+funcOffset, actual);
+			snprintf(msg, sizeof(msg), "funcOffset=0x%08X, encoding=0x%08X (%s), FDE gives 0x%08X (%s)%s%s  %s",
+						funcOffset, encoding, actual, fromFDE, expected, (warning[0] != '\0') ? ", " : "", warning, functionName(funcAddr));
+			results.mismatches.push_back(msg);
+		}
+	}
+	catch (const char* err) {
+		snprintf(msg, sizeof(msg), "funcOffset=0x%08X, encoding=0x%08X, %s  %s", funcOffset, encoding, err, functionName(funcAddr));
+		results.mismatches.push_back(msg);
+	}
+}
+
+//
+// Checks every entry in __unwind_info against __eh_frame.  Functions whose encoding says to
+// use dwarf must point to the FDE for that function.  Functions with a compact encoding that
+// still have an FDE must have the encoding libunwind computes from that FDE.
+// Second level pages are checked in parallel, results are printed in page order.
+//
+template <typename A>
+void UnwindPrinter<A>::verifyUnwindSection()
+{
+	const uint8_t* sectionContent = (uint8_t*)fHeader + fUnwindSection->offset();
+	const macho_unwind_info_section_header<P>* sectionHeader = (macho_unwind_info_section_header<P>*)(sectionContent);
+	const uint32_t* commonEncodings = (uint32_t*)&sectionContent[sectionHeader->commonEncodingsArraySectionOffset()];
+	const macho_unwind_info_section_header_index_entry<P>* indexes = (macho_unwind_info_section_header_index_entry<P>*)&sectionContent[sectionHeader->indexSectionOffset()];
+	ImageAddressSpace<A> addressSpace(fHeader);
+
+	// index FDEs by the function they cover
+	__block FDEIndex fdes;
+	fEHFrameSection = findEHFrameSection();
+	if ( fEHFrameSection != NULL ) {
+		std::vector<typename libunwind::CFI_Parser<ImageAddressSpace<A>>::FDE_Atom_Info> fdeInfos;
+		std::vector<typename libunwind::CFI_Parser<ImageAddressSpace<A>>::CIE_Atom_Info> cieInfos;
+		const char* err = libunwind::CFI_Parser<ImageAddressSpace<A>>::getCFIs(addressSpace, fEHFrameSection->addr(), fEHFrameSection->size(), fdeInfos, cieInfos);
+		if ( err != NULL )
+			throwf("malformed __eh_frame section: %s", err);
+		fdes.reserve(fdeInfos.size());
+		for (const auto& info : fdeInfos)
+			fdes.emplace_back(info.function.address, info.fdeAddress);
+		std::sort(fdes.begin(), fdes.end());
+	}
+
+	const uint32_t pageCount = (sectionHeader->indexCount() > 0) ? sectionHeader->indexCount()-1 : 0;
+	__block std::vector<PageResults> pageResults(pageCount);
+	dispatch_apply(pageCount, DISPATCH_APPLY_AUTO, ^(size_t i) {
+		PageResults& results = pageResults[i];
+		ImageAddressSpace<A> pageAddressSpace = addressSpace;
+		const macho_unwind_info_regular_second_level_page_header<P>* page = (macho_unwind_info_regular_second_level_page_header<P>*)&sectionContent[indexes[i].secondLevelPagesSectionOffset()];
+		if ( page->kind() == UNWIND_SECOND_LEVEL_REGULAR ) {
+			const macho_unwind_info_regular_second_level_entry<P>* entry = (macho_unwind_info_regular_second_level_entry<P>*)((char*)page+page->entryPageOffset());
+			for (uint32_t j=0; j < page->entryCount(); ++j)
+				verifyFunction(pageAddressSpace, fdes, entry[j].functionOffset(), entry[j].encoding(), results);
+		}
+		else if ( page->kind() == UNWIND_SECOND_LEVEL_COMPRESSED ) {
+			const macho_unwind_info_compressed_second_level_page_header<P>* cp = (macho_unwind_info_compressed_second_level_page_header<P>*)page;
+			const uint32_t* entries = (uint32_t*)(((uint8_t*)page)+cp->entryPageOffset());
+			const uint32_t* encodings = (uint32_t*)(((uint8_t*)page)+cp->encodingsPageOffset());
+			const uint32_t baseFunctionOffset = indexes[i].functionOffset();
+			for (uint32_t j=0; j < cp->entryCount(); ++j) {
+				uint8_t encodingIndex = UNWIND_INFO_COMPRESSED_ENTRY_ENCODING_INDEX(entries[j]);
+				uint32_t encoding;
+				if ( encodingIndex < sectionHeader->commonEncodingsArrayCount() )
+					encoding =  A::P::E::get32(commonEncodings[encodingIndex]);
+				else
+					encoding =  A::P::E::get32(encodings[encodingIndex-sectionHeader->commonEncodingsArrayCount()]);
+				uint32_t funcOff = UNWIND_INFO_COMPRESSED_ENTRY_FUNC_OFFSET(entries[j])+baseFunctionOffset;
+				verifyFunction(pageAddressSpace, fdes, funcOff, encoding, results);
+			}
+		}
+		else {
+			char msg[100];
+			snprintf(msg, sizeof(msg), "second level page %lu has a bad page header", i);
+			results.mismatches.push_back(msg);
+		}
+	});
+
+	PageResults totals;
+	size_t mismatchCount = 0;
+	for (uint32_t i=0; i < pageCount; ++i) {
+		const PageResults& results = pageResults[i];
+		for (const std::string& mismatch : results.mismatches)
+			printf("MISMATCH %s\n", mismatch.c_str());
+		totals.functionCount		+= results.functionCount;
+		totals.noUnwindCount		+= results.noUnwindCount;
+		totals.dwarfCount			+= results.dwarfCount;
+		totals.dwarfEncodableCount	+= results.dwarfEncodableCount;
+		totals.checkedCount			+= results.checkedCount;
+		mismatchCount				+= results.mismatches.size();
+	}
+	printf("Arch: %s, %u functions in %u pages, %lu FDEs\n", archName(), totals.functionCount, pageCount, fdes.size());
+	printf("\tno unwind info:        %u\n", totals.noUnwindCount);
+	printf("\tdwarf fallback:        %u (%u could have been encoded compactly)\n", totals.dwarfCount, totals.dwarfEncodableCount);
+	printf("\tchecked against FDE:   %u\n", totals.checkedCount);
+	printf("\tmismatches:            %lu\n", mismatchCount);
+	if ( mismatchCount != 0 )
+		sVerifyFailed = true;
+}
+
+static void dump(const char* path, const std::set<cpu_type_t>& onlyArchs, bool showFunctionNames, bool verify)
 {
 	struct stat stat_buf;
 	
@@ -1221,20 +1619,20 @@ static void dump(const char* path, const std::set<cpu_type_t>& onlyArchs, bool s
 					switch(cputype) {
 					case CPU_TYPE_I386:
 						if ( UnwindPrinter<x86>::validFile(p + offset) )
-							UnwindPrinter<x86>::make(p + offset, size, path, showFunctionNames);
+							UnwindPrinter<x86>::make(p + offset, size, path, showFunctionNames, verify);
 						else
 							throw "in universal file, i386 slice does not contain i386 mach-o";
 						break;
 					case CPU_TYPE_X86_64:
 						if ( UnwindPrinter<x86_64>::validFile(p + offset) )
-							UnwindPrinter<x86_64>::make(p + offset, size, path, showFunctionNames);
+							UnwindPrinter<x86_64>::make(p + offset, size, path, showFunctionNames, verify);
 						else
 							throw "in universal file, x86_64 slice does not contain x86_64 mach-o";
 						break;
 #if SUPPORT_ARCH_arm64
 					case CPU_TYPE_ARM64:
 						if ( UnwindPrinter<arm64>::validFile(p + offset) )
-							UnwindPrinter<arm64>::make(p + offset, size, path, showFunctionNames);
+							UnwindPrinter<arm64>::make(p + offset, size, path, showFunctionNames, verify);
 						else
 							throw "in universal file, arm64 slice does not contain arm64 mach-o";
 						break;
@@ -1242,14 +1640,14 @@ static void dump(const char* path, const std::set<cpu_type_t>& onlyArchs, bool s
 #if SUPPORT_ARCH_arm64_32
 					case CPU_TYPE_ARM64_32:
 						if ( UnwindPrinter<arm64_32>::validFile(p + offset) )
-							UnwindPrinter<arm64_32>::make(p + offset, size, path, showFunctionNames);
+							UnwindPrinter<arm64_32>::make(p + offset, size, path, showFunctionNames, verify);
 						else
 							throw "in universal file, arm64_32 slice does not contain arm64_32 mach-o";
 						break;
 #endif
 					case CPU_TYPE_ARM:
 						if ( UnwindPrinter<arm>::validFile(p + offset) )
-							UnwindPrinter<arm>::make(p + offset, size, path, showFunctionNames);
+							UnwindPrinter<arm>::make(p + offset, size, path, showFunctionNames, verify);
 						else
 							throw "in universal file, arm slice does not contain arm mach-o";
 						break;
@@ -1260,23 +1658,23 @@ static void dump(const char* path, const std::set<cpu_type_t>& onlyArchs, bool s
 			}
 		}
 		else if ( UnwindPrinter<x86>::validFile(p) && onlyArchs.count(CPU_TYPE_I386) ) {
-			UnwindPrinter<x86>::make(p, length, path, showFunctionNames);
+			UnwindPrinter<x86>::make(p, length, path, showFunctionNames, verify);
 		}
 		else if ( UnwindPrinter<x86_64>::validFile(p) && onlyArchs.count(CPU_TYPE_X86_64) ) {
-			UnwindPrinter<x86_64>::make(p, length, path, showFunctionNames);
+			UnwindPrinter<x86_64>::make(p, length, path, showFunctionNames, verify);
 		}
 #if SUPPORT_ARCH_arm64
 		else if ( UnwindPrinter<arm64>::validFile(p) && onlyArchs.count(CPU_TYPE_ARM64) ) {
-			UnwindPrinter<arm64>::make(p, length, path, showFunctionNames);
+			UnwindPrinter<arm64>::make(p, length, path, showFunctionNames, verify);
 		}
 #endif
 #if SUPPORT_ARCH_arm64_32
 		else if ( UnwindPrinter<arm64_32>::validFile(p) && onlyArchs.count(CPU_TYPE_ARM64_32) ) {
-			UnwindPrinter<arm64_32>::make(p, length, path, showFunctionNames);
+			UnwindPrinter<arm64_32>::make(p, length, path, showFunctionNames, verify);
 		}
 #endif
 		else if ( UnwindPrinter<arm>::validFile(p) && onlyArchs.count(CPU_TYPE_ARM) ) {
-			UnwindPrinter<arm>::make(p, length, path, showFunctionNames);
+			UnwindPrinter<arm>::make(p, length, path, showFunctionNames, verify);
 		}
 		else {
 			throw "not a known file type";
@@ -1293,6 +1691,7 @@ int main(int argc, const char* argv[])
 	std::set<cpu_type_t> onlyArchs;
 	std::vector<const char*> files;
 	bool showFunctionNames = true;
+	bool verify = false;
 	
 	try {
 		for(int i=1; i < argc; ++i) {
@@ -1320,6 +1719,9 @@ int main(int argc, const char* argv[])
 				else if ( strcmp(arg, "-no_symbols") == 0 ) {
 					showFunctionNames = false;
 				}
+				else if ( strcmp(arg, "-verify") == 0 ) {
+					verify = true;
+				}
 				else {
 					throwf("unknown option: %s\n", arg);
 				}
@@ -1344,7 +1746,7 @@ int main(int argc, const char* argv[])
 		
 		// process each file
 		for(std::vector<const char*>::iterator it=files.begin(); it != files.end(); ++it) {
-			dump(*it, onlyArchs, showFunctionNames);
+			dump(*it, onlyArchs, showFunctionNames, verify);
 		}
 		
 	}
@@ -1353,7 +1755,7 @@ int main(int argc, const char* argv[])
 		return 1;
 	}
 	
-	return 0;
+	return sVerifyFailed ? 1 : 0;
 }
 
 
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "LinkMap.h"
+
+//
+// Prints the symbols of a -binary_map file in the same form as the
+// symbol lines of a -map file, after checking every table is in bounds.
+//
+int main(int argc, const char* argv[])
+{
+	struct stat st;
+	int fd = open(argv[1], O_RDONLY);
+	if ( (fd == -1) || (fstat(fd, &st) != 0) ) {
+		fprintf(stderr, "cannot open %s\n", argv[1]);
+		return 1;
+	}
+	const uint8_t* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if ( p == MAP_FAILED ) {
+		fprintf(stderr, "cannot map %s\n", argv[1]);
+		return 1;
+	}
+	const struct link_map_header* header = (const struct link_map_header*)p;
+	if ( (st.st_size < sizeof(struct link_map_header)) || (memcmp(header->magic, LINK_MAP_MAGIC, 8) != 0) ) {
+		fprintf(stderr, "bad magic\n");
+		return 1;
+	}
+	if ( (header->version != LINK_MAP_VERSION) || (header->headerSize != sizeof(struct link_map_header)) ) {
+		fprintf(stderr, "bad version\n");
+		return 1;
+	}
+	if ( (header->filesOffset + header->filesCount*sizeof(struct link_map_file) > header->sectionsOffset)
+	  || (header->sectionsOffset + header->sectionsCount*sizeof(struct link_map_section) > header->symbolsOffset)
+	  || (header->symbolsOffset + header->symbolsCount*sizeof(struct link_map_symbol) > header->stringsOffset)
+	  || (header->stringsOffset + header->stringsSize > st.st_size) ) {
+		fprintf(stderr, "tables out of bounds\n");
+		return 1;
+	}
+	const char* strings = (const char*)&p[header->stringsOffset];
+	const struct link_map_file* files = (const struct link_map_file*)&p[header->filesOffset];
+	for (uint64_t i=0; i < header->filesCount; ++i) {
+		if ( files[i].pathStrx >= header->stringsSize ) {
+			fprintf(stderr, "file %llu has a bad path\n", i);
+			return 1;
+		}
+	}
+	const struct link_map_symbol* symbols = (const struct link_map_symbol*)&p[header->symbolsOffset];
+	for (uint64_t i=0; i < header->symbolsCount; ++i) {
+		const struct link_map_symbol* sym = &symbols[i];
+		if ( (sym->nameStrx >= header->stringsSize) || (sym->fileIndex >= header->filesCount) ) {
+			fprintf(stderr, "symbol %llu is out of bounds\n", i);
+			return 1;
+		}
+		if ( (sym->sectionIndex != LINK_MAP_NO_SECTION) && (sym->sectionIndex >= header->sectionsCount) ) {
+			fprintf(stderr, "symbol %llu has a bad section\n", i);
+			return 1;
+		}
+		if ( sym->flags & LINK_MAP_SYMBOL_DEAD )
+			printf("<<dead>> \t0x%08llX\t[%3u] %s\n", sym->size, sym->fileIndex, &strings[sym->nameStrx]);
+		else
+			printf("0x%08llX\t0x%08llX\t[%3u] %s\n", sym->address, sym->size, sym->fileIndex, &strings[sym->nameStrx]);
+	}
+	return 0;
+}
@@ -0,0 +1,111 @@
+# Three rbp frame functions whose FDEs have identical instructions.
+# _sameAlign1 and _sameAlign2 share a CIE with a data alignment factor
+# of -8, so rbp is saved at CFA-16.  _otherAlign uses a CIE with a data
+# alignment factor of -4, where the same bytes put rbp at CFA-8, so it
+# must not reuse the encoding computed for _sameAlign1.
+
+	.text
+	.globl	_sameAlign1
+_sameAlign1:
+	pushq	%rbp
+	movq	%rsp, %rbp
+	popq	%rbp
+	retq
+Lend_sameAlign1:
+
+	.globl	_otherAlign
+_otherAlign:
+	pushq	%rbp
+	movq	%rsp, %rbp
+	popq	%rbp
+	retq
+Lend_otherAlign:
+
+	.globl	_sameAlign2
+_sameAlign2:
+	pushq	%rbp
+	movq	%rsp, %rbp
+	popq	%rbp
+	retq
+Lend_sameAlign2:
+
+
+	.section __TEXT,__eh_frame,coalesced,no_toc+strip_static_syms+live_support
+EH_frame1:
+	.long	LECIE1-LSCIE1		# length
+LSCIE1:
+	.long	0					# CIE id
+	.byte	1					# version
+	.asciz	"zR"				# augmentation
+	.byte	1					# code alignment factor
+	.byte	0x78				# data alignment factor -8
+	.byte	16					# return address register
+	.byte	1					# augmentation data length
+	.byte	0x10				# FDE pointers are pc relative
+	.byte	0x0c, 7, 8			# DW_CFA_def_cfa rsp, 8
+	.byte	0x90, 1				# DW_CFA_offset rip, 1
+	.p2align 3
+LECIE1:
+
+_sameAlign1.eh:
+	.long	LEFDE1-LASFDE1		# length
+LASFDE1:
+	.long	LASFDE1-EH_frame1	# CIE pointer
+	.quad	_sameAlign1-.		# function start
+	.quad	Lend_sameAlign1-_sameAlign1
+	.byte	0					# augmentation data length
+	.byte	0x41				# DW_CFA_advance_loc 1
+	.byte	0x0e, 16			# DW_CFA_def_cfa_offset 16
+	.byte	0x86, 2				# DW_CFA_offset rbp, 2
+	.byte	0x43				# DW_CFA_advance_loc 3
+	.byte	0x0d, 6				# DW_CFA_def_cfa_register rbp
+	.p2align 3
+LEFDE1:
+
+EH_frame2:
+	.long	LECIE2-LSCIE2		# length
+LSCIE2:
+	.long	0					# CIE id
+	.byte	1					# version
+	.asciz	"zR"				# augmentation
+	.byte	1					# code alignment factor
+	.byte	0x7c				# data alignment factor -4
+	.byte	16					# return address register
+	.byte	1					# augmentation data length
+	.byte	0x10				# FDE pointers are pc relative
+	.byte	0x0c, 7, 8			# DW_CFA_def_cfa rsp, 8
+	.byte	0x90, 2				# DW_CFA_offset rip, 2
+	.p2align 3
+LECIE2:
+
+_otherAlign.eh:
+	.long	LEFDE2-LASFDE2		# length
+LASFDE2:
+	.long	LASFDE2-EH_frame2	# CIE pointer
+	.quad	_otherAlign-.		# function start
+	.quad	Lend_otherAlign-_otherAlign
+	.byte	0					# augmentation data length
+	.byte	0x41				# DW_CFA_advance_loc 1
+	.byte	0x0e, 16			# DW_CFA_def_cfa_offset 16
+	.byte	0x86, 2				# DW_CFA_offset rbp, 2
+	.byte	0x43				# DW_CFA_advance_loc 3
+	.byte	0x0d, 6				# DW_CFA_def_cfa_register rbp
+	.p2align 3
+LEFDE2:
+
+_sameAlign2.eh:
+	.long	LEFDE3-LASFDE3		# length
+LASFDE3:
+	.long	LASFDE3-EH_frame1	# CIE pointer
+	.quad	_sameAlign2-.		# function start
+	.quad	Lend_sameAlign2-_sameAlign2
+	.byte	0					# augmentation data length
+	.byte	0x41				# DW_CFA_advance_loc 1
+	.byte	0x0e, 16			# DW_CFA_def_cfa_offset 16
+	.byte	0x86, 2				# DW_CFA_offset rbp, 2
+	.byte	0x43				# DW_CFA_advance_loc 3
+	.byte	0x0d, 6				# DW_CFA_def_cfa_register rbp
+	.p2align 3
+LEFDE3:
+
+	.subsections_via_symbols
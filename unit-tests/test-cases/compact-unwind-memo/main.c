@@ -0,0 +1,9 @@
+extern int one_a(int), one_b(int), two_a(int), two_b(int);
+extern int bigFrame1(int), bigFrame2(int);
+
+void consume(void* p) { }
+
+int main()
+{
+	return one_a(1) + one_b(2) + two_a(3) + two_b(4) + bigFrame1(5) + bigFrame2(6);
+}
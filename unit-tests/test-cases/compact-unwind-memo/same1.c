@@ -0,0 +1,4 @@
+extern void consume(void*);
+
+int one_a(int a) { consume(&a); return a; }
+int one_b(int a) { consume(&a); return a + 1; }
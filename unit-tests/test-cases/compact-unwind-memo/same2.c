@@ -0,0 +1,5 @@
+extern void consume(void*);
+
+// same prologues as same1.c, so the same FDE instructions
+int two_a(int a) { consume(&a); return a; }
+int two_b(int a) { consume(&a); return a + 1; }
@@ -0,0 +1,19 @@
+extern void consume(void*);
+
+// frameless and too big for an immediate stack size, so the encoding is
+// UNWIND_X86_64_MODE_STACK_IND which reads the size from the sub instruction
+int bigFrame1(int a)
+{
+	char buffer[3000];
+	buffer[a] = 1;
+	consume(buffer);
+	return buffer[0];
+}
+
+int bigFrame2(int a)
+{
+	char buffer[3500];
+	buffer[a] = 2;
+	consume(buffer);
+	return buffer[0];
+}
@@ -0,0 +1,7 @@
+#include <stdio.h>
+
+int main()
+{
+	printf("hello\n");
+	return 0;
+}
@@ -0,0 +1,14 @@
+// enough code and relocations that the object file spans many pages
+#define F(n)		int f##n(int a) { return a * n + (int)(long)&f##n; }
+#define F10(n)		F(n##0) F(n##1) F(n##2) F(n##3) F(n##4) F(n##5) F(n##6) F(n##7) F(n##8) F(n##9)
+#define F100(n)		F10(n##0) F10(n##1) F10(n##2) F10(n##3) F10(n##4) F10(n##5) F10(n##6) F10(n##7) F10(n##8) F10(n##9)
+#define F1000(n)	F100(n##0) F100(n##1) F100(n##2) F100(n##3) F100(n##4) F100(n##5) F100(n##6) F100(n##7) F100(n##8) F100(n##9)
+
+F1000(1)
+F1000(2)
+F1000(3)
+F1000(4)
+F1000(5)
+F1000(6)
+F1000(7)
+F1000(8)
@@ -0,0 +1,6 @@
+extern int f10001(int);
+
+int main()
+{
+	return f10001(1);
+}
@@ -0,0 +1,12 @@
+#include <string.h>
+
+const char* kLong = "reset_statistics";
+const char* kShort = "statistics";
+
+int main()
+{
+	if ( strcmp(kShort, "statistics") != 0 )
+		return 1;
+	// with -tail_merge_strings the short string is stored inside the long one
+	return (kShort == kLong + 6) ? 0 : 2;
+}
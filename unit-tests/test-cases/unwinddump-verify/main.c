@@ -0,0 +1,48 @@
+#include <stdarg.h>
+#include <string.h>
+#include <alloca.h>
+
+extern void consume(void*);
+
+int leaf(int a) { return a * 3; }
+
+int withLocals(int a)
+{
+	char buffer[64];
+	memset(buffer, a, sizeof(buffer));
+	consume(buffer);
+	return buffer[a & 63];
+}
+
+int largeFrame(int a)
+{
+	char buffer[70000];
+	buffer[a] = 1;
+	consume(buffer);
+	return buffer[0];
+}
+
+int dynamicFrame(int size)
+{
+	char* p = alloca(size);
+	consume(p);
+	return p[0];
+}
+
+int sum(int count, ...)
+{
+	va_list list;
+	va_start(list, count);
+	int total = 0;
+	for (int i=0; i < count; ++i)
+		total += va_arg(list, int);
+	va_end(list);
+	return total;
+}
+
+void consume(void* p) { }
+
+int main()
+{
+	return leaf(1) + withLocals(2) + largeFrame(3) + dynamicFrame(16) + sum(3, 1, 2, 3);
+}
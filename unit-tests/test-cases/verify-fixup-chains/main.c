@@ -0,0 +1,10 @@
+int main() { return 0; }
+
+// enough pointers that the chains cross several pages
+#define P4		&main, &main, &main, &main,
+#define P16		P4 P4 P4 P4
+#define P64		P16 P16 P16 P16
+#define P256	P64 P64 P64 P64
+#define P1024	P256 P256 P256 P256
+
+int (*table[])() = { P1024 P1024 P1024 P1024 };